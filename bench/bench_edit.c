@@ -0,0 +1,136 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: bench_edit.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffer.h"
+
+#define GAP_KEYSTROKES 200000
+#define REPLACE_KEYSTROKES 2000
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static size_t next_column(size_t column, size_t line_len, int keystroke)
+{
+    if (keystroke % 2 == 0) {
+        return column + 1;
+    }
+    return column + 1 < line_len ? column : 0;
+}
+
+static void build_buffer(TextBuffer *buf, size_t line_len)
+{
+    char *line = (char *)malloc(line_len);
+    if (!line) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < line_len; ++i) {
+        line[i] = (char)('a' + i % 26);
+    }
+
+    buffer_init(buf);
+    for (int i = 0; i < 3; ++i) {
+        if (buffer_append_line_n(buf, line, line_len) != 0) {
+            fprintf(stderr, "append failed\n");
+            exit(1);
+        }
+    }
+    free(line);
+}
+
+/*
+ * Overtypes line 1 from its middle: each pair of keystrokes inserts one
+ * byte and deletes the one after it, wrapping to the start at the end.
+ */
+static double time_gap(size_t line_len)
+{
+    TextBuffer buf;
+    build_buffer(&buf, line_len);
+
+    size_t column = line_len / 2;
+    double start = now_seconds();
+    for (int i = 0; i < GAP_KEYSTROKES; ++i) {
+        int rc = i % 2 == 0 ? buffer_insert_chars(&buf, 1, column, "x", 1)
+                            : buffer_delete_chars(&buf, 1, column, 1);
+        if (rc != 0) {
+            fprintf(stderr, "character edit failed\n");
+            exit(1);
+        }
+        column = next_column(column, line_len, i);
+    }
+    buffer_sync_edit(&buf);
+    double elapsed = now_seconds() - start;
+
+    buffer_free(&buf);
+    return elapsed / GAP_KEYSTROKES;
+}
+
+/* The same keystrokes, each rebuilding the line and replacing it whole */
+static double time_replace(size_t line_len)
+{
+    TextBuffer buf;
+    build_buffer(&buf, line_len);
+
+    char *line = (char *)malloc(line_len + 2);
+    if (!line) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    size_t column = line_len / 2;
+    double start = now_seconds();
+    for (int i = 0; i < REPLACE_KEYSTROKES; ++i) {
+        size_t len = 0;
+        const char *old = buffer_get_line_n(&buf, 1, &len);
+        if (i % 2 == 0) {
+            memcpy(line, old, column);
+            line[column] = 'x';
+            memcpy(line + column + 1, old + column, len - column);
+            len++;
+        } else {
+            memcpy(line, old, column);
+            memcpy(line + column, old + column + 1, len - column - 1);
+            len--;
+        }
+        if (buffer_replace_line_n(&buf, 1, line, len) != 0) {
+            fprintf(stderr, "replace failed\n");
+            exit(1);
+        }
+        column = next_column(column, line_len, i);
+    }
+    double elapsed = now_seconds() - start;
+
+    free(line);
+    buffer_free(&buf);
+    return elapsed / REPLACE_KEYSTROKES;
+}
+
+int main(void)
+{
+    static const size_t lengths[] = {80, 4 * 1024, 50 * 1024, 1024 * 1024};
+
+    printf("%-12s %14s %14s %9s\n", "line bytes", "gap ns/key", "replace ns/key", "speedup");
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        double gap = time_gap(lengths[i]);
+        double replace = time_replace(lengths[i]);
+        printf("%-12zu %14.1f %14.1f %8.1fx\n", lengths[i], gap * 1e9, replace * 1e9, replace / gap);
+    }
+    return 0;
+}
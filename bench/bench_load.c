@@ -0,0 +1,194 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: bench_load.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "fileio.h"
+#include "parallel.h"
+
+#define DEFAULT_MEGABYTES 256
+#define MAX_LINE_LENGTH 80
+#define ROUNDS 3
+#define BENCH_FILE "bench_load.tmp"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Lines of 0 to MAX_LINE_LENGTH lowercase bytes; returns the line count */
+static size_t write_file(size_t size)
+{
+    FILE *fp = fopen(BENCH_FILE, "w");
+    if (!fp) {
+        fprintf(stderr, "cannot create %s\n", BENCH_FILE);
+        exit(1);
+    }
+
+    char line[MAX_LINE_LENGTH + 1];
+    size_t written = 0;
+    size_t lines = 0;
+    srand(7);
+    while (written < size) {
+        size_t len = (size_t)rand() % (MAX_LINE_LENGTH + 1);
+        for (size_t i = 0; i < len; ++i) {
+            line[i] = (char)('a' + rand() % 26);
+        }
+        line[len] = '\n';
+        if (fwrite(line, 1, len + 1, fp) != len + 1) {
+            fprintf(stderr, "write failed\n");
+            exit(1);
+        }
+        written += len + 1;
+        lines++;
+    }
+    fclose(fp);
+    return lines;
+}
+
+/* The fgets loop file_load used before */
+static size_t load_fgets(TextBuffer *buf)
+{
+    FILE *fp = fopen(BENCH_FILE, "r");
+    if (!fp) {
+        return 0;
+    }
+
+    char line[MAX_LINE_LENGTH + 2];
+    buffer_free(buf);
+    buffer_init(buf);
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, "\n")] = '\0';
+        buffer_append_line(buf, line);
+    }
+    fclose(fp);
+    return buf->count;
+}
+
+static FileMapMode load_map;
+static size_t load_threads;
+static FileLineIndex *load_cache;
+
+static size_t load_with(TextBuffer *buf)
+{
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.map = load_map;
+    options.threads = load_threads;
+    options.line_cache = load_cache;
+    options.line_cache_min = 0;
+    if (file_load_with(BENCH_FILE, buf, &options) != 0) {
+        return 0;
+    }
+    return buf->count;
+}
+
+static double best_of(size_t (*load)(TextBuffer *), size_t lines)
+{
+    double best = 0.0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        TextBuffer buf;
+        buffer_init(&buf);
+        double start = now_seconds();
+        size_t count = load(&buf);
+        double elapsed = now_seconds() - start;
+        buffer_free(&buf);
+
+        if (count != lines) {
+            fprintf(stderr, "loaded %zu lines, expected %zu\n", count, lines);
+            exit(1);
+        }
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+static void report(const char *name, size_t bytes, double seconds, double base)
+{
+    printf("%-12s %8.3f ms  %6.2f GB/s  x%.2f\n", name, seconds * 1e3, (double)bytes / seconds / 1e9,
+           base / seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_MEGABYTES;
+    size_t size = (megabytes ? megabytes : DEFAULT_MEGABYTES) * 1024 * 1024;
+    size_t lines = write_file(size);
+    size_t max_threads = parallel_default_threads();
+
+    printf("load %zu MB, %zu lines (speedup against one thread)\n", size >> 20, lines);
+    load_threads = 1;
+    load_map = FILE_MAP_NEVER;
+    double read_base = best_of(load_with, lines);
+    report("fgets-loop", size, best_of(load_fgets, lines), read_base);
+
+    const FileMapMode modes[] = { FILE_MAP_NEVER, FILE_MAP_ALWAYS };
+    double map_base = 0.0;
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        load_map = modes[m];
+        double base = 0.0;
+        for (load_threads = 1; load_threads <= max_threads; load_threads *= 2) {
+            char name[32];
+            snprintf(name, sizeof(name), "%s x%zu", modes[m] == FILE_MAP_NEVER ? "read" : "mmap", load_threads);
+            double seconds = best_of(load_with, lines);
+            if (load_threads == 1) {
+                base = seconds;
+                map_base = seconds;
+            }
+            report(name, size, seconds, base);
+        }
+    }
+
+    /* Reopening through the line cache, which the first load writes (speedup against mmap x1) */
+    FileLineIndex cache;
+    file_line_index_init(&cache);
+    load_cache = &cache;
+    load_map = FILE_MAP_ALWAYS;
+    for (load_threads = 1; load_threads <= max_threads; load_threads *= 2) {
+        char name[32];
+        snprintf(name, sizeof(name), "cached x%zu", load_threads);
+        report(name, size, best_of(load_with, lines), map_base);
+    }
+
+    /* Huge-file mode: the last line is reachable before the file is indexed */
+    FileIndexJob job;
+    file_index_job_init(&job);
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.index = &job;
+    options.lazy_threshold = 0;
+    options.line_cache = &cache;
+    options.line_cache_min = 0;
+    TextBuffer buf;
+    buffer_init(&buf);
+    BufferSpan span;
+    double start = now_seconds();
+    if (file_load_with(BENCH_FILE, &buf, &options) != 0 || file_line_span(&cache, &buf, lines - 1, lines, &span) != 0) {
+        fprintf(stderr, "huge-file open through the line cache failed\n");
+        exit(1);
+    }
+    printf("%-12s %8.3f ms  (open and show line %zu)\n", "cached jump", (now_seconds() - start) * 1e3, lines);
+    file_index_cancel(&job);
+    buffer_free(&buf);
+    file_line_index_free(&cache);
+
+    remove(BENCH_FILE);
+    remove(BENCH_FILE FILE_LINE_CACHE_SUFFIX);
+    return 0;
+}
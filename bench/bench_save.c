@@ -0,0 +1,225 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: bench_save.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "fileio.h"
+
+#define DEFAULT_MEGABYTES 64
+#define LINE_LENGTH 80
+#define ROUNDS 3
+#define BENCH_FILE "bench_save.tmp"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void release_bench_data(void *data, size_t size)
+{
+    (void)size;
+    free(data);
+}
+
+static void build_buffer(TextBuffer *buf, size_t size)
+{
+    char *data = (char *)malloc(size);
+    if (!data) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    srand(7);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = (i % (LINE_LENGTH + 1) == LINE_LENGTH) ? '\n' : (char)('a' + rand() % 26);
+    }
+
+    buffer_init(buf);
+    if (buffer_attach_original(buf, data, size, release_bench_data) != 0) {
+        fprintf(stderr, "attach failed\n");
+        exit(1);
+    }
+}
+
+/* The in-place, line-at-a-time stdio save file_save used before */
+static int save_stdio(const char *filename, const TextBuffer *buffer, int sync)
+{
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        return -1;
+    }
+
+    int rc = 0;
+    for (size_t i = 0; i < buffer->count && rc == 0; ++i) {
+        const char *line = buffer_get_line(buffer, i);
+        if (!line || fputs(line, fp) == EOF || fputc('\n', fp) == EOF) {
+            rc = -1;
+        }
+    }
+    if (rc == 0 && sync && (fflush(fp) != 0 || fsync(fileno(fp)) != 0)) {
+        rc = -1;
+    }
+    if (fclose(fp) == EOF) {
+        rc = -1;
+    }
+    return rc;
+}
+
+static int save_stdio_nosync(const char *filename, const TextBuffer *buffer)
+{
+    return save_stdio(filename, buffer, 0);
+}
+
+static int save_stdio_sync(const char *filename, const TextBuffer *buffer)
+{
+    return save_stdio(filename, buffer, 1);
+}
+
+static void report(const char *name, size_t bytes, int (*save)(const char *, const TextBuffer *),
+                   const TextBuffer *buf)
+{
+    double best = 0.0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        double start = now_seconds();
+        if (save(BENCH_FILE, buf) != 0) {
+            fprintf(stderr, "%s failed\n", name);
+            exit(1);
+        }
+        double elapsed = now_seconds() - start;
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    printf("%-14s %9.3f ms  %6.2f GB/s\n", name, best * 1e3, (double)bytes / best / 1e9);
+}
+
+/* One small edit per save, as an editor session on a large file would do */
+static double time_incremental(TextBuffer *buf, FileStamp *stamp, int insert, size_t *written)
+{
+    char same_length[LINE_LENGTH + 1];
+    memset(same_length, 'X', LINE_LENGTH);
+    same_length[LINE_LENGTH] = '\0';
+
+    double best = 0.0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        /* Replace untouched full-length lines, or insert near the end */
+        size_t line = (size_t)round * (buf->count / ROUNDS) + 1;
+        int rc = insert ? buffer_insert_line(buf, buf->count - 1000 + (size_t)round * 10, "a new line")
+                        : buffer_replace_line(buf, line, same_length);
+
+        FileSaveResult result;
+        double start = now_seconds();
+        if (rc != 0 || file_save_incremental(BENCH_FILE, buf, stamp, &result) != 0) {
+            fprintf(stderr, "incremental save failed\n");
+            exit(1);
+        }
+        double elapsed = now_seconds() - start;
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+        *written = result.bytes_written;
+    }
+    return best;
+}
+
+static void bench_incremental(size_t size, const TextBuffer *source)
+{
+    if (file_save(BENCH_FILE, source) != 0) {
+        fprintf(stderr, "save failed\n");
+        exit(1);
+    }
+
+    FileStamp stamp;
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.stamp = &stamp;
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    if (file_load_with(BENCH_FILE, &buf, &options) != 0) {
+        fprintf(stderr, "load failed\n");
+        exit(1);
+    }
+
+    size_t written = 0;
+    printf("incremental save of a %zu MB mapped file after one edit\n", size >> 20);
+    double patch = time_incremental(&buf, &stamp, 0, &written);
+    printf("%-14s %9.3f ms  %8zu bytes written\n", "patch", patch * 1e3, written);
+    double suffix = time_incremental(&buf, &stamp, 1, &written);
+    printf("%-14s %9.3f ms  %8zu bytes written\n", "tail rewrite", suffix * 1e3, written);
+
+    double start = now_seconds();
+    file_save(BENCH_FILE, &buf);
+    printf("%-14s %9.3f ms  %8zu bytes written\n", "file_save", (now_seconds() - start) * 1e3, size);
+
+    buffer_free(&buf);
+}
+
+/* How long a background save blocks the editor, against the whole save */
+static void bench_background(TextBuffer *buf)
+{
+    FileSaveJob job;
+    file_save_job_init(&job);
+
+    double start = now_seconds();
+    if (file_save_start(&job, BENCH_FILE, buf) != 0) {
+        fprintf(stderr, "background save failed to start\n");
+        exit(1);
+    }
+    double blocked = now_seconds() - start;
+    size_t spans = job.snapshot.count;
+    if (file_save_finish(&job, buf, 1) != 1 || job.result != 0) {
+        fprintf(stderr, "background save failed\n");
+        exit(1);
+    }
+    double total = now_seconds() - start;
+
+    printf("background save of %zu spans\n", spans);
+    printf("%-14s %9.3f ms\n", "blocking", blocked * 1e3);
+    printf("%-14s %9.3f ms\n", "until done", total * 1e3);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_MEGABYTES;
+    size_t size = (megabytes ? megabytes : DEFAULT_MEGABYTES) * 1024 * 1024;
+
+    TextBuffer buf;
+    build_buffer(&buf, size);
+
+    for (int edited = 0; edited <= 1; ++edited) {
+        if (edited) {
+            /* Every tenth line moves to the arena, splitting the original runs */
+            for (size_t i = 0; i < buf.count; i += 10) {
+                buffer_replace_line(&buf, i, "an edited line that now lives in the add arena");
+            }
+        }
+
+        printf("save %zu MB, %zu lines%s\n", size >> 20, buf.count, edited ? ", every 10th line edited" : "");
+        report("stdio", size, save_stdio_nosync, &buf);
+        report("stdio+fsync", size, save_stdio_sync, &buf);
+        report("file_save", size, file_save, &buf);
+    }
+
+    bench_background(&buf);
+    bench_incremental(size, &buf);
+
+    remove(BENCH_FILE);
+    buffer_free(&buf);
+    return 0;
+}
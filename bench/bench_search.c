@@ -0,0 +1,161 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: bench_search.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "parallel.h"
+#include "pattern.h"
+#include "search.h"
+
+#define DEFAULT_MEGABYTES 64
+#define LINE_LENGTH 80
+#define ROUNDS 5
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void release_bench_data(void *data, size_t size)
+{
+    (void)size;
+    free(data);
+}
+
+/* Lowercase lines that never contain the needle's uppercase bytes */
+static void build_buffer(TextBuffer *buf, size_t size)
+{
+    char *data = (char *)malloc(size);
+    if (!data) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    srand(7);
+    for (size_t i = 0; i < size; ++i) {
+        data[i] = (i % (LINE_LENGTH + 1) == LINE_LENGTH) ? '\n' : (char)('a' + rand() % 26);
+    }
+
+    buffer_init(buf);
+    if (buffer_attach_original(buf, data, size, release_bench_data) != 0) {
+        fprintf(stderr, "attach failed\n");
+        exit(1);
+    }
+}
+
+static size_t parallel_threads;
+
+static size_t find_parallel(const TextBuffer *buf, const char *needle)
+{
+    BufferSearch search;
+    BufferMatch match;
+
+    buffer_search_init(&search, needle);
+    if (buffer_find_all_parallel(buf, &search, &match, 1, parallel_threads) == 0) {
+        return INVALID_INDEX;
+    }
+    return match.line;
+}
+
+static size_t find_regex(const TextBuffer *buf, const char *source)
+{
+    BufferSearch search;
+    BufferMatch match;
+    Pattern *pattern = pattern_cache_get(source, NULL);
+
+    buffer_search_init_regex(&search, pattern);
+    size_t found = buffer_find_all(buf, &search, &match, 1);
+    pattern_cache_release(pattern);
+    return found == 0 ? INVALID_INDEX : match.line;
+}
+
+/* The line-at-a-time strstr loop buffer_find used before */
+static size_t find_strstr(const TextBuffer *buf, const char *needle)
+{
+    for (size_t i = 0; i < buf->count; ++i) {
+        if (strstr(buffer_get_line(buf, i), needle) != NULL) {
+            return i;
+        }
+    }
+    return INVALID_INDEX;
+}
+
+static void report(const char *name, size_t bytes, double seconds)
+{
+    printf("%-12s %8.3f ms  %6.2f GB/s\n", name, seconds * 1e3, (double)bytes / seconds / 1e9);
+}
+
+static double best_of(size_t (*find)(const TextBuffer *, const char *), const TextBuffer *buf, const char *needle)
+{
+    double best = 0.0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        double start = now_seconds();
+        if (find(buf, needle) != INVALID_INDEX) {
+            fprintf(stderr, "unexpected match\n");
+            exit(1);
+        }
+        double elapsed = now_seconds() - start;
+        if (round == 0 || elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_MEGABYTES;
+    size_t size = (megabytes ? megabytes : DEFAULT_MEGABYTES) * 1024 * 1024;
+    /* A needle whose first byte never occurs, and one whose bytes are common */
+    const char *needles[] = { "RARE_TOKEN", "status=ok9" };
+    const SearchKernel kernels[] = { SEARCH_KERNEL_SCALAR, SEARCH_KERNEL_SSE2, SEARCH_KERNEL_AVX2 };
+    /* One pattern the literal prefilter can skip lines for, one it cannot */
+    const char *patterns[] = { "status=(ok|err)[0-9]", "[A-Z_]{4}|[0-9]+x" };
+
+    TextBuffer buf;
+    build_buffer(&buf, size);
+
+    for (size_t n = 0; n < sizeof(needles) / sizeof(needles[0]); ++n) {
+        printf("search miss for '%s' over %zu MB, %zu lines\n", needles[n], size >> 20, buf.count);
+        report("strstr-loop", size, best_of(find_strstr, &buf, needles[n]));
+
+        for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+            search_set_kernel(kernels[k]);
+            if (search_active_kernel() != kernels[k]) {
+                continue; /* not supported on this CPU */
+            }
+            report(search_kernel_name(kernels[k]), size, best_of(buffer_find, &buf, needles[n]));
+        }
+        search_set_kernel(SEARCH_KERNEL_AUTO);
+
+        size_t max_threads = parallel_default_threads();
+        for (parallel_threads = 2; parallel_threads <= max_threads; parallel_threads *= 2) {
+            char name[32];
+            snprintf(name, sizeof(name), "%s x%zu", search_kernel_name(search_active_kernel()), parallel_threads);
+            report(name, size, best_of(find_parallel, &buf, needles[n]));
+        }
+    }
+
+    for (size_t n = 0; n < sizeof(patterns) / sizeof(patterns[0]); ++n) {
+        printf("regex miss for /%s/ over %zu MB\n", patterns[n], size >> 20);
+        report("regex", size, best_of(find_regex, &buf, patterns[n]));
+    }
+
+    pattern_cache_clear();
+    buffer_free(&buf);
+    return 0;
+}
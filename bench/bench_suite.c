@@ -0,0 +1,451 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: bench_suite.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+/*
+ * Fixed-seed workloads over the buffer, file and search hot paths. Each
+ * workload prints one JSON object per line with its throughput, latency
+ * percentiles and peak resident memory, so runs can be diffed by scripts.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#include "buffer.h"
+#include "fileio.h"
+
+#define DEFAULT_MEGABYTES 64
+#define MAX_LINE_LENGTH 80
+#define SUITE_SEED 0x5eed2026u
+#define SUITE_FILE "bench_suite.tmp"
+#define SAVE_FILE "bench_suite.out.tmp"
+#define NEEDLE "NEEDLE_TOKEN"
+#define NEEDLE_EVERY 1000   /* lines between planted needles, on average */
+
+#define LOAD_OPS 5
+#define SAVE_OPS 5
+#define EDIT_OPS 10000
+#define SEARCH_HIT_OPS 2000
+#define SEARCH_MISS_OPS 10
+#define REPLACE_STORM_OPS 5000
+#define REPLACE_ALL_OPS 4      /* even, so the needles are back in place after */
+#define OTHER_NEEDLE "OTHER_TOKEN!"
+#define BLOCK_OPS 1000
+#define BLOCK_LINES 10000
+
+typedef struct {
+    TextBuffer buffer;
+    size_t file_lines;
+    unsigned long long rng;
+    double *latency;        /* seconds per operation of the running workload */
+    size_t latency_capacity;
+    int rss_reset;          /* the kernel let us reset the peak for each workload */
+} Suite;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* xorshift64*, so every platform runs the same workload */
+static unsigned long long next_random(Suite *suite)
+{
+    suite->rng ^= suite->rng >> 12;
+    suite->rng ^= suite->rng << 25;
+    suite->rng ^= suite->rng >> 27;
+    return suite->rng * 2685821657736338717ULL;
+}
+
+static size_t random_below(Suite *suite, size_t limit)
+{
+    return limit > 0 ? (size_t)(next_random(suite) % limit) : 0;
+}
+
+/* Linux resets the high-water mark on request; elsewhere it only grows */
+static int reset_peak_rss(void)
+{
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if (!fp) {
+        return 0;
+    }
+    int ok = fputs("5", fp) != EOF;
+    return fclose(fp) == 0 && ok;
+}
+
+static long peak_rss_kb(void)
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+static int compare_seconds(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of the sorted latencies */
+static double percentile(const double *sorted, size_t count, double p)
+{
+    size_t rank = (size_t)(p / 100.0 * (double)count + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted[(rank > count ? count : rank) - 1];
+}
+
+static void begin_workload(Suite *suite, size_t ops)
+{
+    if (ops > suite->latency_capacity) {
+        double *latency = (double *)realloc(suite->latency, ops * sizeof(double));
+        if (!latency) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        suite->latency = latency;
+        suite->latency_capacity = ops;
+    }
+    suite->rss_reset = reset_peak_rss();
+}
+
+static void report(Suite *suite, const char *name, size_t ops, double seconds)
+{
+    qsort(suite->latency, ops, sizeof(double), compare_seconds);
+    printf("{\"workload\":\"%s\",\"ops\":%zu,\"seconds\":%.6f,\"ops_per_sec\":%.1f,"
+           "\"p50_us\":%.3f,\"p90_us\":%.3f,\"p99_us\":%.3f,\"max_us\":%.3f,"
+           "\"lines\":%zu,\"peak_rss_kb\":%ld,\"rss_since_start\":%s}\n",
+           name, ops, seconds, (double)ops / seconds, percentile(suite->latency, ops, 50) * 1e6,
+           percentile(suite->latency, ops, 90) * 1e6, percentile(suite->latency, ops, 99) * 1e6,
+           suite->latency[ops - 1] * 1e6, suite->buffer.count, peak_rss_kb(),
+           suite->rss_reset ? "false" : "true");
+    fflush(stdout);
+}
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "%s failed\n", what);
+    exit(1);
+}
+
+/* Random lines of 0 to MAX_LINE_LENGTH bytes with NEEDLE planted in a few */
+static void write_file(Suite *suite, size_t size)
+{
+    FILE *fp = fopen(SUITE_FILE, "w");
+    if (!fp) {
+        fail("creating " SUITE_FILE);
+    }
+
+    char line[MAX_LINE_LENGTH + sizeof(NEEDLE) + 1];
+    size_t written = 0;
+    suite->file_lines = 0;
+    while (written < size) {
+        size_t len = random_below(suite, MAX_LINE_LENGTH + 1);
+        for (size_t i = 0; i < len; ++i) {
+            line[i] = (char)('a' + random_below(suite, 26));
+        }
+        if (random_below(suite, NEEDLE_EVERY) == 0) {
+            memcpy(line + len, NEEDLE, sizeof(NEEDLE) - 1);
+            len += sizeof(NEEDLE) - 1;
+        }
+        line[len++] = '\n';
+        if (fwrite(line, 1, len, fp) != len) {
+            fail("writing " SUITE_FILE);
+        }
+        written += len;
+        suite->file_lines++;
+    }
+    if (fclose(fp) != 0) {
+        fail("writing " SUITE_FILE);
+    }
+}
+
+static void bench_load(Suite *suite)
+{
+    begin_workload(suite, LOAD_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < LOAD_OPS; ++i) {
+        double t = now_seconds();
+        if (file_load(SUITE_FILE, &suite->buffer) != 0 || suite->buffer.count != suite->file_lines) {
+            fail("file_load");
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, "load", LOAD_OPS, now_seconds() - start);
+}
+
+static void bench_save(Suite *suite)
+{
+    begin_workload(suite, SAVE_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < SAVE_OPS; ++i) {
+        double t = now_seconds();
+        if (file_save(SAVE_FILE, &suite->buffer) != 0) {
+            fail("file_save");
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, "save", SAVE_OPS, now_seconds() - start);
+    remove(SAVE_FILE);
+}
+
+typedef enum {
+    AT_FRONT,
+    AT_MIDDLE,
+    AT_END,
+    AT_RANDOM
+} EditPosition;
+
+static size_t pick_line(Suite *suite, EditPosition where, size_t count)
+{
+    switch (where) {
+    case AT_FRONT:
+        return 0;
+    case AT_MIDDLE:
+        return count / 2;
+    case AT_END:
+        return count;
+    default:
+        return random_below(suite, count + 1);
+    }
+}
+
+static void bench_insert(Suite *suite, const char *name, EditPosition where)
+{
+    static const char text[] = "an inserted line of a typical length for source code";
+
+    begin_workload(suite, EDIT_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < EDIT_OPS; ++i) {
+        size_t line = pick_line(suite, where, suite->buffer.count);
+        double t = now_seconds();
+        if (buffer_insert_line_n(&suite->buffer, line, text, sizeof(text) - 1) != 0) {
+            fail("buffer_insert_line_n");
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, name, EDIT_OPS, now_seconds() - start);
+}
+
+static void bench_delete(Suite *suite, const char *name, EditPosition where)
+{
+    begin_workload(suite, EDIT_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < EDIT_OPS; ++i) {
+        size_t line = pick_line(suite, where, suite->buffer.count - 1);
+        double t = now_seconds();
+        if (buffer_delete_line(&suite->buffer, line) != 0) {
+            fail("buffer_delete_line");
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, name, EDIT_OPS, now_seconds() - start);
+}
+
+static void bench_replace(Suite *suite)
+{
+    static const char text[] = "a replaced line";
+
+    begin_workload(suite, EDIT_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < EDIT_OPS; ++i) {
+        size_t line = random_below(suite, suite->buffer.count);
+        double t = now_seconds();
+        if (buffer_replace_line_n(&suite->buffer, line, text, sizeof(text) - 1) != 0) {
+            fail("buffer_replace_line_n");
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, "replace_random", EDIT_OPS, now_seconds() - start);
+}
+
+/*
+ * Swaps every needle for another string of the same length and back, with
+ * buffer_replace_all or, when `batch` is not set, one line replace per hit.
+ */
+static void bench_replace_all(Suite *suite, const char *name, int batch)
+{
+    char line[MAX_LINE_LENGTH * 2 + sizeof(NEEDLE) * 2];
+    BufferMatch match;
+
+    begin_workload(suite, REPLACE_ALL_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < REPLACE_ALL_OPS; ++i) {
+        const char *from = i % 2 ? OTHER_NEEDLE : NEEDLE;
+        const char *to = i % 2 ? NEEDLE : OTHER_NEEDLE;
+        size_t replaced = 0;
+        BufferSearch search;
+        buffer_search_init(&search, from);
+        double t = now_seconds();
+        if (batch) {
+            if (buffer_replace_all(&suite->buffer, &search, to, sizeof(NEEDLE) - 1, NULL, NULL, &replaced) != 0) {
+                fail(name);
+            }
+        }
+        while (!batch && buffer_find_all(&suite->buffer, &search, &match, 1) == 1) {
+            size_t len = 0;
+            const char *text = buffer_get_line_n(&suite->buffer, match.line, &len);
+            if (!text || len > sizeof(line)) {
+                fail(name);
+            }
+            memcpy(line, text, len);
+            memcpy(line + match.column, to, match.length);
+            if (buffer_replace_line_n(&suite->buffer, match.line, line, len) != 0) {
+                fail(name);
+            }
+            replaced++;
+        }
+        suite->latency[i] = now_seconds() - t;
+        if (replaced == 0) {
+            fail(name);
+        }
+    }
+    report(suite, name, REPLACE_ALL_OPS, now_seconds() - start);
+}
+
+typedef enum {
+    BLOCK_MOVE,
+    BLOCK_COPY,
+    BLOCK_DELETE
+} BlockEdit;
+
+/* Block edits of BLOCK_LINES lines at random spots; copies then deletes keep the size */
+static void bench_block(Suite *suite, const char *name, BlockEdit edit)
+{
+    begin_workload(suite, BLOCK_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < BLOCK_OPS; ++i) {
+        size_t count = suite->buffer.count;
+        size_t line = random_below(suite, count - BLOCK_LINES + 1);
+        int rc;
+        double t = now_seconds();
+        if (edit == BLOCK_MOVE) {
+            rc = buffer_move_lines(&suite->buffer, line, BLOCK_LINES, random_below(suite, count - BLOCK_LINES + 1));
+        } else if (edit == BLOCK_COPY) {
+            rc = buffer_copy_lines(&suite->buffer, line, BLOCK_LINES, random_below(suite, count + 1));
+        } else {
+            rc = buffer_delete_lines(&suite->buffer, line, BLOCK_LINES);
+        }
+        if (rc != 0) {
+            fail(name);
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, name, BLOCK_OPS, now_seconds() - start);
+}
+
+/* Finds the next needle at or after a random line, wrapping to the top */
+static int find_from(Suite *suite, const char *needle, size_t line, BufferMatch *match)
+{
+    BufferSearch search;
+    buffer_search_init(&search, needle);
+    search.line = line;
+    if (buffer_find_all(&suite->buffer, &search, match, 1) == 1) {
+        return 1;
+    }
+    buffer_search_init(&search, needle);
+    return buffer_find_all(&suite->buffer, &search, match, 1) == 1;
+}
+
+static void bench_search(Suite *suite, const char *name, const char *needle, size_t ops, int expect_hit)
+{
+    BufferMatch match;
+
+    begin_workload(suite, ops);
+    double start = now_seconds();
+    for (size_t i = 0; i < ops; ++i) {
+        size_t line = random_below(suite, suite->buffer.count);
+        double t = now_seconds();
+        if (find_from(suite, needle, line, &match) != expect_hit) {
+            fail(name);
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, name, ops, now_seconds() - start);
+}
+
+/*
+ * Find-and-replace at random spots: every hit's line is rewritten with the
+ * needle moved to the front, so hits never run out and edits pile up.
+ */
+static void bench_replace_storm(Suite *suite)
+{
+    char line[MAX_LINE_LENGTH * 2 + sizeof(NEEDLE) * 2];
+    BufferMatch match;
+
+    begin_workload(suite, REPLACE_STORM_OPS);
+    double start = now_seconds();
+    for (size_t i = 0; i < REPLACE_STORM_OPS; ++i) {
+        size_t from = random_below(suite, suite->buffer.count);
+        double t = now_seconds();
+        if (!find_from(suite, NEEDLE, from, &match)) {
+            fail("replace storm search");
+        }
+        size_t len = 0;
+        const char *text = buffer_get_line_n(&suite->buffer, match.line, &len);
+        if (!text || len + sizeof(NEEDLE) > sizeof(line)) {
+            fail("replace storm line");
+        }
+        memcpy(line, NEEDLE, sizeof(NEEDLE) - 1);
+        memcpy(line + sizeof(NEEDLE) - 1, text, match.column);
+        memcpy(line + sizeof(NEEDLE) - 1 + match.column, text + match.column + match.length,
+               len - match.column - match.length);
+        if (buffer_replace_line_n(&suite->buffer, match.line, line, len) != 0) {
+            fail("replace storm edit");
+        }
+        suite->latency[i] = now_seconds() - t;
+    }
+    report(suite, "replace_storm", REPLACE_STORM_OPS, now_seconds() - start);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_MEGABYTES;
+    size_t size = (megabytes ? megabytes : DEFAULT_MEGABYTES) * 1024 * 1024;
+
+    Suite suite;
+    memset(&suite, 0, sizeof(suite));
+    suite.rng = SUITE_SEED;
+    buffer_init(&suite.buffer);
+    write_file(&suite, size);
+    printf("{\"suite\":\"bench_suite\",\"megabytes\":%zu,\"lines\":%zu,\"seed\":%u}\n", size >> 20,
+           suite.file_lines, SUITE_SEED);
+
+    bench_load(&suite);
+    bench_search(&suite, "search_hit", NEEDLE, SEARCH_HIT_OPS, 1);
+    bench_search(&suite, "search_miss", "MISSING_TOKEN", SEARCH_MISS_OPS, 0);
+    bench_insert(&suite, "insert_end", AT_END);
+    bench_insert(&suite, "insert_front", AT_FRONT);
+    bench_insert(&suite, "insert_middle", AT_MIDDLE);
+    bench_insert(&suite, "insert_random", AT_RANDOM);
+    bench_delete(&suite, "delete_random", AT_RANDOM);
+    bench_delete(&suite, "delete_end", AT_END);
+    bench_replace(&suite);
+    bench_replace_storm(&suite);
+    bench_replace_all(&suite, "replace_each", 0);
+    bench_replace_all(&suite, "replace_all", 1);
+    bench_block(&suite, "block_move", BLOCK_MOVE);
+    bench_block(&suite, "block_copy", BLOCK_COPY);
+    bench_block(&suite, "block_delete", BLOCK_DELETE);
+    bench_save(&suite);
+
+    buffer_free(&suite.buffer);
+    free(suite.latency);
+    remove(SUITE_FILE);
+    return 0;
+}
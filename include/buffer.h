@@ -3,7 +3,7 @@
  * File: buffer.h
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
@@ -12,26 +12,393 @@
 
 #include <stddef.h>
 
+#include "pattern.h"
+
 #define INVALID_INDEX ((size_t)-1)
 
+/*
+ * The buffer is a line-oriented piece table. Text lives in sources: the
+ * original file bytes (used in place, never modified) and an append-only
+ * arena of add blocks that receives every inserted or replaced line.
+ * The document is the concatenation of pieces, each naming a run of
+ * consecutive lines in one source, so an edit only touches the piece list.
+ * The list is a flat array with each piece's line and offset stored in it,
+ * so an edit shifts and renumbers the pieces after it: O(pieces after the
+ * edit), never O(bytes), but cheaper near the end of a heavily edited file.
+ */
+
+/* Piece source 0 is the original file; source n > 0 is arena block n - 1 */
+#define PIECE_ORIGINAL 0
+
+/* Default capacity of an arena block; longer lines get a block of their own */
+#define ARENA_BLOCK_SIZE (256 * 1024)
+
+typedef void (*BufferReleaseFn)(void *data, size_t size);
+
 typedef struct {
-    char **lines;
-    size_t count;
+    char *data;
+    size_t size;
     size_t capacity;
+    size_t *starts;     /* byte offset of each line, then one past the last terminator */
+    size_t line_count;
+    size_t line_capacity;
+    BufferReleaseFn release;
+} TextSource;
+
+/*
+ * Slab arena for added lines: blocks never move, and are freed wholesale.
+ * Only the newest line of the open block is ever rewritten in place; the
+ * bytes of any other replaced line stay used until the buffer is freed.
+ */
+typedef struct {
+    TextSource *blocks;
+    size_t block_count;
+    size_t block_capacity;
+    size_t open;        /* piece source of the block short lines go to, if any */
+    size_t pinned;      /* live snapshots; the tail line is not rewritten while any */
+    int tail_shared;    /* a copied block references the open block's last line twice */
+} LineArena;
+
+typedef struct {
+    size_t source;      /* PIECE_ORIGINAL or an arena block */
+    size_t first;       /* first line within the source */
+    size_t count;       /* number of lines covered */
+    size_t line;        /* buffer line at which this piece starts */
+    size_t offset;      /* document byte offset at which this piece starts */
+} Piece;
+
+/*
+ * Gap buffer for the line under character-level editing. Its edits reach
+ * the piece table in one replace when anything else reads or changes the
+ * buffer, so a keystroke costs O(1) amortized however long the line is.
+ */
+typedef struct {
+    char *data;
+    size_t capacity;
+    size_t gap_start;
+    size_t gap_end;
+    size_t line;        /* document line held, or INVALID_INDEX */
+    int dirty;          /* holds edits the pieces do not have yet */
+} LineGap;
+
+/* NUL-terminated copies of lines for buffer_get_line; private to buffer.c */
+typedef struct LineCopies LineCopies;
+
+typedef struct {
+    TextSource original;
+    LineArena arena;
+    Piece *pieces;
+    size_t piece_count;
+    size_t piece_capacity;
+    size_t count;       /* total number of lines */
+    LineCopies *copies; /* NULL until the buffer has lines that need copying */
+    int original_crlf;  /* some original line ends in CR, which saving drops */
+    size_t *original_cr;    /* CRs dropped before each original line, if original_crlf */
+    LineGap edit;
 } TextBuffer;
 
 void buffer_init(TextBuffer *buffer);
 void buffer_free(TextBuffer *buffer);
 
+/*
+ * Replaces the contents of `buffer` with the newline-separated lines in
+ * `data`. The bytes are only read, never copied or written, so they may be
+ * a read-only file mapping; ownership passes to the buffer, which hands
+ * them to `release` (if non-NULL) when freed.
+ * Returns 0 on success, non-zero on error (the data is released either way).
+ */
+int buffer_attach_original(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release);
+
+/*
+ * Same, with the newline scan that builds the line table split into chunks
+ * on up to `threads` workers. Small data is scanned by the caller alone.
+ */
+int buffer_attach_original_parallel(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release,
+                                    size_t threads);
+
+/*
+ * Same as buffer_attach_original_parallel when the start of every
+ * `stride`-th line is known, `samples[k]` being where line k * stride
+ * starts, and `data` has `lines` lines: the scan is split at those lines,
+ * so every chunk knows where its line starts go and `data` is read once
+ * rather than counted first. Samples that do not match `data` only cost
+ * that speed-up.
+ */
+int buffer_attach_original_sampled(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release,
+                                   size_t threads, const size_t *samples, size_t sample_count, size_t stride,
+                                   size_t lines);
+
+/*
+ * Huge files: attaches `data` like buffer_attach_original but indexes only
+ * the lines that end within its first `prefix` bytes, so the call costs the
+ * same however large `data` is. The rest is pending until a scan hands its
+ * line ends to buffer_extend_original.
+ */
+int buffer_attach_original_lazy(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release,
+                                size_t prefix);
+
+/* Bytes of the original not indexed yet; 0 once every line is known */
+size_t buffer_original_pending(const TextBuffer *buffer);
+
+/*
+ * Indexes `count` more original lines, given by the offsets one past their
+ * '\n' in increasing order, and appends them to the end of the document.
+ * With `last` set the bytes after the final one, if any, become a last
+ * unterminated line and the original is complete.
+ * Returns 0 on success, non-zero on error (the document is unchanged).
+ */
+int buffer_extend_original(TextBuffer *buffer, const size_t *ends, size_t count, int last);
+
 int buffer_insert_line(TextBuffer *buffer, size_t index, const char *text);
 int buffer_append_line(TextBuffer *buffer, const char *text);
 int buffer_delete_line(TextBuffer *buffer, size_t index);
 int buffer_replace_line(TextBuffer *buffer, size_t index, const char *text);
 
+/* The same with an explicit length, so the text may contain NUL bytes */
+int buffer_insert_line_n(TextBuffer *buffer, size_t index, const char *text, size_t len);
+int buffer_append_line_n(TextBuffer *buffer, const char *text, size_t len);
+int buffer_replace_line_n(TextBuffer *buffer, size_t index, const char *text, size_t len);
+
+/*
+ * Block edits. Each splits the piece list at the block's ends and moves
+ * the pieces in between with one memmove, so it costs time proportional
+ * to the pieces (plus the text inserted), however many lines it covers.
+ *
+ * delete: removes `count` lines from line `index`.
+ * insert: inserts the lines of `text` before line `index`; lines are
+ *     separated by '\n', so "a\nb" is two lines and "" one empty line.
+ * move: moves `count` lines from `index` so that they start at line
+ *     `dest` of the document without them (0 to count lines left).
+ * copy: inserts a copy of `count` lines from `index` before line `dest`.
+ *     The copy shares the text of the original lines.
+ * Return 0 on success, non-zero on error (the document is unchanged).
+ */
+int buffer_delete_lines(TextBuffer *buffer, size_t index, size_t count);
+int buffer_insert_lines(TextBuffer *buffer, size_t index, const char *text, size_t len);
+int buffer_move_lines(TextBuffer *buffer, size_t index, size_t count, size_t dest);
+int buffer_copy_lines(TextBuffer *buffer, size_t index, size_t count, size_t dest);
+
+/* New contents for one line, for the batch edits below */
+typedef struct {
+    size_t line;
+    const char *text;
+    size_t len;
+} BufferLineEdit;
+
+/*
+ * Replaces the lines named in `edits`, given in increasing line order, by
+ * rebuilding the piece list in one pass instead of splicing each line in.
+ * Return 0 on success, non-zero on error (the document is unchanged).
+ */
+int buffer_replace_lines(TextBuffer *buffer, const BufferLineEdit *edits, size_t count);
+
+/*
+ * Character-level edits of line `index`: insert `len` bytes of `text` (no
+ * newlines) before byte `column`, or delete `count` bytes from `column`.
+ * Consecutive edits of one line go to its gap buffer. Line-level edits
+ * move them into the piece table first, and buffer_get_line shows them;
+ * the other readers fail while edits are pending, so call
+ * buffer_sync_edit after a run of character edits.
+ * Return 0 on success, non-zero on error.
+ */
+int buffer_insert_chars(TextBuffer *buffer, size_t index, size_t column, const char *text, size_t len);
+int buffer_delete_chars(TextBuffer *buffer, size_t index, size_t column, size_t count);
+
+/* Moves pending character edits into the piece table; 0 on success */
+int buffer_sync_edit(TextBuffer *buffer);
+
+/*
+ * Returns line `index` NUL-terminated. Added lines are returned in place;
+ * a line of the original is copied on its first request and the copy is
+ * kept, so every line has its own pointer, valid until that line is
+ * changed, the buffer is rebased onto a saved file, or it is freed. A line
+ * with pending character edits is copied as it stands, valid until the
+ * next edit. Keeping the copies makes this unsafe to call from several
+ * threads at once. A line holding a NUL byte appears cut short;
+ * buffer_get_line_n sees all of it.
+ */
 const char *buffer_get_line(const TextBuffer *buffer, size_t index);
+
+/*
+ * Returns line `index` in place, without copying, and its length in `*len`.
+ * The bytes are not NUL-terminated and stay valid until the buffer is next
+ * modified.
+ */
+const char *buffer_get_line_n(const TextBuffer *buffer, size_t index, size_t *len);
 void buffer_print(const TextBuffer *buffer);
 
+/*
+ * Byte positions in the document as saved: every line followed by '\n'.
+ * Pieces carry their starting offset and sources their line starts, so
+ * each lookup is two binary searches.
+ */
+size_t buffer_size(const TextBuffer *buffer);
+/* Length of line `index` without its newline; INVALID_INDEX if out of range */
+size_t buffer_line_length(const TextBuffer *buffer, size_t index);
+/* Offset of the start of line `index`; buffer_size for index == count */
+size_t buffer_line_offset(const TextBuffer *buffer, size_t index);
+/*
+ * Line holding byte `offset`, and the byte's column within it if `column`
+ * is non-NULL (the newline sits at column == length). INVALID_INDEX if the
+ * offset is past the end.
+ */
+size_t buffer_line_at_offset(const TextBuffer *buffer, size_t offset, size_t *column);
+
+/* What the buffer's structures hold against what they have allocated */
+typedef struct {
+    size_t document_bytes;      /* buffer_size */
+    size_t original_bytes;      /* the file, mapped or read */
+    size_t index_used;          /* line start tables of the original and arena blocks */
+    size_t index_capacity;
+    size_t pieces_used;
+    size_t pieces_capacity;
+    size_t arena_used;          /* added line text */
+    size_t arena_capacity;
+    size_t other_bytes;         /* block table, gap buffer, line copies, CR counts */
+} BufferMemoryStats;
+
+/* Costs time proportional to the number of arena blocks */
+void buffer_memory_stats(const TextBuffer *buffer, BufferMemoryStats *stats);
+
+/* A run of document bytes, newlines included, that can be written as-is */
+typedef struct {
+    const char *data;
+    size_t len;
+} BufferSpan;
+
+/*
+ * Describes document lines [`*line`, `end_line`) as up to `max` (at least 2)
+ * spans that point into the buffer's sources without copying, and advances
+ * `*line` past the lines covered. Runs of untouched lines share one span.
+ * Returns the number of spans stored; 0 once `*line` reaches `end_line`.
+ * The spans stay valid until the buffer is next modified.
+ */
+size_t buffer_get_spans(const TextBuffer *buffer, size_t *line, size_t end_line, BufferSpan *out, size_t max);
+
+/*
+ * The whole document as spans, to write out while the buffer keeps being
+ * edited. Until it is released the arena stops rewriting its last line in
+ * place, so every span stays valid through later edits; the buffer must
+ * not be freed, reattached or rebased meanwhile.
+ */
+typedef struct {
+    BufferSpan *spans;
+    size_t count;
+    size_t size;        /* bytes */
+} BufferSnapshot;
+
+/* Costs time proportional to the number of spans; returns 0 on success */
+int buffer_snapshot(TextBuffer *buffer, BufferSnapshot *snapshot);
+void buffer_snapshot_release(TextBuffer *buffer, BufferSnapshot *snapshot);
+
+/* Document lines that occupy the same bytes as in the original source */
+typedef struct {
+    size_t line;        /* first document line */
+    size_t count;
+    size_t offset;      /* byte offset, the same in the original and the document */
+    size_t len;         /* bytes, newlines included */
+} BufferRange;
+
+/*
+ * How the saved document differs from the original source. The piece table
+ * is the record of what changed: lines still served by the original at their
+ * own position are clean. Up to `suffix_line`, every other line has the same
+ * length as the original line it replaces and is listed in `patches`; from
+ * `suffix_line` on, the document no longer lines up with the original.
+ */
+typedef struct {
+    BufferRange *patches;
+    size_t patch_count;
+    size_t patch_capacity;
+    size_t suffix_line;     /* buffer count if the document lines up throughout */
+    size_t suffix_offset;
+    size_t size;            /* bytes in the saved document */
+} BufferDiff;
+
+/* Costs time proportional to the edited lines and the suffix, not the file */
+int buffer_diff_original(const TextBuffer *buffer, BufferDiff *diff);
+void buffer_diff_free(BufferDiff *diff);
+
+/*
+ * Makes `data`, the document as just saved, the new original source. The
+ * offsets of the first `keep` original lines are reused, so only the rest
+ * of `data` is scanned for newlines. Ownership of `data` passes to the buffer
+ * as in buffer_attach_original. Returns 0 on success; on failure the buffer
+ * is left empty.
+ */
+int buffer_rebase_original(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release, size_t keep);
+
+/*
+ * Makes `data`, the whole document just saved, the new original source
+ * without scanning it: its line table comes from the pieces, which it holds
+ * back to back. Fails, releasing `data`, while character edits or a
+ * snapshot are pending or when `size` is not buffer_size; the document is
+ * unchanged either way.
+ */
+int buffer_rebase_saved(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release);
+
 /* Returns index of the first matching line, or INVALID_INDEX if not found */
 size_t buffer_find(const TextBuffer *buffer, const char *needle);
 
+typedef struct {
+    size_t line;
+    size_t column;      /* byte offset of the match within the line */
+    size_t length;      /* bytes matched; 0 for an empty regex match */
+} BufferMatch;
+
+/* Resumable search position, so paging through results never rescans */
+typedef struct {
+    const char *needle;     /* literal, or the literal every regex match contains */
+    size_t needle_len;
+    Pattern *pattern;       /* NULL for a literal search */
+    size_t line;
+    size_t column;
+    int after_match;        /* the position ends a non-empty match */
+} BufferSearch;
+
+void buffer_search_init(BufferSearch *search, const char *needle);
+/* Searches for `len` bytes of `needle`, which may contain NUL bytes */
+void buffer_search_init_n(BufferSearch *search, const char *needle, size_t len);
+
+/*
+ * Searches for matches of `pattern`, which the caller keeps alive for the
+ * life of the search (a pattern from pattern_cache_get stays alive until
+ * it is released). Lines without the pattern's required literal are
+ * skipped with the substring kernels before the automaton runs. An empty
+ * match right where another match ended is skipped, so x* finds "xx" in
+ * "axxb" but not the empty string after it.
+ */
+void buffer_search_init_regex(BufferSearch *search, Pattern *pattern);
+
+/*
+ * Stores up to `max` non-overlapping matches at or after the search position
+ * in `out`, in document order, and moves the position past the last one.
+ * Returns the number of matches stored; 0 means the search is exhausted.
+ */
+size_t buffer_find_all(const TextBuffer *buffer, BufferSearch *search, BufferMatch *out, size_t max);
+
+/*
+ * Same results as buffer_find_all, but the lines after the search position
+ * are split into ranges scanned on up to `threads` workers and merged back
+ * in line order. The buffer must not be modified during the call.
+ * Regex searches run on the calling thread, since patterns are not shared.
+ */
+size_t buffer_find_all_parallel(const TextBuffer *buffer, BufferSearch *search, BufferMatch *out, size_t max,
+                                size_t threads);
+
+/* Sees a replace-all's new lines before they go in; non-zero cancels it */
+typedef int (*BufferReplaceFn)(void *context, const BufferLineEdit *edits, size_t count);
+
+/*
+ * Replaces every match of `search` from its position on with `len` bytes
+ * of `replacement`, which may not contain a newline. The matches are found
+ * in one scan and their lines rewritten into a scratch block, then swapped
+ * in together with buffer_replace_lines, after `prepare` (if non-NULL) has
+ * seen them. Pending character edits are synced first, so they are
+ * searched too. Stores the number of matches replaced in `*out_count`.
+ * Return 0 on success, non-zero on error (the document is unchanged).
+ */
+int buffer_replace_all(TextBuffer *buffer, BufferSearch *search, const char *replacement, size_t len,
+                       BufferReplaceFn prepare, void *context, size_t *out_count);
+
 #endif /* BUFFER_H */
@@ -3,25 +3,71 @@
  * File: editor.h
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
 #ifndef EDITOR_H
 #define EDITOR_H
 
+#include <stdio.h>
+
 #include "buffer.h"
+#include "fileio.h"
+#include "history.h"
 
 #define EDITOR_FILENAME_MAX 260
 
+/* File pages a huge file may keep resident around the viewed lines */
+#define EDITOR_PAGE_BUDGET ((size_t)64 * 1024 * 1024)
+
 typedef struct {
     TextBuffer buffer;
     char current_filename[EDITOR_FILENAME_MAX];
     int is_modified;
+    int save_in_place;      /* saves patch the file in place; see file_save_incremental */
+    size_t search_threads;  /* workers used by the search command */
+    FileStamp stamp;        /* the file on disk the buffer's original matches */
+    History history;        /* undo/redo log of the buffer's edits */
+    FileSaveJob save_job;   /* background save, if one is running */
+    FileIndexJob index_job; /* background line indexing of a huge file */
+    FileLineIndex line_cache;   /* the file's line cache, if it had or now has one */
+    int huge_file;          /* loaded in huge-file mode */
+    size_t page_budget;     /* bytes of a huge file's pages kept resident */
+    size_t view_top;        /* first line of the last page viewed */
+    char *view;             /* rendered page, reused across renders */
+    size_t view_len;
+    size_t view_capacity;
 } EditorState;
 
+/* Script commands applied and, on failure, where and why it stopped */
+typedef struct {
+    size_t commands;
+    size_t line;            /* script line of the failed command */
+    const char *error;
+} EditorScriptResult;
+
 void editor_init(EditorState *editor, const char *filename);
+/* Like editor_init; `quiet` suppresses the messages about the file */
+void editor_init_with(EditorState *editor, const char *filename, int quiet);
 void editor_run(EditorState *editor);
+
+/*
+ * Applies a command script without any menu or prompt output. Each line is
+ * one command; line numbers are 1-based, and text runs to the end of the
+ * line after a single space:
+ *   a TEXT      append a line        i N TEXT    insert before line N
+ *   r N TEXT    replace line N       d N         delete line N
+ *   D F L       delete lines F to L
+ *   m F L N     move lines F to L before line N
+ *   c F L N     copy lines F to L before line N
+ *   w [FILE]    save, to the current file if FILE is omitted
+ * Blank lines and lines starting with '#' are skipped. Edits bypass the
+ * undo history. Stops at the first failing command. A huge file is fully
+ * indexed before the first command runs.
+ * Returns 0 on success, -1 with `result->error` set otherwise.
+ */
+int editor_run_script(EditorState *editor, FILE *script, EditorScriptResult *result);
 void editor_free(EditorState *editor);
 
 #endif /* EDITOR_H */
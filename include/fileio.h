@@ -3,15 +3,103 @@
  * File: fileio.h
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
 #ifndef FILEIO_H
 #define FILEIO_H
 
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
 #include "buffer.h"
 
+/* Files at least this large are memory-mapped by FILE_MAP_AUTO */
+#define FILE_MAP_THRESHOLD (1024 * 1024)
+
+typedef enum {
+    FILE_MAP_AUTO = 0,  /* map large regular files, read small ones */
+    FILE_MAP_NEVER,
+    FILE_MAP_ALWAYS
+} FileMapMode;
+
+/* Identifies the exact version of a file a buffer was loaded from */
+typedef struct {
+    int valid;
+    unsigned long long device;
+    unsigned long long inode;
+    long long size;
+    long long mtime_sec;
+    long mtime_nsec;
+} FileStamp;
+
+/*
+ * Huge-file mode: a mapped file of at least `lazy_threshold` bytes has only
+ * the lines in its first FILE_INDEX_PREFIX bytes indexed before loading
+ * returns, so the first view costs the same however large the file is. A
+ * thread finds the remaining line ends, giving back each stretch's pages
+ * once scanned, and file_index_collect appends them to the document. The
+ * document cannot be saved until the whole file is indexed.
+ */
+#define FILE_LAZY_THRESHOLD ((size_t)512 * 1024 * 1024)
+#define FILE_INDEX_PREFIX (1024 * 1024)
+#define FILE_INDEX_CHUNK (16 * 1024 * 1024)
+
+/*
+ * Line cache: a sidecar `<file>.lidx` holding where every FILE_LINE_STRIDE-th
+ * line of the file starts, written once a file of at least `line_cache_min`
+ * bytes has been indexed. A later load uses it only while the file's size,
+ * mtime and a checksum of its first and last FILE_LINE_CHECK bytes match.
+ * The newline scan then needs no counting pass, and in huge-file mode any
+ * line can be reached at once with file_line_span before it is indexed.
+ */
+#define FILE_LINE_STRIDE 1024
+#define FILE_LINE_CHECK (64 * 1024)
+#define FILE_LINE_CACHE_MIN ((size_t)16 * 1024 * 1024)
+#define FILE_LINE_CACHE_SUFFIX ".lidx"
+
+typedef struct {
+    size_t lines;           /* lines in the file; 0 if not known */
+    size_t stride;
+    size_t *samples;        /* samples[k]: where line k * stride starts */
+    size_t sample_count;
+} FileLineIndex;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    const char *data;       /* the buffer's mapping of the file */
+    size_t size;
+    size_t from;            /* where the thread's scan starts */
+    size_t *ends;           /* line ends found and not collected yet, under `lock` */
+    size_t end_count;
+    size_t end_capacity;
+    size_t scanned;         /* bytes of the file scanned so far, under `lock` */
+    int running;            /* started and not yet finished with file_index_collect */
+    int joined;
+    atomic_int done;        /* set by the thread once everything it found is in `ends` */
+    atomic_int cancel;
+    int failed;             /* the thread ran out of memory */
+    char *cache_path;       /* line cache to write once indexed, or NULL */
+    FileStamp cache_stamp;
+    unsigned long long cache_checksum;
+    FileLineIndex *line_cache;  /* receives the samples written, if non-NULL */
+} FileIndexJob;
+
+typedef struct {
+    FileMapMode map;
+    FileStamp *stamp;   /* filled in for the loaded file if non-NULL */
+    size_t threads;     /* workers finding line ends; 0 uses every CPU */
+    FileIndexJob *index;    /* if non-NULL, large files load in huge-file mode */
+    size_t lazy_threshold;  /* FILE_LAZY_THRESHOLD unless changed */
+    FileLineIndex *line_cache;  /* if non-NULL, the line cache is used and kept up to date */
+    size_t line_cache_min;  /* FILE_LINE_CACHE_MIN unless changed */
+} FileLoadOptions;
+
+void file_load_options_init(FileLoadOptions *options);
+
 /*
  * Loads the contents of `filename` into `buffer`.
  * Returns 0 on success, non-zero on error.
@@ -19,10 +107,213 @@
  */
 int file_load(const char *filename, TextBuffer *buffer);
 
+/*
+ * Same as file_load with explicit options. A mapped file is never copied:
+ * untouched lines are read straight from the mapping, and only edited lines
+ * take up memory of their own.
+ */
+int file_load_with(const char *filename, TextBuffer *buffer, const FileLoadOptions *options);
+
+void file_index_job_init(FileIndexJob *job);
+
+void file_line_index_init(FileLineIndex *index);
+void file_line_index_free(FileLineIndex *index);
+
+/*
+ * Where line `line` (0-based) of the file behind `buffer` starts, found
+ * from the loaded line cache in `index` by scanning at most one stride of
+ * lines. Returns 0, or -1 if the cache does not cover the line or no
+ * longer matches the file.
+ */
+int file_line_locate(const FileLineIndex *index, const TextBuffer *buffer, size_t line, size_t *offset);
+
+/*
+ * Lines [`line`, `end_line`) of the file behind `buffer` as one span of
+ * the file's bytes, line ends included, found through the line cache even
+ * where they are not indexed yet. Returns 0, or -1 like file_line_locate.
+ */
+int file_line_span(const FileLineIndex *index, const TextBuffer *buffer, size_t line, size_t end_line,
+                   BufferSpan *out);
+
+/*
+ * Appends the lines the indexing thread has found since the last call to
+ * `buffer`, first waiting for the whole file if `wait` is set. Returns 1
+ * once the file is indexed (or no job was running), 0 while the thread is
+ * still going, -1 if lines were lost for lack of memory. Once indexed,
+ * the file's line cache is written if the load asked for one.
+ */
+int file_index_collect(FileIndexJob *job, TextBuffer *buffer, int wait);
+
+/* Stops the indexing thread; needed before the buffer is freed or replaced */
+void file_index_cancel(FileIndexJob *job);
+
+/* Percent of the file indexed so far */
+unsigned file_index_progress(FileIndexJob *job);
+
+/*
+ * Gives back the pages of a mapped original outside the `budget` bytes
+ * around byte `offset` of it. They are clean, so the kernel simply reads
+ * them again if they are needed. Does nothing for originals read into memory.
+ */
+void file_trim_mapping(const TextBuffer *buffer, size_t offset, size_t budget);
+
+/*
+ * Returns 1, and forgets it, if a mapped original was found cut short by
+ * another process since the last call. The pages lost with it read as NUL
+ * bytes instead of raising SIGBUS, so the document is no longer the file's
+ * old contents past that point. Mapping installs a SIGBUS handler for this;
+ * faults outside the mapped originals go to the handler it replaced.
+ */
+int file_mapping_truncated(void);
+
 /*
  * Saves the contents of `buffer` into `filename`.
- * Returns 0 on success, non-zero on error.
+ * The data is written to a temporary file next to `filename` with batched
+ * writev calls, synced, and renamed over it, so a crash leaves either the
+ * old or the new file and a file the buffer is still mapping is never
+ * truncated. Returns 0 on success, non-zero on error.
  */
 int file_save(const char *filename, const TextBuffer *buffer);
 
+typedef enum {
+    FILE_SAVE_UNCHANGED,    /* the file already held the document */
+    FILE_SAVE_PATCHED,      /* only changed lines were rewritten, in place */
+    FILE_SAVE_SUFFIX,       /* rewritten in place from the first line that moved */
+    FILE_SAVE_FULL          /* written whole through file_save */
+} FileSaveMode;
+
+typedef struct {
+    FileSaveMode mode;
+    size_t bytes_written;
+    int rebased;            /* the saved file became the buffer's original */
+} FileSaveResult;
+
+const char *file_save_mode_name(FileSaveMode mode);
+
+/*
+ * Saves `buffer` into `filename` through file_save, then makes the saved
+ * file the buffer's original with buffer_rebase_saved and fills in `stamp`,
+ * so the buffer no longer holds its edits separately. `result->mode` is
+ * FILE_SAVE_FULL. If the saved file cannot become the original,
+ * `result->rebased` is 0: the file is saved and the buffer unchanged, but
+ * `stamp` is invalid, so the next save writes the whole file again.
+ * Returns 0 on success, non-zero on error.
+ */
+int file_save_full(const char *filename, TextBuffer *buffer, FileStamp *stamp, FileSaveResult *result);
+
+/*
+ * Saves `buffer` into `filename`, writing only what changed when `stamp`
+ * shows the file is still the one the buffer's original was loaded from.
+ * Lines that kept their length are patched in place; from the first line
+ * that moved, the rest of the file is streamed in place. Anything else
+ * (another file, CRLF line ends, edits that move text both ways) goes
+ * through file_save_full.
+ *
+ * This gives up file_save's guarantee: a crash, a full disk or an I/O
+ * error between the first in-place write and the final fsync leaves a
+ * file that is partly old and partly new, with no copy of either. Use it
+ * only where that is an accepted trade for save time; file_save_full is
+ * the safe default. A file that shrinks is cut short only once the buffer
+ * no longer maps its old bytes.
+ *
+ * Afterwards the saved file is the buffer's original and `stamp` describes
+ * it, so the next save again costs time proportional to the edits.
+ * Returns 0 on success, non-zero on error.
+ */
+int file_save_incremental(const char *filename, TextBuffer *buffer, FileStamp *stamp, FileSaveResult *result);
+
+/* Like file_save, for a snapshot taken with buffer_snapshot */
+int file_save_snapshot(const char *filename, const BufferSnapshot *snapshot);
+
+/* A save of a buffer snapshot running on a thread of its own */
+typedef struct {
+    pthread_t thread;
+    BufferSnapshot snapshot;
+    char *filename;
+    mode_t mode;            /* permissions of the saved file, found before the thread starts */
+    int running;            /* started and not yet finished with file_save_finish */
+    atomic_int done;        /* set by the thread when it is about to exit */
+    int result;             /* 0 or -1, valid once finished */
+    int error;              /* errno of a failed save */
+} FileSaveJob;
+
+void file_save_job_init(FileSaveJob *job);
+
+/*
+ * Snapshots `buffer` and saves the snapshot to `filename` on a new thread,
+ * so the buffer can be edited meanwhile. The buffer must outlive the job
+ * and not be freed, reattached or rebased (an incremental save rebases)
+ * before file_save_finish has reported the job.
+ * Returns 0 if the save was started, non-zero otherwise.
+ */
+int file_save_start(FileSaveJob *job, const char *filename, TextBuffer *buffer);
+
+/*
+ * Reports a started save once it has completed, waiting for it if `wait`
+ * is set, and releases its snapshot. Returns 1 if a save was reported
+ * (see `result` and `error`), 0 if none was running or it is still going.
+ */
+int file_save_finish(FileSaveJob *job, TextBuffer *buffer, int wait);
+
+/*
+ * Follow mode for files that keep growing, such as logs. The followed file
+ * stays open and only bytes written after the last update are read and
+ * appended, so the cost follows the new data rather than the file size.
+ * An unterminated last line is extended in place as the rest of it comes
+ * in. If the file shrinks, or another file takes its name (log rotation)
+ * once the old one has been read to its end, the buffer is loaded anew
+ * from the file now at that name. Changes are seen through inotify where
+ * available and by checking every FILE_FOLLOW_POLL_MS otherwise.
+ */
+#define FILE_FOLLOW_POLL_MS 250
+#define FILE_FOLLOW_READ (256 * 1024)   /* new bytes read and appended per step */
+
+typedef enum {
+    FILE_FOLLOW_IDLE,       /* nothing new */
+    FILE_FOLLOW_APPENDED,   /* new lines or line endings were appended */
+    FILE_FOLLOW_TRUNCATED,  /* the file shrank; the buffer was loaded anew */
+    FILE_FOLLOW_REPLACED    /* another file took the name; the buffer was loaded anew */
+} FileFollowEvent;
+
+typedef struct {
+    char *filename;
+    int fd;                 /* the file being followed */
+    int notify_fd;          /* inotify instance, or -1 when polling */
+    int watch;
+    size_t offset;          /* bytes of the file taken in so far */
+    size_t lines;           /* buffer lines after the last update */
+    int open_tail;          /* the buffer's last line still lacks its line end */
+    char *chunk;            /* read buffer of FILE_FOLLOW_READ bytes */
+    int active;
+} FileFollow;
+
+void file_follow_init(FileFollow *follow);
+
+/*
+ * Starts following `filename`, which `buffer` holds as described by
+ * `stamp`. If the file is the one loaded, unchanged or grown, only bytes
+ * past the stamp's size are taken in later. Otherwise the buffer is loaded anew,
+ * `stamp` updated and `event` says why, as for file_follow_update.
+ * Returns 0 on success, -1 on error. A huge file must be fully indexed.
+ */
+int file_follow_start(FileFollow *follow, const char *filename, TextBuffer *buffer, FileStamp *stamp,
+                      FileFollowEvent *event);
+
+/*
+ * Takes in whatever happened to the file since the last update: appends
+ * new bytes, or loads the buffer anew after truncation or rotation.
+ * `stamp` is kept describing the file as far as the buffer holds it.
+ * Returns 0 on success, -1 on error.
+ */
+int file_follow_update(FileFollow *follow, TextBuffer *buffer, FileStamp *stamp, FileFollowEvent *event);
+
+/*
+ * Sleeps until the file may have changed, `timeout_ms` passes, or
+ * `input_fd` (if not -1) has input. Returns 1 if there is input, 0 if not,
+ * -1 on error.
+ */
+int file_follow_wait(FileFollow *follow, int input_fd, int timeout_ms);
+
+void file_follow_stop(FileFollow *follow);
+
 #endif /* FILEIO_H */
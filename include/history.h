@@ -0,0 +1,133 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: history.h
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+
+#include "buffer.h"
+
+/*
+ * Undo/redo as a log of line operations. Each operation keeps only the
+ * line number and the text it removed or added; the text lives in one
+ * append-only payload log, so undoing or redoing an edit costs time
+ * proportional to that edit, never to the buffer.
+ */
+
+/* Memory the log may use before the oldest steps are dropped */
+#define HISTORY_DEFAULT_LIMIT ((size_t)64 * 1024 * 1024)
+
+/*
+ * Block operations keep the block's lines joined by '\n' as their text;
+ * moves and copies keep their line count and destination instead. A
+ * replace-all keeps a table of the lines it changed, then their texts.
+ */
+typedef enum {
+    HISTORY_INSERT,
+    HISTORY_DELETE,
+    HISTORY_REPLACE,
+    HISTORY_INSERT_LINES,
+    HISTORY_DELETE_LINES,
+    HISTORY_MOVE_LINES,
+    HISTORY_COPY_LINES,
+    HISTORY_REPLACE_ALL
+} HistoryKind;
+
+typedef struct {
+    size_t line;
+    size_t payload;         /* log offset of the removed text, then the added text */
+    size_t old_len;         /* bytes removed, without the stored terminator */
+    size_t new_len;         /* bytes added, without the stored terminator */
+    unsigned char kind;     /* HistoryKind */
+    unsigned char starts_group;
+} HistoryOp;
+
+typedef struct {
+    HistoryOp *ops;
+    size_t op_start;        /* oldest operation still held */
+    size_t op_count;
+    size_t op_capacity;
+    size_t cursor;          /* operations before this one are applied */
+    char *payload;
+    size_t payload_base;    /* log offset of payload[0] */
+    size_t payload_len;
+    size_t payload_capacity;
+    size_t limit;
+    size_t group_depth;
+    int group_started;      /* the open explicit group has an operation */
+    int can_merge;          /* the next edit may join the last operation's step */
+    int merge_adjacent;     /* group runs of adjacent edits into one step; off by default */
+} History;
+
+typedef struct {
+    size_t ops;
+    size_t undo_steps;
+    size_t redo_steps;
+    size_t op_bytes;        /* operation records */
+    size_t payload_bytes;   /* text kept for undo and redo */
+    size_t limit;
+} HistoryStats;
+
+void history_init(History *history);
+void history_free(History *history);
+
+/* Drops every step, e.g. after the buffer is replaced by another file */
+void history_clear(History *history);
+
+/* Lowers or raises the memory cap, dropping the oldest steps if needed */
+void history_set_limit(History *history, size_t limit);
+
+/*
+ * Edits between begin and end form one undo step. Groups nest; only the
+ * outermost end closes the step.
+ */
+void history_begin_group(History *history);
+void history_end_group(History *history);
+
+/*
+ * Perform the edit on `buffer` and record it. Each edit is a step of its
+ * own unless a group is open or the caller sets `merge_adjacent`: then
+ * consecutive inserts on following lines, deletes at the same line, and
+ * edits of the same line join one step. Merging suits a typing burst, not
+ * separate commands that happen to touch neighbouring lines.
+ * Return 0 on success, non-zero on error (nothing is recorded).
+ */
+int history_insert_line(History *history, TextBuffer *buffer, size_t index, const char *text);
+int history_delete_line(History *history, TextBuffer *buffer, size_t index);
+int history_replace_line(History *history, TextBuffer *buffer, size_t index, const char *text);
+int history_insert_line_n(History *history, TextBuffer *buffer, size_t index, const char *text, size_t len);
+int history_replace_line_n(History *history, TextBuffer *buffer, size_t index, const char *text, size_t len);
+
+/*
+ * Block edits as in buffer_delete_lines and friends, each one undo step.
+ * Deleting keeps a copy of the deleted text; moves and copies keep none.
+ */
+int history_delete_lines(History *history, TextBuffer *buffer, size_t index, size_t count);
+int history_insert_lines(History *history, TextBuffer *buffer, size_t index, const char *text, size_t len);
+int history_move_lines(History *history, TextBuffer *buffer, size_t index, size_t count, size_t dest);
+int history_copy_lines(History *history, TextBuffer *buffer, size_t index, size_t count, size_t dest);
+
+/*
+ * buffer_replace_all as one undo step, which keeps the old and new text of
+ * every changed line. Nothing is recorded when there is no match.
+ */
+int history_replace_all(History *history, TextBuffer *buffer, BufferSearch *search, const char *replacement,
+                        size_t len, size_t *out_count);
+
+/*
+ * Return 1 if a step was undone or redone, 0 if there was none, -1 on error.
+ * A step that fails partway is rolled back to where it started.
+ */
+int history_undo(History *history, TextBuffer *buffer);
+int history_redo(History *history, TextBuffer *buffer);
+
+void history_stats(const History *history, HistoryStats *stats);
+
+#endif /* HISTORY_H */
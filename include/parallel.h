@@ -0,0 +1,32 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: parallel.h
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+
+#define PARALLEL_MAX_THREADS 64
+
+typedef void (*ParallelTaskFn)(void *context, size_t part);
+
+/* Number of online CPUs, clamped to [1, PARALLEL_MAX_THREADS] */
+size_t parallel_default_threads(void);
+
+/*
+ * Calls `task(context, part)` once for every part in [0, parts) on a pool of
+ * up to `threads` workers (the caller is one of them) and returns when all
+ * parts are done. Workers claim parts in increasing order, so splitting the
+ * work into more parts than threads balances uneven parts. The workers are
+ * started on first use and kept for later runs; while one run has them,
+ * another runs on its calling thread alone.
+ */
+void parallel_run(size_t threads, size_t parts, ParallelTaskFn task, void *context);
+
+#endif /* PARALLEL_H */
@@ -0,0 +1,66 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: pattern.h
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stddef.h>
+
+/*
+ * Regular expressions matched one line at a time. A pattern compiles to a
+ * Thompson NFA that is turned into a DFA lazily, one state per new set of NFA
+ * states, so matching never backtracks and costs one table lookup per byte
+ * once the states it visits exist.
+ *
+ * Syntax: literals, ., [...] and [^...] classes, \d \w \s (and \D \W \S),
+ * ^ $ anchors, ( ) groups, | alternation, and the * + ? {m} {m,} {m,n}
+ * quantifiers. Matches are leftmost-longest.
+ *
+ * A pattern caches DFA states as it runs, so it must only be used by one
+ * thread at a time.
+ */
+typedef struct Pattern Pattern;
+
+/* Returns NULL on error and points `*error` (if non-NULL) at a message */
+Pattern *pattern_compile(const char *source, const char **error);
+void pattern_free(Pattern *pattern);
+
+const char *pattern_source(const Pattern *pattern);
+
+/*
+ * A literal every match must contain (possibly empty), useful to skip
+ * lines with a plain substring search before running the automaton.
+ */
+const char *pattern_literal(const Pattern *pattern, size_t *out_len);
+
+/*
+ * Finds the leftmost-longest match in `text` that starts at or after
+ * `from`. `^` only matches at offset 0 and `$` only at `len`.
+ * Returns 1 and the match's offset and length, or 0 if there is none.
+ */
+int pattern_find(Pattern *pattern, const char *text, size_t len, size_t from,
+                 size_t *out_start, size_t *out_len);
+
+/*
+ * Returns the compiled form of `source`, compiling it on first use, and
+ * holds it until the matching pattern_cache_release: a held pattern is
+ * never evicted, and clearing the cache frees it only once released. When
+ * every entry is held, the pattern is compiled outside the cache and freed
+ * by its release. Repeated lookups of a source reuse its compiled program
+ * and the automaton states built while searching.
+ */
+#define PATTERN_CACHE_SIZE 8
+
+Pattern *pattern_cache_get(const char *source, const char **error);
+void pattern_cache_release(Pattern *pattern);
+/* Patterns the cache has compiled so far */
+size_t pattern_cache_compiles(void);
+void pattern_cache_clear(void);
+
+#endif /* PATTERN_H */
@@ -0,0 +1,47 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: search.h
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stddef.h>
+
+/*
+ * Substring search kernels. The vector kernels compare the first and last
+ * needle bytes against a whole register of candidate positions at once and
+ * only run a full comparison where both match. The widest kernel the CPU
+ * supports is picked at run time.
+ */
+typedef enum {
+    SEARCH_KERNEL_AUTO = 0,
+    SEARCH_KERNEL_SCALAR,
+    SEARCH_KERNEL_SSE2,
+    SEARCH_KERNEL_AVX2
+} SearchKernel;
+
+/* Forces a kernel (for tests and benchmarks); unsupported ones fall back */
+void search_set_kernel(SearchKernel kernel);
+SearchKernel search_active_kernel(void);
+const char *search_kernel_name(SearchKernel kernel);
+
+/*
+ * Returns the first occurrence of `needle` in `hay`, or NULL.
+ * Neither buffer needs to be NUL-terminated.
+ */
+const char *search_find(const char *hay, size_t hay_len, const char *needle, size_t needle_len);
+
+/*
+ * Byte scans with the same kernels, for finding line ends: the number of
+ * `byte`s in `data`, and `base` plus the offset of each one stored in
+ * order into `out`, which must have room for all of them.
+ */
+size_t search_count_byte(const char *data, size_t len, char byte);
+size_t search_byte_positions(const char *data, size_t len, char byte, size_t base, size_t *out);
+
+#endif /* SEARCH_H */
@@ -0,0 +1,66 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: stats.h
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Process-wide counters for the slow paths: how often loads, saves and
+ * searches ran, how many bytes they moved and how long they took, and how
+ * often the buffer allocated. Collection is off until enabled; while off,
+ * each hook costs one relaxed load and a branch, and no clock is read.
+ */
+
+typedef enum {
+    STATS_LOAD,
+    STATS_SAVE,
+    STATS_SEARCH,
+    STATS_OP_COUNT
+} StatsOp;
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long bytes;           /* loaded, written, or searched */
+    unsigned long long nanoseconds;
+    unsigned long long max_nanoseconds;
+} StatsOpTotals;
+
+typedef struct {
+    StatsOpTotals ops[STATS_OP_COUNT];
+    unsigned long long allocations;     /* buffer allocations and reallocations */
+    unsigned long long allocated_bytes; /* bytes requested by them */
+} StatsSnapshot;
+
+void stats_set_enabled(int enabled);
+int stats_enabled(void);
+
+/* Zeroes every counter */
+void stats_reset(void);
+
+/*
+ * Start of a timed operation for stats_record; 0 while collection is off,
+ * in which case stats_record does nothing.
+ */
+unsigned long long stats_start(void);
+void stats_record(StatsOp op, size_t bytes, unsigned long long start);
+
+void stats_count_allocation(size_t bytes);
+
+const char *stats_op_name(StatsOp op);
+
+/* Consistent per counter; other threads may be adding meanwhile */
+void stats_read(StatsSnapshot *snapshot);
+
+/* Writes one line per operation kind, then the allocation counts */
+void stats_dump(FILE *out);
+
+#endif /* STATS_H */
@@ -3,7 +3,7 @@
  * File: util.h
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
@@ -11,8 +11,36 @@
 #define UTIL_H
 
 #include <stddef.h>
+#include <stdio.h>
+
+#define LINE_READER_CHUNK_SIZE (64 * 1024)
+
+/*
+ * Streams lines of any length from a FILE. Input is read in large chunks;
+ * a line that fits in a chunk is handed out in place, and only lines that
+ * straddle chunks are assembled in a scratch buffer reused across calls.
+ */
+typedef struct {
+    FILE *fp;
+    char *chunk;
+    size_t chunk_pos;
+    size_t chunk_len;
+    char *scratch;
+    size_t scratch_len;
+    size_t scratch_capacity;
+} LineReader;
 
 void trim_newline(char *s);
 int read_line(char *buffer, size_t size);
 
+int line_reader_init(LineReader *reader, FILE *fp);
+void line_reader_free(LineReader *reader);
+
+/*
+ * Reads the next line, without its line ending, into `*out_line` (which is
+ * NUL-terminated and valid until the next call) and its length into `*out_len`.
+ * Returns 0 on success, 1 at end of input, -1 on error.
+ */
+int line_reader_next(LineReader *reader, char **out_line, size_t *out_len);
+
 #endif /* UTIL_H */
@@ -3,26 +3,44 @@
 # License: MIT License (see LICENSE file for details)
 
 CC      := gcc
-CFLAGS  := -std=c11 -Wall -Wextra -pedantic -Iinclude
-LDFLAGS :=
+CFLAGS  := -std=c11 -Wall -Wextra -pedantic -pthread -Iinclude
+LDFLAGS := -pthread
 
 SRC_DIR := src
 OBJ_DIR := obj
 BIN_DIR := bin
 TEST_DIR := tests
+BENCH_DIR := bench
 
 SOURCES := $(SRC_DIR)/main.c \
            $(SRC_DIR)/editor.c \
            $(SRC_DIR)/buffer.c \
            $(SRC_DIR)/fileio.c \
+           $(SRC_DIR)/history.c \
+           $(SRC_DIR)/parallel.c \
+           $(SRC_DIR)/pattern.c \
+           $(SRC_DIR)/search.c \
+           $(SRC_DIR)/stats.c \
            $(SRC_DIR)/util.c
 
 OBJECTS := $(patsubst $(SRC_DIR)/%.c,$(OBJ_DIR)/%.o,$(SOURCES))
 
 TARGET  := $(BIN_DIR)/text_editor
-TEST_BIN := $(BIN_DIR)/test_buffer
+TEST_BINS := $(BIN_DIR)/test_buffer \
+             $(BIN_DIR)/test_fileio \
+             $(BIN_DIR)/test_search \
+             $(BIN_DIR)/test_pattern \
+             $(BIN_DIR)/test_history \
+             $(BIN_DIR)/test_editor
 
-.PHONY: all clean test dirs
+BENCH_CFLAGS := $(CFLAGS) -O2
+BENCH_BINS := $(BIN_DIR)/bench_search \
+              $(BIN_DIR)/bench_save \
+              $(BIN_DIR)/bench_edit \
+              $(BIN_DIR)/bench_load \
+              $(BIN_DIR)/bench_suite
+
+.PHONY: all clean test bench dirs
 
 all: dirs $(TARGET)
 
@@ -33,11 +51,58 @@ $(OBJ_DIR)/%.o: $(SRC_DIR)/%.c
 	@mkdir -p $(OBJ_DIR)
 	$(CC) $(CFLAGS) -c $< -o $@
 
-$(TEST_BIN): dirs $(TEST_DIR)/test_buffer.c $(SRC_DIR)/buffer.c
-	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_buffer.c $(SRC_DIR)/buffer.c
+BUFFER_SOURCES := $(SRC_DIR)/buffer.c $(SRC_DIR)/parallel.c $(SRC_DIR)/pattern.c $(SRC_DIR)/search.c \
+                  $(SRC_DIR)/stats.c
+
+$(BIN_DIR)/test_buffer: dirs $(TEST_DIR)/test_buffer.c $(BUFFER_SOURCES)
+	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_buffer.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/test_fileio: dirs $(TEST_DIR)/test_fileio.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES)
+	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_fileio.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/test_search: dirs $(TEST_DIR)/test_search.c $(SRC_DIR)/search.c
+	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_search.c $(SRC_DIR)/search.c
+
+$(BIN_DIR)/test_pattern: dirs $(TEST_DIR)/test_pattern.c $(SRC_DIR)/pattern.c
+	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_pattern.c $(SRC_DIR)/pattern.c
+
+$(BIN_DIR)/test_history: dirs $(TEST_DIR)/test_history.c $(SRC_DIR)/history.c $(BUFFER_SOURCES)
+	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_history.c $(SRC_DIR)/history.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+EDITOR_SOURCES := $(SRC_DIR)/editor.c $(SRC_DIR)/fileio.c $(SRC_DIR)/history.c $(SRC_DIR)/util.c $(BUFFER_SOURCES)
+
+$(BIN_DIR)/test_editor: dirs $(TEST_DIR)/test_editor.c $(EDITOR_SOURCES)
+	$(CC) $(CFLAGS) -o $@ $(TEST_DIR)/test_editor.c $(EDITOR_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/bench_search: dirs $(BENCH_DIR)/bench_search.c $(BUFFER_SOURCES)
+	$(CC) $(BENCH_CFLAGS) -o $@ $(BENCH_DIR)/bench_search.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/bench_save: dirs $(BENCH_DIR)/bench_save.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES)
+	$(CC) $(BENCH_CFLAGS) -o $@ $(BENCH_DIR)/bench_save.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/bench_edit: dirs $(BENCH_DIR)/bench_edit.c $(BUFFER_SOURCES)
+	$(CC) $(BENCH_CFLAGS) -o $@ $(BENCH_DIR)/bench_edit.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/bench_suite: dirs $(BENCH_DIR)/bench_suite.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES)
+	$(CC) $(BENCH_CFLAGS) -o $@ $(BENCH_DIR)/bench_suite.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+$(BIN_DIR)/bench_load: dirs $(BENCH_DIR)/bench_load.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES)
+	$(CC) $(BENCH_CFLAGS) -o $@ $(BENCH_DIR)/bench_load.c $(SRC_DIR)/fileio.c $(SRC_DIR)/util.c $(BUFFER_SOURCES) $(LDFLAGS)
+
+test: $(TEST_BINS)
+	./$(BIN_DIR)/test_buffer
+	./$(BIN_DIR)/test_fileio
+	./$(BIN_DIR)/test_search
+	./$(BIN_DIR)/test_pattern
+	./$(BIN_DIR)/test_history
+	./$(BIN_DIR)/test_editor
 
- test: $(TEST_BIN)
-	./$(TEST_BIN)
+bench: $(BENCH_BINS)
+	./$(BIN_DIR)/bench_search
+	./$(BIN_DIR)/bench_save
+	./$(BIN_DIR)/bench_edit
+	./$(BIN_DIR)/bench_load
+	./$(BIN_DIR)/bench_suite
 
 clean:
 	rm -rf $(OBJ_DIR) $(BIN_DIR)
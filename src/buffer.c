@@ -3,170 +3,2502 @@
  * File: buffer.c
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
 #include "buffer.h"
 
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "parallel.h"
+#include "search.h"
+#include "stats.h"
+
 #define INITIAL_CAPACITY 16
+#define SEARCH_BATCH_SIZE 256
+#define SEARCH_PARTS_PER_THREAD 4
+#define SEARCH_MIN_PART_LINES 4096
+#define INDEX_MIN_CHUNK (1024 * 1024)
+#define INDEX_MAX_CHUNKS (PARALLEL_MAX_THREADS * SEARCH_PARTS_PER_THREAD)
+#define INDEX_BLOCK (64 * 1024)
+#define COPY_CHUNK_LINES 1024
+#define COPY_BLOCK_SIZE (64 * 1024)
+
+static void release_heap(void *data, size_t size)
+{
+    (void)size;
+    free(data);
+}
+
+static void source_init(TextSource *src)
+{
+    src->data = NULL;
+    src->size = 0;
+    src->capacity = 0;
+    src->starts = NULL;
+    src->line_count = 0;
+    src->line_capacity = 0;
+    src->release = NULL;
+}
+
+static void source_free(TextSource *src)
+{
+    if (src->release && src->data) {
+        src->release(src->data, src->capacity);
+    }
+    free(src->starts);
+    source_init(src);
+}
+
+static int grow_array(void **items, size_t *capacity, size_t min_capacity, size_t item_size)
+{
+    if (*capacity >= min_capacity) {
+        return 0;
+    }
+
+    size_t new_capacity = *capacity ? *capacity : INITIAL_CAPACITY;
+    while (new_capacity < min_capacity) {
+        new_capacity *= 2;
+    }
+
+    void *new_items = realloc(*items, new_capacity * item_size);
+    if (!new_items) {
+        return -1;
+    }
+    stats_count_allocation(new_capacity * item_size);
+
+    *items = new_items;
+    *capacity = new_capacity;
+    return 0;
+}
+
+static int reserve_lines(TextSource *src, size_t min_capacity)
+{
+    void *starts = src->starts;
+    int rc = grow_array(&starts, &src->line_capacity, min_capacity, sizeof(size_t));
+    src->starts = (size_t *)starts;
+    return rc;
+}
+
+static int reserve_pieces(TextBuffer *buffer, size_t min_capacity)
+{
+    void *pieces = buffer->pieces;
+    int rc = grow_array(&pieces, &buffer->piece_capacity, min_capacity, sizeof(Piece));
+    buffer->pieces = (Piece *)pieces;
+    return rc;
+}
+
+static int reserve_blocks(LineArena *arena, size_t min_capacity)
+{
+    void *blocks = arena->blocks;
+    int rc = grow_array(&blocks, &arena->block_capacity, min_capacity, sizeof(TextSource));
+    arena->blocks = (TextSource *)blocks;
+    return rc;
+}
+
+static void arena_init(LineArena *arena)
+{
+    arena->blocks = NULL;
+    arena->block_count = 0;
+    arena->block_capacity = 0;
+    arena->open = 0;
+    arena->pinned = 0;
+    arena->tail_shared = 0;
+}
+
+static void arena_free(LineArena *arena)
+{
+    for (size_t i = 0; i < arena->block_count; ++i) {
+        source_free(&arena->blocks[i]);
+    }
+    free(arena->blocks);
+    arena_init(arena);
+}
+
+/* Adds an empty block of `capacity` bytes and returns its piece source */
+static size_t arena_add_block(LineArena *arena, size_t capacity)
+{
+    if (reserve_blocks(arena, arena->block_count + 1) != 0) {
+        return PIECE_ORIGINAL;
+    }
+
+    TextSource *block = &arena->blocks[arena->block_count];
+    source_init(block);
+    block->data = (char *)malloc(capacity);
+    if (!block->data) {
+        return PIECE_ORIGINAL;
+    }
+    stats_count_allocation(capacity);
+    block->capacity = capacity;
+    block->release = release_heap;
+    return ++arena->block_count;
+}
+
+/*
+ * Copies `text` into the arena and returns the piece source and line now
+ * holding it. Short lines are packed into the open block; a line too long
+ * to pack sensibly gets a block sized to fit.
+ */
+static int arena_append(TextBuffer *buffer, const char *text, size_t len, size_t *out_source, size_t *out_line)
+{
+    LineArena *arena = &buffer->arena;
+    size_t source = arena->open;
+
+    if (len + 1 > ARENA_BLOCK_SIZE / 4) {
+        source = arena_add_block(arena, len + 1);
+    } else if (source == PIECE_ORIGINAL ||
+               arena->blocks[source - 1].capacity - arena->blocks[source - 1].size < len + 1) {
+        source = arena_add_block(arena, ARENA_BLOCK_SIZE);
+        if (source != PIECE_ORIGINAL) {
+            arena->open = source;
+        }
+    }
+    if (source == PIECE_ORIGINAL) {
+        return -1;
+    }
+
+    TextSource *block = &arena->blocks[source - 1];
+    if (reserve_lines(block, block->line_count + 2) != 0) {
+        return -1;
+    }
+
+    if (len > 0) {
+        memcpy(block->data + block->size, text, len);
+    }
+    block->data[block->size + len] = '\0';
+    block->starts[block->line_count] = block->size;
+    block->size += len + 1;
+    block->starts[block->line_count + 1] = block->size;
+    *out_source = source;
+    *out_line = block->line_count++;
+    if (source == arena->open) {
+        arena->tail_shared = 0; /* a fresh tail, referenced once */
+    }
+    return 0;
+}
+
+/*
+ * If `line` is the most recent line packed into the open block, gives its
+ * bytes back so the next append lands in the same place. Unless a block
+ * copy shared it, an added line is referenced by exactly one piece, so
+ * only the caller can still see it. Any other replaced line stays where it
+ * is: lines in a block sit back to back, so there is no hole to reuse.
+ */
+static int arena_reuse_tail(LineArena *arena, size_t source, size_t line)
+{
+    /* A snapshot may still point at the tail line */
+    if (source == PIECE_ORIGINAL || source != arena->open || arena->pinned > 0 || arena->tail_shared) {
+        return 0;
+    }
+
+    TextSource *block = &arena->blocks[source - 1];
+    if (line + 1 != block->line_count) {
+        return 0;
+    }
+
+    block->size = block->starts[line];
+    block->line_count--;
+    return 1;
+}
+
+static void arena_restore_tail(LineArena *arena)
+{
+    TextSource *block = &arena->blocks[arena->open - 1];
+    block->line_count++;
+    block->size = block->starts[block->line_count];
+}
+
+static const TextSource *piece_source(const TextBuffer *buffer, const Piece *piece)
+{
+    if (piece->source == PIECE_ORIGINAL) {
+        return &buffer->original;
+    }
+    return &buffer->arena.blocks[piece->source - 1];
+}
+
+/* Returns the bytes of one line of `piece`; they are not NUL-terminated */
+static const char *line_span(const TextBuffer *buffer, const Piece *piece, size_t offset, size_t *out_len)
+{
+    const TextSource *src = piece_source(buffer, piece);
+    size_t line = piece->first + offset;
+    size_t start = src->starts[line];
+    size_t end = src->starts[line + 1] - 1; /* drop the terminator */
+
+    if (piece->source == PIECE_ORIGINAL) {
+        while (end > start && src->data[end - 1] == '\r') {
+            end--;
+        }
+    }
+
+    *out_len = end - start;
+    return src->data + start;
+}
+
+/* Last line in [lo, hi) of `src` starting at or before byte `offset` */
+static size_t source_line_at(const TextSource *src, size_t lo, size_t hi, size_t offset)
+{
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (src->starts[mid] <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Scans the first `limit` lines of a piece from source offset `pos` in one
+ * pass, since its lines sit back to back in the source, and maps the first
+ * hit back to a line. Returns 0 and the hit's piece line and column if found.
+ */
+static int find_in_piece(const TextBuffer *buffer, const Piece *piece, size_t pos, size_t limit,
+                         const char *needle, size_t needle_len,
+                         size_t *out_offset, size_t *out_column)
+{
+    const TextSource *src = piece_source(buffer, piece);
+    size_t last = piece->first + limit;
+    size_t end = src->starts[last];
+
+    if (end > src->size) {
+        end = src->size; /* virtual terminator of an unterminated last line */
+    }
+
+    while (pos < end) {
+        const char *hit = search_find(src->data + pos, end - pos, needle, needle_len);
+        if (!hit) {
+            break;
+        }
+
+        size_t at = (size_t)(hit - src->data);
+        size_t line = source_line_at(src, piece->first, last, at);
+        size_t len = 0;
+        line_span(buffer, piece, line - piece->first, &len);
+
+        /* Reject hits that run into a stripped CR or the next line */
+        if (at + needle_len <= src->starts[line] + len) {
+            *out_offset = line - piece->first;
+            *out_column = at - src->starts[line];
+            return 0;
+        }
+        pos = at + 1;
+    }
+
+    return -1;
+}
+
+/* Index of the piece holding buffer line `index` (index < count) */
+static size_t find_piece(const TextBuffer *buffer, size_t index)
+{
+    size_t lo = 0;
+    size_t hi = buffer->piece_count;
+
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (buffer->pieces[mid].line <= index) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Document bytes of `count` lines of `piece` from its line `first`, newlines included */
+static size_t run_bytes(const TextBuffer *buffer, const Piece *piece, size_t first, size_t count)
+{
+    const TextSource *src = piece_source(buffer, piece);
+    size_t from = piece->first + first;
+    size_t bytes = src->starts[from + count] - src->starts[from];
+
+    if (piece->source == PIECE_ORIGINAL && buffer->original_cr) {
+        bytes -= buffer->original_cr[from + count] - buffer->original_cr[from];
+    }
+    return bytes;
+}
+
+/* Renumbers the pieces from `from` on; this is the O(pieces) part of an edit */
+static void refresh_lines(TextBuffer *buffer, size_t from)
+{
+    size_t line = 0;
+    size_t offset = 0;
+    if (from > 0) {
+        const Piece *prev = &buffer->pieces[from - 1];
+        line = prev->line + prev->count;
+        offset = prev->offset + run_bytes(buffer, prev, 0, prev->count);
+    }
+
+    for (size_t p = from; p < buffer->piece_count; ++p) {
+        Piece *piece = &buffer->pieces[p];
+        piece->line = line;
+        piece->offset = offset;
+        line += piece->count;
+        offset += run_bytes(buffer, piece, 0, piece->count);
+    }
+}
+
+static void open_piece_slot(TextBuffer *buffer, size_t at)
+{
+    memmove(&buffer->pieces[at + 1], &buffer->pieces[at],
+            (buffer->piece_count - at) * sizeof(Piece));
+    buffer->piece_count++;
+}
+
+static void remove_piece(TextBuffer *buffer, size_t at)
+{
+    memmove(&buffer->pieces[at], &buffer->pieces[at + 1],
+            (buffer->piece_count - at - 1) * sizeof(Piece));
+    buffer->piece_count--;
+}
+
+static int pieces_adjacent(const Piece *a, const Piece *b)
+{
+    return a->source == b->source && a->first + a->count == b->first;
+}
+
+/*
+ * Ensures a piece starts at buffer line `index` and returns its position.
+ * Needs room for one extra piece.
+ */
+static size_t split_at(TextBuffer *buffer, size_t index)
+{
+    if (index >= buffer->count) {
+        return buffer->piece_count;
+    }
+
+    size_t p = find_piece(buffer, index);
+    size_t offset = index - buffer->pieces[p].line;
+    if (offset == 0) {
+        return p;
+    }
+
+    open_piece_slot(buffer, p + 1);
+    buffer->pieces[p + 1].source = buffer->pieces[p].source;
+    buffer->pieces[p + 1].first = buffer->pieces[p].first + offset;
+    buffer->pieces[p + 1].count = buffer->pieces[p].count - offset;
+    buffer->pieces[p + 1].line = index;
+    buffer->pieces[p].count = offset;
+    return p + 1;
+}
+
+/* Folds piece `p` into its neighbours where they continue the same run */
+static size_t merge_neighbours(TextBuffer *buffer, size_t p)
+{
+    if (p + 1 < buffer->piece_count && pieces_adjacent(&buffer->pieces[p], &buffer->pieces[p + 1])) {
+        buffer->pieces[p].count += buffer->pieces[p + 1].count;
+        remove_piece(buffer, p + 1);
+    }
+    if (p > 0 && p < buffer->piece_count && pieces_adjacent(&buffer->pieces[p - 1], &buffer->pieces[p])) {
+        buffer->pieces[p - 1].count += buffer->pieces[p].count;
+        remove_piece(buffer, p);
+        p--;
+    }
+    return p;
+}
+
+/* ---- Line copies for buffer_get_line ---- */
+
+typedef struct CopyBlock {
+    struct CopyBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} CopyBlock;
+
+struct LineCopies {
+    char ***chunks;         /* COPY_CHUNK_LINES copies each, by original line */
+    size_t chunk_count;
+    CopyBlock *blocks;      /* the open block first; copies never move */
+    char *edit;             /* the line with pending character edits */
+    size_t edit_capacity;
+    size_t bytes;           /* allocated, for buffer_memory_stats */
+};
+
+/* Gives the buffer its copy table, which the const reader cannot create */
+static int copies_reserve(TextBuffer *buffer)
+{
+    if (!buffer->copies) {
+        buffer->copies = (LineCopies *)calloc(1, sizeof(LineCopies));
+        if (!buffer->copies) {
+            return -1;
+        }
+        buffer->copies->bytes = sizeof(LineCopies);
+    }
+    return 0;
+}
+
+/* Forgets the copies of original lines from `first` on; their bytes stay until the buffer is freed */
+static void copies_forget(LineCopies *copies, size_t first)
+{
+    if (!copies) {
+        return;
+    }
+    for (size_t c = first / COPY_CHUNK_LINES; c < copies->chunk_count; ++c) {
+        size_t from = c == first / COPY_CHUNK_LINES ? first % COPY_CHUNK_LINES : 0;
+        if (copies->chunks[c]) {
+            memset(copies->chunks[c] + from, 0, (COPY_CHUNK_LINES - from) * sizeof(char *));
+        }
+    }
+}
+
+static void copies_free(LineCopies *copies)
+{
+    if (!copies) {
+        return;
+    }
+    for (size_t c = 0; c < copies->chunk_count; ++c) {
+        free(copies->chunks[c]);
+    }
+    free(copies->chunks);
+    while (copies->blocks) {
+        CopyBlock *next = copies->blocks->next;
+        free(copies->blocks);
+        copies->blocks = next;
+    }
+    free(copies->edit);
+    free(copies);
+}
+
+/* Stores `len` bytes and a terminator where they never move; NULL when out of memory */
+static char *copies_store(LineCopies *copies, const char *text, size_t len)
+{
+    CopyBlock *block = copies->blocks;
+    if (!block || block->capacity - block->used < len + 1) {
+        size_t capacity = len + 1 > COPY_BLOCK_SIZE / 4 ? len + 1 : COPY_BLOCK_SIZE;
+        CopyBlock *fresh = (CopyBlock *)malloc(sizeof(CopyBlock) + capacity);
+        if (!fresh) {
+            return NULL;
+        }
+        stats_count_allocation(sizeof(CopyBlock) + capacity);
+        copies->bytes += sizeof(CopyBlock) + capacity;
+        fresh->used = 0;
+        fresh->capacity = capacity;
+
+        /* A long line's own block goes behind the open one, which stays open */
+        if (block && capacity != COPY_BLOCK_SIZE) {
+            fresh->next = block->next;
+            block->next = fresh;
+        } else {
+            fresh->next = block;
+            copies->blocks = fresh;
+        }
+        block = fresh;
+    }
+
+    char *copy = block->data + block->used;
+    if (len > 0) {
+        memcpy(copy, text, len);
+    }
+    copy[len] = '\0';
+    block->used += len + 1;
+    return copy;
+}
+
+/* The slot for original line `line`, or NULL when out of memory */
+static char **copies_slot(LineCopies *copies, size_t line)
+{
+    size_t c = line / COPY_CHUNK_LINES;
+    if (c >= copies->chunk_count) {
+        size_t count = copies->chunk_count ? copies->chunk_count : 1;
+        while (count <= c) {
+            count *= 2;
+        }
+        char ***chunks = (char ***)realloc(copies->chunks, count * sizeof(char **));
+        if (!chunks) {
+            return NULL;
+        }
+        memset(chunks + copies->chunk_count, 0, (count - copies->chunk_count) * sizeof(char **));
+        copies->bytes += (count - copies->chunk_count) * sizeof(char **);
+        copies->chunks = chunks;
+        copies->chunk_count = count;
+    }
+    if (!copies->chunks[c]) {
+        copies->chunks[c] = (char **)calloc(COPY_CHUNK_LINES, sizeof(char *));
+        if (!copies->chunks[c]) {
+            return NULL;
+        }
+        copies->bytes += COPY_CHUNK_LINES * sizeof(char *);
+    }
+    return &copies->chunks[c][line % COPY_CHUNK_LINES];
+}
+
+void buffer_init(TextBuffer *buffer)
+{
+    if (!buffer) {
+        return;
+    }
+    source_init(&buffer->original);
+    arena_init(&buffer->arena);
+    buffer->pieces = NULL;
+    buffer->piece_count = 0;
+    buffer->piece_capacity = 0;
+    buffer->count = 0;
+    buffer->copies = NULL;
+    buffer->original_crlf = 0;
+    buffer->original_cr = NULL;
+    memset(&buffer->edit, 0, sizeof(buffer->edit));
+    buffer->edit.line = INVALID_INDEX;
+}
+
+void buffer_free(TextBuffer *buffer)
+{
+    if (!buffer) {
+        return;
+    }
+
+    source_free(&buffer->original);
+    arena_free(&buffer->arena);
+    free(buffer->pieces);
+    copies_free(buffer->copies);
+    free(buffer->original_cr);
+    free(buffer->edit.data);
+    buffer->pieces = NULL;
+    buffer->piece_count = 0;
+    buffer->piece_capacity = 0;
+    buffer->count = 0;
+    buffer->copies = NULL;
+    buffer->original_crlf = 0;
+    buffer->original_cr = NULL;
+    memset(&buffer->edit, 0, sizeof(buffer->edit));
+    buffer->edit.line = INVALID_INDEX;
+}
+
+/* Newline scan of one stretch of the original, split into chunks */
+typedef struct {
+    const char *data;
+    size_t from;
+    size_t size;
+    size_t chunk_size;
+    size_t *starts;                     /* where the first chunk's line starts go */
+    size_t counts[INDEX_MAX_CHUNKS + 1];    /* newlines per chunk, then its first slot */
+    const size_t *bounds;               /* chunk starts, if not every chunk_size bytes */
+    unsigned char crlf[INDEX_MAX_CHUNKS];
+    unsigned char mismatch[INDEX_MAX_CHUNKS];
+} LineIndexJob;
+
+static size_t chunk_begin(const LineIndexJob *job, size_t part, size_t *len)
+{
+    if (job->bounds) {
+        *len = job->bounds[part + 1] - job->bounds[part];
+        return job->bounds[part];
+    }
+    size_t begin = job->from + part * job->chunk_size;
+    if (begin > job->size) {
+        begin = job->size;
+    }
+    *len = job->size - begin < job->chunk_size ? job->size - begin : job->chunk_size;
+    return begin;
+}
+
+static void count_chunk(void *context, size_t part)
+{
+    LineIndexJob *job = (LineIndexJob *)context;
+    size_t len = 0;
+    size_t begin = chunk_begin(job, part, &len);
+    job->counts[part] = search_count_byte(job->data + begin, len, '\n');
+}
+
+static void note_crlf(LineIndexJob *job, size_t part, const size_t *out, size_t count)
+{
+    job->crlf[part] = 0;
+    for (size_t i = 0; i < count; ++i) {
+        size_t newline = out[i] - 1;
+        if (newline > job->from && job->data[newline - 1] == '\r') {
+            job->crlf[part] = 1;
+            break;
+        }
+    }
+}
+
+/* Each newline starts the next line, so its offset plus one is stored */
+static void index_chunk(void *context, size_t part)
+{
+    LineIndexJob *job = (LineIndexJob *)context;
+    size_t len = 0;
+    size_t begin = chunk_begin(job, part, &len);
+    size_t *out = job->starts + job->counts[part];
+    size_t count = search_byte_positions(job->data + begin, len, '\n', begin + 1, out);
+    note_crlf(job, part, out, count);
+}
+
+/*
+ * Like index_chunk for a chunk whose newline count is already known. The
+ * chunk goes block by block, each counted while it is in cache and then
+ * stored, so a chunk holding more newlines than expected stops before it
+ * overruns the slots of the next.
+ */
+static void index_known_chunk(void *context, size_t part)
+{
+    LineIndexJob *job = (LineIndexJob *)context;
+    size_t len = 0;
+    size_t begin = chunk_begin(job, part, &len);
+    size_t *out = job->starts + job->counts[part];
+    size_t room = job->counts[part + 1] - job->counts[part];
+    size_t count = 0;
+
+    job->mismatch[part] = 0;
+    for (size_t at = begin; at < begin + len; at += INDEX_BLOCK) {
+        size_t block = begin + len - at < INDEX_BLOCK ? begin + len - at : INDEX_BLOCK;
+        size_t newlines = search_count_byte(job->data + at, block, '\n');
+        if (newlines > room - count) {
+            job->mismatch[part] = 1;
+            return;
+        }
+        count += search_byte_positions(job->data + at, block, '\n', at + 1, out + count);
+    }
+    job->mismatch[part] = count != room;
+    note_crlf(job, part, out, count);
+}
+
+/* Counts the CRs dropped before each original line, from line `from` on */
+static int count_original_cr(TextBuffer *buffer, size_t from)
+{
+    TextSource *src = &buffer->original;
+    size_t *cr = (size_t *)realloc(buffer->original_cr, (src->line_count + 1) * sizeof(size_t));
+    if (!cr) {
+        return -1;
+    }
+    stats_count_allocation((src->line_count + 1) * sizeof(size_t));
+    buffer->original_cr = cr;
+
+    if (from == 0) {
+        cr[0] = 0;
+    }
+    for (size_t i = from; i < src->line_count; ++i) {
+        size_t end = src->starts[i + 1] - 1;
+        size_t dropped = 0;
+        while (end - dropped > src->starts[i] && src->data[end - dropped - 1] == '\r') {
+            dropped++;
+        }
+        cr[i + 1] = cr[i] + dropped;
+    }
+    return 0;
+}
+
+/* Completes the original's line table once `job` has stored its line starts */
+static int finish_original(TextBuffer *buffer, const LineIndexJob *job, size_t parts, size_t lines, int unterminated)
+{
+    TextSource *src = &buffer->original;
+    const char *data = src->data;
+    size_t size = src->size;
+
+    for (size_t part = 0; part < parts; ++part) {
+        buffer->original_crlf |= job->crlf[part];
+    }
+
+    src->line_count = lines;
+    if (unterminated) {
+        if (data[size - 1] == '\r') {
+            buffer->original_crlf = 1;
+        }
+        /* An unterminated last line gets a virtual terminator past the end */
+        src->starts[lines] = size + 1;
+    }
+
+    /* Byte offsets count lines as saved, so they need the dropped CRs */
+    if (buffer->original_crlf && count_original_cr(buffer, 0) != 0) {
+        return -1;
+    }
+
+    buffer->piece_count = 0;
+    if (lines > 0) {
+        buffer->pieces[0].source = PIECE_ORIGINAL;
+        buffer->pieces[0].first = 0;
+        buffer->pieces[0].count = lines;
+        buffer->pieces[0].line = 0;
+        buffer->pieces[0].offset = 0;
+        buffer->piece_count = 1;
+    }
+    buffer->count = lines;
+    return 0;
+}
+
+/*
+ * Indexes the original source's lines from line `keep` onwards, keeping
+ * the offsets of the lines before it, and makes the whole original the
+ * document again. Large originals are scanned in chunks on up to
+ * `threads` workers: one pass counts each chunk's newlines, which tells
+ * every chunk where its lines go, and a second pass stores them there.
+ */
+static int index_original(TextBuffer *buffer, size_t keep, size_t threads)
+{
+    TextSource *src = &buffer->original;
+    const char *data = src->data;
+    size_t size = src->size;
+    size_t from = keep > 0 ? src->starts[keep] : 0;
+
+    free(buffer->original_cr);
+    buffer->original_cr = NULL;
+    if (keep == 0) {
+        buffer->original_crlf = 0;
+    }
+
+    size_t bytes = size > from ? size - from : 0;
+    size_t parts = threads * SEARCH_PARTS_PER_THREAD;
+    if (parts > bytes / INDEX_MIN_CHUNK) {
+        parts = bytes / INDEX_MIN_CHUNK;
+    }
+    if (threads <= 1 || parts < 1) {
+        parts = bytes > 0 ? 1 : 0;
+    }
+    if (parts > INDEX_MAX_CHUNKS) {
+        parts = INDEX_MAX_CHUNKS;
+    }
+
+    LineIndexJob job;
+    job.data = data;
+    job.from = from;
+    job.size = size;
+    job.chunk_size = parts > 0 ? (bytes + parts - 1) / parts : 0;
+    job.bounds = NULL;
+    parallel_run(threads, parts, count_chunk, &job);
+
+    size_t newlines = 0;
+    for (size_t part = 0; part < parts; ++part) {
+        size_t count = job.counts[part];
+        job.counts[part] = newlines;
+        newlines += count;
+    }
+    int unterminated = size > from && data[size - 1] != '\n';
+    size_t lines = keep + newlines + (unterminated ? 1 : 0);
+
+    if (reserve_lines(src, lines + 1) != 0 || reserve_pieces(buffer, 1) != 0) {
+        return -1;
+    }
+
+    src->starts[keep] = from;
+    job.starts = src->starts + keep + 1;
+    parallel_run(threads, parts, index_chunk, &job);
+    return finish_original(buffer, &job, parts, lines, unterminated);
+}
+
+/*
+ * Like index_original(buffer, 0, threads) when the start of every
+ * `stride`-th line and the number of lines are known: the chunks are
+ * split at known line starts, so each knows where its lines go and the
+ * separate counting pass is skipped. Returns 1, with the line table
+ * unfinished, if the samples do not match the text.
+ */
+static int index_original_sampled(TextBuffer *buffer, size_t threads, const size_t *samples, size_t sample_count,
+                                  size_t stride, size_t lines)
+{
+    TextSource *src = &buffer->original;
+    const char *data = src->data;
+    size_t size = src->size;
+
+    if (size == 0 || stride == 0 || lines == 0 || sample_count != (lines - 1) / stride + 1 || samples[0] != 0 ||
+        samples[sample_count - 1] >= size) {
+        return 1;
+    }
+    for (size_t k = 1; k < sample_count; ++k) {
+        if (samples[k] <= samples[k - 1]) {
+            return 1;
+        }
+    }
+
+    free(buffer->original_cr);
+    buffer->original_cr = NULL;
+    buffer->original_crlf = 0;
+
+    size_t parts = threads * SEARCH_PARTS_PER_THREAD;
+    if (parts > size / INDEX_MIN_CHUNK) {
+        parts = size / INDEX_MIN_CHUNK;
+    }
+    if (threads <= 1 || parts < 1) {
+        parts = 1;
+    }
+    if (parts > INDEX_MAX_CHUNKS) {
+        parts = INDEX_MAX_CHUNKS;
+    }
+    if (parts > sample_count) {
+        parts = sample_count;
+    }
+
+    int unterminated = data[size - 1] != '\n';
+    size_t bounds[INDEX_MAX_CHUNKS + 1];
+    LineIndexJob job;
+    job.data = data;
+    job.from = 0;
+    job.size = size;
+    job.chunk_size = 0;
+    job.bounds = bounds;
+    for (size_t part = 0; part < parts; ++part) {
+        size_t k = part * sample_count / parts;
+        bounds[part] = samples[k];
+        job.counts[part] = k * stride;
+    }
+    bounds[parts] = size;
+    job.counts[parts] = lines - (unterminated ? 1 : 0);
+    if (job.counts[parts] < job.counts[parts - 1]) {
+        return 1;
+    }
+
+    if (reserve_lines(src, lines + 1) != 0 || reserve_pieces(buffer, 1) != 0) {
+        return -1;
+    }
+    src->starts[0] = 0;
+    job.starts = src->starts + 1;
+    parallel_run(threads, parts, index_known_chunk, &job);
+    for (size_t part = 0; part < parts; ++part) {
+        if (job.mismatch[part]) {
+            return 1;
+        }
+    }
+    return finish_original(buffer, &job, parts, lines, unterminated);
+}
+
+int buffer_attach_original(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release)
+{
+    return buffer_attach_original_parallel(buffer, data, size, release, 1);
+}
+
+/* A rejected attach still owns `data`, so it hands it back as documented */
+static int reject_original(char *data, size_t size, BufferReleaseFn release)
+{
+    if (data && release) {
+        release(data, size);
+    }
+    return -1;
+}
+
+/* Attaches `data` with the lines in its first `indexed` bytes indexed */
+static int attach_original(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release, size_t threads,
+                           size_t indexed)
+{
+    if (!buffer || (!data && size > 0)) {
+        return reject_original(data, size, release);
+    }
+
+    buffer_free(buffer);
+    buffer_init(buffer);
+
+    TextSource *src = &buffer->original;
+    src->data = data;
+    src->size = indexed;
+    src->capacity = size;
+    src->release = release;
+
+    int rc = index_original(buffer, 0, threads);
+    src->size = size;
+    if (rc == 0) {
+        rc = copies_reserve(buffer);
+    }
+    if (rc != 0) {
+        buffer_free(buffer);
+        return -1;
+    }
+    return 0;
+}
+
+int buffer_attach_original_parallel(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release,
+                                    size_t threads)
+{
+    return attach_original(buffer, data, size, release, threads, size);
+}
+
+int buffer_attach_original_sampled(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release,
+                                   size_t threads, const size_t *samples, size_t sample_count, size_t stride,
+                                   size_t lines)
+{
+    if (!buffer || (!data && size > 0) || (!samples && sample_count > 0)) {
+        return reject_original(data, size, release);
+    }
+
+    buffer_free(buffer);
+    buffer_init(buffer);
+
+    TextSource *src = &buffer->original;
+    src->data = data;
+    src->size = size;
+    src->capacity = size;
+    src->release = release;
+
+    int rc = sample_count > 0 ? index_original_sampled(buffer, threads, samples, sample_count, stride, lines) : 1;
+    if (rc == 1) {
+        /* Stale samples: find the lines the usual way */
+        rc = index_original(buffer, 0, threads);
+    }
+    if (rc == 0) {
+        rc = copies_reserve(buffer);
+    }
+    if (rc != 0) {
+        buffer_free(buffer);
+        return -1;
+    }
+    return 0;
+}
+
+int buffer_attach_original_lazy(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release,
+                                size_t prefix)
+{
+    if (!buffer || (!data && size > 0)) {
+        return reject_original(data, size, release);
+    }
+
+    /* Stop after the last complete line of the prefix */
+    size_t indexed = prefix < size ? prefix : size;
+    while (indexed < size && indexed > 0 && data[indexed - 1] != '\n') {
+        indexed--;
+    }
+    return attach_original(buffer, data, size, release, 1, indexed);
+}
+
+size_t buffer_original_pending(const TextBuffer *buffer)
+{
+    if (!buffer) {
+        return 0;
+    }
+    const TextSource *src = &buffer->original;
+    size_t indexed = src->starts ? src->starts[src->line_count] : 0;
+    return indexed < src->size ? src->size - indexed : 0;
+}
+
+int buffer_extend_original(TextBuffer *buffer, const size_t *ends, size_t count, int last)
+{
+    if (!buffer || (!ends && count > 0) || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    if (buffer_original_pending(buffer) == 0) {
+        return count == 0 ? 0 : -1;
+    }
+
+    TextSource *src = &buffer->original;
+    size_t first = src->line_count;
+    size_t from = src->starts[first];
+    for (size_t i = 0; i < count; ++i) {
+        if (ends[i] <= (i > 0 ? ends[i - 1] : from) || ends[i] > src->size || src->data[ends[i] - 1] != '\n') {
+            return -1;
+        }
+    }
+    size_t indexed = count > 0 ? ends[count - 1] : from;
+    size_t added = count + (last && indexed < src->size ? 1 : 0);
+    if (added == 0) {
+        return 0;
+    }
+    if (reserve_lines(src, first + added + 1) != 0 || reserve_pieces(buffer, buffer->piece_count + 1) != 0) {
+        return -1;
+    }
+
+    if (count > 0) {
+        memcpy(src->starts + first + 1, ends, count * sizeof(size_t));
+    }
+    if (added > count) {
+        /* An unterminated last line gets a virtual terminator past the end */
+        src->starts[first + added] = src->size + 1;
+    }
+    src->line_count += added;
+
+    int crlf = buffer->original_crlf;
+    for (size_t i = first; i < src->line_count && !crlf; ++i) {
+        size_t end = src->starts[i + 1] - 1;
+        crlf = end > src->starts[i] && src->data[end - 1] == '\r';
+    }
+    if (crlf && count_original_cr(buffer, buffer->original_crlf ? first : 0) != 0) {
+        src->line_count = first;
+        return -1;
+    }
+    buffer->original_crlf = crlf;
+
+    /* The new lines follow the document, continuing its last piece if they can */
+    Piece *tail = buffer->piece_count > 0 ? &buffer->pieces[buffer->piece_count - 1] : NULL;
+    if (tail && tail->source == PIECE_ORIGINAL && tail->first + tail->count == first) {
+        tail->count += added;
+    } else {
+        Piece *piece = &buffer->pieces[buffer->piece_count++];
+        piece->source = PIECE_ORIGINAL;
+        piece->first = first;
+        piece->count = added;
+    }
+    buffer->count += added;
+    refresh_lines(buffer, buffer->piece_count - 1);
+    return 0;
+}
+
+int buffer_insert_line(TextBuffer *buffer, size_t index, const char *text)
+{
+    return buffer_insert_line_n(buffer, index, text, text ? strlen(text) : 0);
+}
+
+int buffer_insert_line_n(TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+    if (!buffer || index > buffer->count || (!text && len > 0) || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    if (reserve_pieces(buffer, buffer->piece_count + 2) != 0) {
+        return -1;
+    }
+
+    size_t source = 0;
+    size_t line = 0;
+    if (arena_append(buffer, text, len, &source, &line) != 0) {
+        return -1;
+    }
+
+    size_t p = split_at(buffer, index);
+    Piece *prev = p > 0 ? &buffer->pieces[p - 1] : NULL;
+
+    if (prev && prev->source == source && prev->first + prev->count == line) {
+        /* Typing or appending consecutive lines keeps growing one piece */
+        prev->count++;
+        p--;
+    } else {
+        open_piece_slot(buffer, p);
+        buffer->pieces[p].source = source;
+        buffer->pieces[p].first = line;
+        buffer->pieces[p].count = 1;
+    }
+
+    buffer->count++;
+    refresh_lines(buffer, p);
+    return 0;
+}
+
+int buffer_append_line(TextBuffer *buffer, const char *text)
+{
+    return buffer_insert_line(buffer, buffer ? buffer->count : 0, text);
+}
+
+int buffer_append_line_n(TextBuffer *buffer, const char *text, size_t len)
+{
+    return buffer_insert_line_n(buffer, buffer ? buffer->count : 0, text, len);
+}
+
+int buffer_delete_line(TextBuffer *buffer, size_t index)
+{
+    if (!buffer || index >= buffer->count || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    if (reserve_pieces(buffer, buffer->piece_count + 1) != 0) {
+        return -1;
+    }
+
+    size_t p = find_piece(buffer, index);
+    Piece *piece = &buffer->pieces[p];
+    size_t offset = index - piece->line;
+
+    if (piece->count == 1) {
+        remove_piece(buffer, p);
+        if (p > 0) {
+            p = merge_neighbours(buffer, p - 1);
+        }
+    } else if (offset == 0) {
+        piece->first++;
+        piece->count--;
+    } else if (offset == piece->count - 1) {
+        piece->count--;
+    } else {
+        p = split_at(buffer, index);
+        buffer->pieces[p].first++;
+        buffer->pieces[p].count--;
+    }
+
+    buffer->count--;
+    refresh_lines(buffer, p);
+    return 0;
+}
+
+/* Finds the piece that starts at line `index`, which a split has ensured */
+static size_t piece_starting_at(const TextBuffer *buffer, size_t index)
+{
+    return index >= buffer->count ? buffer->piece_count : find_piece(buffer, index);
+}
+
+/*
+ * Merges adjacent pieces among positions [from, to) and renumbers the
+ * pieces from `from` on. The rest of the list is shifted at most once.
+ */
+static void merge_and_refresh(TextBuffer *buffer, size_t from, size_t to)
+{
+    if (to > buffer->piece_count) {
+        to = buffer->piece_count;
+    }
+
+    size_t out = from;
+    for (size_t p = from; p < to; ++p) {
+        if (out > from && pieces_adjacent(&buffer->pieces[out - 1], &buffer->pieces[p])) {
+            buffer->pieces[out - 1].count += buffer->pieces[p].count;
+        } else {
+            buffer->pieces[out++] = buffer->pieces[p];
+        }
+    }
+    if (out < to) {
+        memmove(&buffer->pieces[out], &buffer->pieces[to], (buffer->piece_count - to) * sizeof(Piece));
+        buffer->piece_count -= to - out;
+    }
+    refresh_lines(buffer, from);
+}
+
+static void reverse_pieces(Piece *pieces, size_t from, size_t to)
+{
+    while (from + 1 < to) {
+        Piece swap = pieces[from];
+        pieces[from++] = pieces[--to];
+        pieces[to] = swap;
+    }
+}
+
+int buffer_delete_lines(TextBuffer *buffer, size_t index, size_t count)
+{
+    if (!buffer || index > buffer->count || count > buffer->count - index || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    if (reserve_pieces(buffer, buffer->piece_count + 2) != 0) {
+        return -1;
+    }
+
+    size_t p = split_at(buffer, index);
+    size_t q = split_at(buffer, index + count);
+    memmove(&buffer->pieces[p], &buffer->pieces[q], (buffer->piece_count - q) * sizeof(Piece));
+    buffer->piece_count -= q - p;
+    buffer->count -= count;
+
+    merge_and_refresh(buffer, p > 0 ? p - 1 : 0, p + 1);
+    return 0;
+}
+
+int buffer_insert_lines(TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+    if (!buffer || index > buffer->count || (!text && len > 0) || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    /* Lines packed one after another into a block share one piece */
+    void *runs = NULL;
+    size_t run_count = 0;
+    size_t run_capacity = 0;
+    size_t lines = 0;
+    const char *at = text;
+    const char *end = len > 0 ? text + len : text;
+
+    for (;;) {
+        const char *newline = at < end ? memchr(at, '\n', (size_t)(end - at)) : NULL;
+        size_t line_len = (size_t)((newline ? newline : end) - at);
+        size_t source = 0;
+        size_t line = 0;
+        if (arena_append(buffer, at, line_len, &source, &line) != 0) {
+            free(runs);
+            return -1;
+        }
+
+        Piece *last = run_count > 0 ? (Piece *)runs + run_count - 1 : NULL;
+        if (last && last->source == source && last->first + last->count == line) {
+            last->count++;
+        } else {
+            if (grow_array(&runs, &run_capacity, run_count + 1, sizeof(Piece)) != 0) {
+                free(runs);
+                return -1;
+            }
+            Piece *run = (Piece *)runs + run_count++;
+            run->source = source;
+            run->first = line;
+            run->count = 1;
+        }
+        lines++;
+
+        if (!newline) {
+            break;
+        }
+        at = newline + 1;
+    }
+
+    if (reserve_pieces(buffer, buffer->piece_count + run_count + 1) != 0) {
+        free(runs);
+        return -1;
+    }
+
+    size_t p = split_at(buffer, index);
+    memmove(&buffer->pieces[p + run_count], &buffer->pieces[p], (buffer->piece_count - p) * sizeof(Piece));
+    memcpy(&buffer->pieces[p], runs, run_count * sizeof(Piece));
+    buffer->piece_count += run_count;
+    buffer->count += lines;
+    free(runs);
+
+    merge_and_refresh(buffer, p > 0 ? p - 1 : 0, p + run_count + 1);
+    return 0;
+}
+
+int buffer_move_lines(TextBuffer *buffer, size_t index, size_t count, size_t dest)
+{
+    if (!buffer || index > buffer->count || count > buffer->count - index || dest > buffer->count - count ||
+        buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    if (count == 0 || dest == index) {
+        return 0;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    if (reserve_pieces(buffer, buffer->piece_count + 3) != 0) {
+        return -1;
+    }
+
+    /* Where the block goes, counted in the document as it is now */
+    size_t target = dest < index ? dest : dest + count;
+    split_at(buffer, index);
+    split_at(buffer, index + count);
+    split_at(buffer, target);
+    size_t p = piece_starting_at(buffer, index);
+    size_t q = piece_starting_at(buffer, index + count);
+    size_t t = piece_starting_at(buffer, target);
+
+    /* Rotate the block past the pieces between it and its destination */
+    size_t from = t < p ? t : p;
+    size_t to = t < p ? q : t;
+    size_t mid = t < p ? p : q;
+    reverse_pieces(buffer->pieces, from, mid);
+    reverse_pieces(buffer->pieces, mid, to);
+    reverse_pieces(buffer->pieces, from, to);
+
+    merge_and_refresh(buffer, from > 0 ? from - 1 : 0, to + 1);
+    return 0;
+}
+
+int buffer_copy_lines(TextBuffer *buffer, size_t index, size_t count, size_t dest)
+{
+    if (!buffer || index > buffer->count || count > buffer->count - index || dest > buffer->count ||
+        buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    if (reserve_pieces(buffer, buffer->piece_count + 3) != 0) {
+        return -1;
+    }
+    split_at(buffer, index);
+    split_at(buffer, index + count);
+    split_at(buffer, dest);
+    size_t p = piece_starting_at(buffer, index);
+    size_t q = piece_starting_at(buffer, index + count);
+    size_t t = piece_starting_at(buffer, dest);
+
+    size_t block = q - p;
+    if (reserve_pieces(buffer, buffer->piece_count + block) != 0) {
+        return -1;
+    }
+    memmove(&buffer->pieces[t + block], &buffer->pieces[t], (buffer->piece_count - t) * sizeof(Piece));
+    buffer->piece_count += block;
+    for (size_t i = 0; i < block; ++i) {
+        /* Pieces of the block at or after the gap have moved up by `block` */
+        buffer->pieces[t + i] = buffer->pieces[p + i < t ? p + i : p + i + block];
+    }
+    buffer->count += count;
+
+    /* Lines are now referenced twice, so the arena must not rewrite them */
+    LineArena *arena = &buffer->arena;
+    for (size_t i = t; i < t + block && arena->open != PIECE_ORIGINAL; ++i) {
+        const Piece *piece = &buffer->pieces[i];
+        if (piece->source == arena->open && piece->first + piece->count == arena->blocks[arena->open - 1].line_count) {
+            arena->tail_shared = 1;
+        }
+    }
+
+    /* The splits left pieces without offsets from the block's start on */
+    size_t from = p < t ? p : t;
+    merge_and_refresh(buffer, from > 0 ? from - 1 : 0, t + block + 1);
+    return 0;
+}
+
+int buffer_replace_line(TextBuffer *buffer, size_t index, const char *text)
+{
+    return buffer_replace_line_n(buffer, index, text, text ? strlen(text) : 0);
+}
+
+static int replace_line(TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+
+    if (reserve_pieces(buffer, buffer->piece_count + 2) != 0) {
+        return -1;
+    }
+
+    size_t p = find_piece(buffer, index);
+    size_t old_source = buffer->pieces[p].source;
+    size_t old_line = buffer->pieces[p].first + (index - buffer->pieces[p].line);
+    int reused = arena_reuse_tail(&buffer->arena, old_source, old_line);
+
+    size_t source = 0;
+    size_t line = 0;
+    if (arena_append(buffer, text, len, &source, &line) != 0) {
+        if (reused) {
+            arena_restore_tail(&buffer->arena);
+        }
+        return -1;
+    }
+
+    if (source == old_source && line == old_line) {
+        /* Rewritten in place; only the offsets after it can change */
+        refresh_lines(buffer, p + 1);
+        return 0;
+    }
+
+    p = split_at(buffer, index);
+    split_at(buffer, index + 1);
+    buffer->pieces[p].source = source;
+    buffer->pieces[p].first = line;
+
+    p = merge_neighbours(buffer, p);
+    refresh_lines(buffer, p);
+    return 0;
+}
+
+int buffer_replace_line_n(TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+    if (!buffer || index >= buffer->count || (!text && len > 0) || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    if (buffer->edit.line == index) {
+        buffer->edit.line = INVALID_INDEX;
+    }
+    return replace_line(buffer, index, text, len);
+}
+
+/* Appends a piece to `pieces`, extending the last one where it continues */
+static void emit_piece(Piece *pieces, size_t *count, size_t source, size_t first, size_t lines)
+{
+    Piece *last = *count > 0 ? &pieces[*count - 1] : NULL;
+    if (last && last->source == source && last->first + last->count == first) {
+        last->count += lines;
+        return;
+    }
+    pieces[*count].source = source;
+    pieces[*count].first = first;
+    pieces[*count].count = lines;
+    (*count)++;
+}
+
+int buffer_replace_lines(TextBuffer *buffer, const BufferLineEdit *edits, size_t count)
+{
+    if (!buffer || (!edits && count > 0) || buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+    for (size_t e = 0; e < count; ++e) {
+        if (edits[e].line >= buffer->count || (e > 0 && edits[e].line <= edits[e - 1].line) ||
+            (!edits[e].text && edits[e].len > 0)) {
+            return -1;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    buffer->edit.line = INVALID_INDEX;
+
+    /* Each edit can split one piece in three */
+    size_t capacity = buffer->piece_count + 2 * count;
+    Piece *pieces = (Piece *)malloc(capacity * sizeof(Piece));
+    if (!pieces) {
+        return -1;
+    }
+    stats_count_allocation(capacity * sizeof(Piece));
+
+    size_t used = 0;
+    size_t e = 0;
+    for (size_t p = 0; p < buffer->piece_count; ++p) {
+        const Piece *piece = &buffer->pieces[p];
+        size_t end = piece->line + piece->count;
+        size_t at = piece->line;
+
+        for (; e < count && edits[e].line < end; ++e) {
+            size_t source = 0;
+            size_t line = 0;
+            if (arena_append(buffer, edits[e].text, edits[e].len, &source, &line) != 0) {
+                free(pieces);
+                return -1;
+            }
+            if (edits[e].line > at) {
+                emit_piece(pieces, &used, piece->source, piece->first + (at - piece->line), edits[e].line - at);
+            }
+            emit_piece(pieces, &used, source, line, 1);
+            at = edits[e].line + 1;
+        }
+        if (at < end) {
+            emit_piece(pieces, &used, piece->source, piece->first + (at - piece->line), end - at);
+        }
+    }
+
+    free(buffer->pieces);
+    buffer->pieces = pieces;
+    buffer->piece_count = used;
+    buffer->piece_capacity = capacity;
+    refresh_lines(buffer, 0);
+    return 0;
+}
+
+static size_t gap_text_len(const LineGap *gap)
+{
+    return gap->capacity - (gap->gap_end - gap->gap_start);
+}
+
+static void gap_move(LineGap *gap, size_t column)
+{
+    if (column < gap->gap_start) {
+        size_t n = gap->gap_start - column;
+        memmove(gap->data + gap->gap_end - n, gap->data + column, n);
+        gap->gap_start -= n;
+        gap->gap_end -= n;
+    } else if (column > gap->gap_start) {
+        size_t n = column - gap->gap_start;
+        memmove(gap->data + gap->gap_start, gap->data + gap->gap_end, n);
+        gap->gap_start += n;
+        gap->gap_end += n;
+    }
+}
+
+/* Makes the gap at least `len` bytes, growing the buffer geometrically */
+static int gap_reserve(LineGap *gap, size_t len)
+{
+    if (gap->gap_end - gap->gap_start >= len) {
+        return 0;
+    }
+
+    size_t text_len = gap_text_len(gap);
+    size_t capacity = gap->capacity ? gap->capacity * 2 : 64;
+    while (capacity - text_len < len) {
+        capacity *= 2;
+    }
+    char *data = (char *)realloc(gap->data, capacity);
+    if (!data) {
+        return -1;
+    }
+    stats_count_allocation(capacity);
+
+    size_t tail = gap->capacity - gap->gap_end;
+    memmove(data + capacity - tail, data + gap->gap_end, tail);
+    gap->data = data;
+    gap->gap_end = capacity - tail;
+    gap->capacity = capacity;
+    return 0;
+}
+
+/* Loads line `index` into the gap buffer unless it is already there */
+static int gap_load(TextBuffer *buffer, size_t index)
+{
+    LineGap *gap = &buffer->edit;
+    if (gap->line == index) {
+        return 0;
+    }
+    if (buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+
+    const Piece *piece = &buffer->pieces[find_piece(buffer, index)];
+    size_t len = 0;
+    const char *text = line_span(buffer, piece, index - piece->line, &len);
+
+    gap->line = INVALID_INDEX;
+    gap->gap_start = 0;
+    gap->gap_end = gap->capacity;
+    if (gap_reserve(gap, len + len / 2 + 16) != 0) {
+        return -1;
+    }
+    memcpy(gap->data + gap->gap_end - len, text, len);
+    gap->gap_end -= len;
+    gap->line = index;
+    return 0;
+}
+
+int buffer_sync_edit(TextBuffer *buffer)
+{
+    if (!buffer || !buffer->edit.dirty) {
+        return 0;
+    }
+
+    /* The pieces get the same document, now out of the gap buffer */
+    LineGap *gap = &buffer->edit;
+    size_t len = gap_text_len(gap);
+    gap_move(gap, len);
+    if (replace_line(buffer, gap->line, gap->data, len) != 0) {
+        return -1;
+    }
+    gap->dirty = 0;
+    return 0;
+}
+
+int buffer_insert_chars(TextBuffer *buffer, size_t index, size_t column, const char *text, size_t len)
+{
+    if (!buffer || index >= buffer->count || (!text && len > 0) ||
+        (len > 0 && memchr(text, '\n', len)) || copies_reserve(buffer) != 0 || gap_load(buffer, index) != 0) {
+        return -1;
+    }
+
+    LineGap *gap = &buffer->edit;
+    if (column > gap_text_len(gap)) {
+        return -1;
+    }
+    gap_move(gap, column);
+    if (gap_reserve(gap, len) != 0) {
+        return -1;
+    }
+    if (len > 0) {
+        memcpy(gap->data + gap->gap_start, text, len);
+        gap->gap_start += len;
+        gap->dirty = 1;
+    }
+    return 0;
+}
+
+int buffer_delete_chars(TextBuffer *buffer, size_t index, size_t column, size_t count)
+{
+    if (!buffer || index >= buffer->count || copies_reserve(buffer) != 0 || gap_load(buffer, index) != 0) {
+        return -1;
+    }
+
+    LineGap *gap = &buffer->edit;
+    size_t len = gap_text_len(gap);
+    if (column > len || count > len - column) {
+        return -1;
+    }
+    gap_move(gap, column);
+    if (count > 0) {
+        gap->gap_end += count;
+        gap->dirty = 1;
+    }
+    return 0;
+}
+
+const char *buffer_get_line(const TextBuffer *buffer, size_t index)
+{
+    if (!buffer || index >= buffer->count) {
+        return NULL;
+    }
+
+    LineCopies *copies = buffer->copies;
+    const LineGap *gap = &buffer->edit;
+    if (gap->dirty && gap->line == index) {
+        /* The pending edit, joined around the gap */
+        size_t len = gap_text_len(gap);
+        if (len + 1 > copies->edit_capacity) {
+            char *edit = (char *)realloc(copies->edit, len + 1);
+            if (!edit) {
+                return NULL;
+            }
+            copies->bytes += len + 1 - copies->edit_capacity;
+            copies->edit = edit;
+            copies->edit_capacity = len + 1;
+        }
+        memcpy(copies->edit, gap->data, gap->gap_start);
+        memcpy(copies->edit + gap->gap_start, gap->data + gap->gap_end, gap->capacity - gap->gap_end);
+        copies->edit[len] = '\0';
+        return copies->edit;
+    }
+
+    const Piece *piece = &buffer->pieces[find_piece(buffer, index)];
+    size_t len = 0;
+    const char *text = line_span(buffer, piece, index - piece->line, &len);
+    if (piece->source != PIECE_ORIGINAL) {
+        return text; /* arena lines are stored NUL-terminated */
+    }
+
+    /* Original lines are views into the file; each gets one terminated copy */
+    char **slot = copies ? copies_slot(copies, piece->first + (index - piece->line)) : NULL;
+    if (slot && !*slot) {
+        *slot = copies_store(copies, text, len);
+    }
+    return slot ? *slot : NULL;
+}
 
-static char *duplicate_string(const char *src)
+const char *buffer_get_line_n(const TextBuffer *buffer, size_t index, size_t *len)
 {
-    if (!src) {
+    if (!buffer || !len || index >= buffer->count || buffer->edit.dirty) {
         return NULL;
     }
 
-    size_t len = strlen(src);
-    char *copy = (char *)malloc(len + 1);
-    if (!copy) {
-        return NULL;
+    const Piece *piece = &buffer->pieces[find_piece(buffer, index)];
+    return line_span(buffer, piece, index - piece->line, len);
+}
+
+void buffer_print(const TextBuffer *buffer)
+{
+    if (!buffer || buffer->count == 0 || buffer->edit.dirty) {
+        printf("[Buffer is empty]\n");
+        return;
+    }
+
+    for (size_t p = 0; p < buffer->piece_count; ++p) {
+        const Piece *piece = &buffer->pieces[p];
+        for (size_t i = 0; i < piece->count; ++i) {
+            size_t len = 0;
+            const char *text = line_span(buffer, piece, i, &len);
+            printf("%zu: ", piece->line + i + 1);
+            fwrite(text, 1, len, stdout);
+            putchar('\n');
+        }
     }
-    memcpy(copy, src, len + 1);
-    return copy;
 }
 
-static int ensure_capacity(TextBuffer *buffer, size_t min_capacity)
+size_t buffer_size(const TextBuffer *buffer)
 {
-    if (buffer->capacity >= min_capacity) {
+    if (!buffer || buffer->piece_count == 0) {
         return 0;
     }
+    const Piece *last = &buffer->pieces[buffer->piece_count - 1];
+    size_t size = last->offset + run_bytes(buffer, last, 0, last->count);
 
-    size_t new_capacity = buffer->capacity ? buffer->capacity : INITIAL_CAPACITY;
-    while (new_capacity < min_capacity) {
-        new_capacity *= 2;
+    /* A pending edit only changes the length of its line */
+    if (buffer->edit.dirty) {
+        const LineGap *gap = &buffer->edit;
+        const Piece *piece = &buffer->pieces[find_piece(buffer, gap->line)];
+        size = size - run_bytes(buffer, piece, gap->line - piece->line, 1) + 1 + gap_text_len(gap);
     }
+    return size;
+}
 
-    char **new_lines = (char **)realloc(buffer->lines, new_capacity * sizeof(char *));
-    if (!new_lines) {
-        return -1;
+size_t buffer_line_length(const TextBuffer *buffer, size_t index)
+{
+    if (!buffer || index >= buffer->count || buffer->edit.dirty) {
+        return INVALID_INDEX;
     }
+    const Piece *piece = &buffer->pieces[find_piece(buffer, index)];
+    return run_bytes(buffer, piece, index - piece->line, 1) - 1;
+}
 
-    buffer->lines = new_lines;
-    buffer->capacity = new_capacity;
-    return 0;
+size_t buffer_line_offset(const TextBuffer *buffer, size_t index)
+{
+    if (!buffer || index > buffer->count || buffer->edit.dirty) {
+        return INVALID_INDEX;
+    }
+    if (index == buffer->count) {
+        return buffer_size(buffer);
+    }
+    const Piece *piece = &buffer->pieces[find_piece(buffer, index)];
+    return piece->offset + run_bytes(buffer, piece, 0, index - piece->line);
 }
 
-void buffer_init(TextBuffer *buffer)
+size_t buffer_line_at_offset(const TextBuffer *buffer, size_t offset, size_t *column)
 {
-    if (!buffer) {
-        return;
+    if (!buffer || buffer->edit.dirty || offset >= buffer_size(buffer)) {
+        return INVALID_INDEX;
     }
-    buffer->lines = NULL;
-    buffer->count = 0;
-    buffer->capacity = 0;
+
+    size_t lo = 0;
+    size_t hi = buffer->piece_count;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (buffer->pieces[mid].offset <= offset) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /* Last line of the piece starting at or before the offset */
+    const Piece *piece = &buffer->pieces[lo];
+    size_t within = offset - piece->offset;
+    size_t first = 0;
+    size_t last = piece->count;
+    while (last - first > 1) {
+        size_t mid = first + (last - first) / 2;
+        if (run_bytes(buffer, piece, 0, mid) <= within) {
+            first = mid;
+        } else {
+            last = mid;
+        }
+    }
+
+    if (column) {
+        *column = within - run_bytes(buffer, piece, 0, first);
+    }
+    return piece->line + first;
 }
 
-void buffer_free(TextBuffer *buffer)
+void buffer_memory_stats(const TextBuffer *buffer, BufferMemoryStats *stats)
 {
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
     if (!buffer) {
         return;
     }
 
-    for (size_t i = 0; i < buffer->count; ++i) {
-        free(buffer->lines[i]);
+    const TextSource *orig = &buffer->original;
+    stats->document_bytes = buffer_size(buffer);
+    stats->original_bytes = orig->size;
+    stats->index_used = orig->starts ? (orig->line_count + 1) * sizeof(size_t) : 0;
+    stats->index_capacity = orig->line_capacity * sizeof(size_t);
+    stats->pieces_used = buffer->piece_count * sizeof(Piece);
+    stats->pieces_capacity = buffer->piece_capacity * sizeof(Piece);
+
+    for (size_t i = 0; i < buffer->arena.block_count; ++i) {
+        const TextSource *block = &buffer->arena.blocks[i];
+        stats->index_used += block->starts ? (block->line_count + 1) * sizeof(size_t) : 0;
+        stats->index_capacity += block->line_capacity * sizeof(size_t);
+        stats->arena_used += block->size;
+        stats->arena_capacity += block->capacity;
+    }
+
+    stats->other_bytes = buffer->arena.block_capacity * sizeof(TextSource) + buffer->edit.capacity +
+                         (buffer->copies ? buffer->copies->bytes : 0);
+    if (buffer->original_cr) {
+        stats->other_bytes += (orig->line_count + 1) * sizeof(size_t);
     }
-    free(buffer->lines);
-    buffer->lines = NULL;
-    buffer->count = 0;
-    buffer->capacity = 0;
 }
 
-int buffer_insert_line(TextBuffer *buffer, size_t index, const char *text)
+size_t buffer_get_spans(const TextBuffer *buffer, size_t *line, size_t end_line, BufferSpan *out, size_t max)
+{
+    static const char newline[] = "\n";
+    size_t used = 0;
+
+    if (!buffer || !line || !out || buffer->edit.dirty) {
+        return 0;
+    }
+    if (end_line > buffer->count) {
+        end_line = buffer->count;
+    }
+    if (*line >= end_line) {
+        return 0;
+    }
+
+    size_t p = find_piece(buffer, *line);
+    /* Each line needs at most two spans: its text and a separate newline */
+    while (p < buffer->piece_count && buffer->pieces[p].line < end_line && used + 2 <= max) {
+        const Piece *piece = &buffer->pieces[p];
+        const TextSource *src = piece_source(buffer, piece);
+        size_t i = *line - piece->line;
+        size_t limit = end_line - piece->line < piece->count ? end_line - piece->line : piece->count;
+        int open = 0;
+
+        for (; i < limit && used + 2 <= max; ++i) {
+            size_t len = 0;
+            const char *text = line_span(buffer, piece, i, &len);
+            size_t terminator = src->starts[piece->first + i + 1] - 1;
+
+            /* Original lines with their '\n' in place extend the open span */
+            if (piece->source == PIECE_ORIGINAL && terminator < src->size &&
+                text + len == src->data + terminator) {
+                if (open) {
+                    out[used - 1].len += len + 1;
+                } else {
+                    out[used].data = text;
+                    out[used].len = len + 1;
+                    used++;
+                    open = 1;
+                }
+                continue;
+            }
+
+            /* Arena lines end in NUL, and stripped CRs leave a gap */
+            if (open) {
+                out[used - 1].len += len;
+            } else if (len > 0) {
+                out[used].data = text;
+                out[used].len = len;
+                used++;
+            }
+            out[used].data = newline;
+            out[used].len = 1;
+            used++;
+            open = 0;
+        }
+
+        *line = piece->line + i;
+        if (i < piece->count) {
+            break;
+        }
+        p++;
+    }
+
+    return used;
+}
+
+int buffer_snapshot(TextBuffer *buffer, BufferSnapshot *snapshot)
 {
-    if (!buffer || index > buffer->count) {
+    if (!buffer || !snapshot) {
+        return -1;
+    }
+    memset(snapshot, 0, sizeof(*snapshot));
+    if (buffer_sync_edit(buffer) != 0) {
         return -1;
     }
 
-    if (ensure_capacity(buffer, buffer->count + 1) != 0) {
+    size_t capacity = 0;
+    size_t line = 0;
+    for (;;) {
+        /* Two spans per line at most, so a piece's worth always fits */
+        if (capacity - snapshot->count < 1024) {
+            void *spans = snapshot->spans;
+            if (grow_array(&spans, &capacity, snapshot->count + 1024, sizeof(BufferSpan)) != 0) {
+                free(snapshot->spans);
+                memset(snapshot, 0, sizeof(*snapshot));
+                return -1;
+            }
+            snapshot->spans = (BufferSpan *)spans;
+        }
+
+        size_t count = buffer_get_spans(buffer, &line, buffer->count, snapshot->spans + snapshot->count,
+                                        capacity - snapshot->count);
+        if (count == 0) {
+            break;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            snapshot->size += snapshot->spans[snapshot->count + i].len;
+        }
+        snapshot->count += count;
+    }
+
+    buffer->arena.pinned++;
+    return 0;
+}
+
+void buffer_snapshot_release(TextBuffer *buffer, BufferSnapshot *snapshot)
+{
+    if (!buffer || !snapshot) {
+        return;
+    }
+    if (snapshot->spans && buffer->arena.pinned > 0) {
+        buffer->arena.pinned--;
+    }
+    free(snapshot->spans);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+/* Length of original line `line` as stored, CR included; -1 if unterminated */
+static long original_line_len(const TextSource *src, size_t line)
+{
+    size_t terminator = src->starts[line + 1] - 1;
+    if (terminator >= src->size) {
         return -1;
     }
+    return (long)(terminator - src->starts[line]);
+}
 
-    for (size_t i = buffer->count; i > index; --i) {
-        buffer->lines[i] = buffer->lines[i - 1];
+static int diff_add_patch(BufferDiff *diff, size_t line, size_t offset, size_t len)
+{
+    BufferRange *last = diff->patch_count > 0 ? &diff->patches[diff->patch_count - 1] : NULL;
+    if (last && last->line + last->count == line) {
+        last->count++;
+        last->len += len;
+        return 0;
     }
 
-    buffer->lines[index] = duplicate_string(text ? text : "");
-    if (!buffer->lines[index]) {
+    void *patches = diff->patches;
+    if (grow_array(&patches, &diff->patch_capacity, diff->patch_count + 1, sizeof(BufferRange)) != 0) {
         return -1;
     }
+    diff->patches = (BufferRange *)patches;
+    diff->patches[diff->patch_count].line = line;
+    diff->patches[diff->patch_count].count = 1;
+    diff->patches[diff->patch_count].offset = offset;
+    diff->patches[diff->patch_count].len = len;
+    diff->patch_count++;
+    return 0;
+}
 
-    buffer->count++;
+int buffer_diff_original(const TextBuffer *buffer, BufferDiff *diff)
+{
+    if (!buffer || !diff) {
+        return -1;
+    }
+    memset(diff, 0, sizeof(*diff));
+    if (buffer->edit.dirty) {
+        return -1;
+    }
+
+    const TextSource *orig = &buffer->original;
+    size_t line = 0;
+    size_t offset = 0;
+    size_t p = 0;
+
+    /* Lines keep their place while every earlier line kept its length */
+    for (; p < buffer->piece_count; ++p) {
+        const Piece *piece = &buffer->pieces[p];
+        size_t i = 0;
+
+        if (piece->source == PIECE_ORIGINAL && piece->first == line && !buffer->original_crlf) {
+            /* Untouched: only an unterminated last line differs once saved */
+            size_t aligned = piece->count;
+            if (original_line_len(orig, piece->first + aligned - 1) < 0) {
+                aligned--;
+            }
+            line += aligned;
+            offset = orig->starts[line];
+            if (aligned == piece->count) {
+                continue;
+            }
+            i = aligned;
+        }
+
+        for (; i < piece->count; ++i) {
+            size_t len = 0;
+            line_span(buffer, piece, i, &len);
+            if (line >= orig->line_count || original_line_len(orig, line) != (long)len ||
+                buffer->original_crlf) {
+                break;
+            }
+            if (diff_add_patch(diff, line, offset, len + 1) != 0) {
+                buffer_diff_free(diff);
+                return -1;
+            }
+            line++;
+            offset += len + 1;
+        }
+        if (i < piece->count) {
+            break;
+        }
+    }
+
+    diff->suffix_line = line;
+    diff->suffix_offset = offset;
+    diff->size = buffer_size(buffer);
     return 0;
 }
 
-int buffer_append_line(TextBuffer *buffer, const char *text)
+void buffer_diff_free(BufferDiff *diff)
 {
-    return buffer_insert_line(buffer, buffer->count, text);
+    if (!diff) {
+        return;
+    }
+    free(diff->patches);
+    diff->patches = NULL;
+    diff->patch_count = 0;
+    diff->patch_capacity = 0;
 }
 
-int buffer_delete_line(TextBuffer *buffer, size_t index)
+int buffer_rebase_original(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release, size_t keep)
 {
-    if (!buffer || index >= buffer->count) {
+    if (!buffer || (!data && size > 0) || keep > buffer->original.line_count || copies_reserve(buffer) != 0) {
+        if (release && data) {
+            release(data, size);
+        }
         return -1;
     }
 
-    free(buffer->lines[index]);
+    buffer->edit.line = INVALID_INDEX;
+    buffer->edit.dirty = 0;
+    copies_forget(buffer->copies, keep); /* the first keep lines read the same in the new file */
 
-    for (size_t i = index; i + 1 < buffer->count; ++i) {
-        buffer->lines[i] = buffer->lines[i + 1];
+    TextSource *src = &buffer->original;
+    if (src->release && src->data) {
+        src->release(src->data, src->capacity);
     }
+    src->data = data;
+    src->size = size;
+    src->capacity = size;
+    src->release = release;
 
-    buffer->count--;
+    arena_free(&buffer->arena);
+    if (index_original(buffer, keep, parallel_default_threads()) != 0) {
+        /* Without a complete index the old lines cannot be shown either */
+        source_free(src);
+        buffer->piece_count = 0;
+        buffer->count = 0;
+        return -1;
+    }
     return 0;
 }
 
-int buffer_replace_line(TextBuffer *buffer, size_t index, const char *text)
+int buffer_rebase_saved(TextBuffer *buffer, char *data, size_t size, BufferReleaseFn release)
 {
-    if (!buffer || index >= buffer->count) {
+    TextSource saved;
+    source_init(&saved);
+    if (!buffer || (!data && size > 0) || buffer->edit.dirty || buffer->arena.pinned > 0 ||
+        buffer_original_pending(buffer) > 0 || size != buffer_size(buffer) || copies_reserve(buffer) != 0 ||
+        reserve_lines(&saved, buffer->count + 1) != 0 || reserve_pieces(buffer, 1) != 0) {
+        free(saved.starts);
+        if (release && data) {
+            release(data, size);
+        }
         return -1;
     }
 
-    char *new_line = duplicate_string(text ? text : "");
-    if (!new_line) {
-        return -1;
+    /* The saved file holds the pieces back to back, so their lengths are its line table */
+    size_t line = 0;
+    size_t offset = 0;
+    for (size_t p = 0; p < buffer->piece_count; ++p) {
+        const Piece *piece = &buffer->pieces[p];
+        for (size_t i = 0; i < piece->count; ++i) {
+            saved.starts[line++] = offset;
+            offset += run_bytes(buffer, piece, i, 1);
+        }
     }
+    saved.starts[line] = offset;
+    saved.line_count = line;
+    saved.data = data;
+    saved.size = size;
+    saved.capacity = size;
+    saved.release = release;
+
+    copies_forget(buffer->copies, 0);
+    source_free(&buffer->original);
+    buffer->original = saved;
+    free(buffer->original_cr);
+    buffer->original_cr = NULL;
+    buffer->original_crlf = 0;
+    arena_free(&buffer->arena);
 
-    free(buffer->lines[index]);
-    buffer->lines[index] = new_line;
+    buffer->piece_count = 0;
+    if (line > 0) {
+        buffer->pieces[0].source = PIECE_ORIGINAL;
+        buffer->pieces[0].first = 0;
+        buffer->pieces[0].count = line;
+        buffer->pieces[0].line = 0;
+        buffer->pieces[0].offset = 0;
+        buffer->piece_count = 1;
+    }
+    buffer->edit.line = INVALID_INDEX;
     return 0;
 }
 
-const char *buffer_get_line(const TextBuffer *buffer, size_t index)
+size_t buffer_find(const TextBuffer *buffer, const char *needle)
 {
-    if (!buffer || index >= buffer->count) {
-        return NULL;
+    BufferSearch search;
+    BufferMatch match;
+
+    buffer_search_init(&search, needle);
+    if (buffer_find_all(buffer, &search, &match, 1) == 0) {
+        return INVALID_INDEX;
     }
-    return buffer->lines[index];
+    return match.line;
 }
 
-void buffer_print(const TextBuffer *buffer)
+void buffer_search_init(BufferSearch *search, const char *needle)
 {
-    if (!buffer || buffer->count == 0) {
-        printf("[Buffer is empty]\n");
+    buffer_search_init_n(search, needle, needle ? strlen(needle) : 0);
+}
+
+void buffer_search_init_n(BufferSearch *search, const char *needle, size_t len)
+{
+    if (!search) {
         return;
     }
+    search->needle = needle;
+    search->needle_len = needle ? len : 0;
+    search->pattern = NULL;
+    search->line = 0;
+    search->column = 0;
+    search->after_match = 0;
+}
 
-    for (size_t i = 0; i < buffer->count; ++i) {
-        printf("%zu: %s\n", i + 1, buffer->lines[i] ? buffer->lines[i] : "");
+void buffer_search_init_regex(BufferSearch *search, Pattern *pattern)
+{
+    if (!search) {
+        return;
     }
+    search->needle = pattern_literal(pattern, &search->needle_len);
+    search->pattern = pattern;
+    search->line = 0;
+    search->column = 0;
+    search->after_match = 0;
 }
 
-size_t buffer_find(const TextBuffer *buffer, const char *needle)
+static int search_is_empty(const BufferSearch *search)
 {
-    if (!buffer || !needle || needle[0] == '\0') {
-        return INVALID_INDEX;
+    return search->pattern ? 0 : search->needle_len == 0;
+}
+
+/* Moves the search position past `match`; empty matches advance one byte */
+static void search_advance(BufferSearch *search, const BufferMatch *match)
+{
+    search->line = match->line;
+    search->column = match->column + (match->length ? match->length : 1);
+    search->after_match = match->length > 0;
+}
+
+/*
+ * Regex matches in lines [search->line, end_line). The required literal
+ * finds candidate lines a whole piece at a time; only those lines are run
+ * through the pattern.
+ */
+static size_t find_regex_range(const TextBuffer *buffer, BufferSearch *search, size_t end_line,
+                               BufferMatch *out, size_t max)
+{
+    size_t found = 0;
+    size_t p = find_piece(buffer, search->line);
+
+    for (; p < buffer->piece_count && buffer->pieces[p].line < end_line && found < max; ++p) {
+        const Piece *piece = &buffer->pieces[p];
+        const TextSource *src = piece_source(buffer, piece);
+        size_t limit = end_line - piece->line < piece->count ? end_line - piece->line : piece->count;
+        size_t i = search->line > piece->line ? search->line - piece->line : 0;
+
+        for (; i < limit && found < max; ++i) {
+            size_t offset = 0;
+            size_t column = 0;
+            if (search->needle_len > 0) {
+                if (find_in_piece(buffer, piece, src->starts[piece->first + i], limit, search->needle,
+                                  search->needle_len, &offset, &column) != 0) {
+                    break;
+                }
+                i = offset;
+            }
+
+            size_t len = 0;
+            const char *text = line_span(buffer, piece, i, &len);
+            int resumed = piece->line + i == search->line;
+            size_t from = resumed ? search->column : 0;
+            int after_match = resumed && search->after_match;
+            size_t start = 0;
+            size_t match_len = 0;
+
+            while (found < max && from <= len && pattern_find(search->pattern, text, len, from, &start, &match_len)) {
+                if (match_len == 0 && after_match && start == from) {
+                    from++; /* an empty match right after a match adds nothing */
+                    after_match = 0;
+                    continue;
+                }
+                after_match = match_len > 0;
+                out[found].line = piece->line + i;
+                out[found].column = start;
+                out[found].length = match_len;
+                found++;
+                from = start + (match_len ? match_len : 1);
+            }
+        }
+    }
+
+    if (found == 0) {
+        search->line = end_line;
+        search->column = 0;
+        search->after_match = 0;
+    } else {
+        search_advance(search, &out[found - 1]);
+    }
+    return found;
+}
+
+/* Matches in lines [search->line, end_line), advancing `search` past them */
+static size_t find_range(const TextBuffer *buffer, BufferSearch *search, size_t end_line,
+                         BufferMatch *out, size_t max)
+{
+    if (search->pattern) {
+        return find_regex_range(buffer, search, end_line, out, max);
+    }
+
+    size_t found = 0;
+    size_t p = find_piece(buffer, search->line);
+
+    for (; p < buffer->piece_count && buffer->pieces[p].line < end_line && found < max; ++p) {
+        const Piece *piece = &buffer->pieces[p];
+        const TextSource *src = piece_source(buffer, piece);
+        size_t limit = end_line - piece->line < piece->count ? end_line - piece->line : piece->count;
+        size_t offset = 0;
+        size_t column = 0;
+
+        /* Resume inside the piece where the previous call stopped */
+        size_t pos = src->starts[piece->first];
+        if (search->line >= piece->line) {
+            pos = src->starts[piece->first + search->line - piece->line] + search->column;
+        }
+
+        while (found < max &&
+               find_in_piece(buffer, piece, pos, limit, search->needle, search->needle_len, &offset, &column) == 0) {
+            out[found].line = piece->line + offset;
+            out[found].column = column;
+            out[found].length = search->needle_len;
+            found++;
+            pos = src->starts[piece->first + offset] + column + search->needle_len;
+        }
+    }
+
+    if (found == 0) {
+        search->line = end_line;
+        search->column = 0;
+        search->after_match = 0;
+    } else {
+        search_advance(search, &out[found - 1]);
+    }
+    return found;
+}
+
+/* Document offset a search resumes from */
+static size_t search_offset(const TextBuffer *buffer, const BufferSearch *search)
+{
+    if (search->line >= buffer->count) {
+        return buffer_size(buffer);
+    }
+    return buffer_line_offset(buffer, search->line) + search->column;
+}
+
+/* Counts the bytes between where a search started and where it stopped */
+static void record_search(const TextBuffer *buffer, const BufferSearch *search, size_t from,
+                          unsigned long long start)
+{
+    if (start != 0) {
+        size_t to = search_offset(buffer, search);
+        stats_record(STATS_SEARCH, to > from ? to - from : 0, start);
+    }
+}
+
+size_t buffer_find_all(const TextBuffer *buffer, BufferSearch *search, BufferMatch *out, size_t max)
+{
+    if (!buffer || !search || !out || max == 0 || search_is_empty(search) || search->line >= buffer->count ||
+        buffer->edit.dirty) {
+        return 0;
+    }
+
+    unsigned long long start = stats_start();
+    size_t from = start ? search_offset(buffer, search) : 0;
+    size_t found = find_range(buffer, search, buffer->count, out, max);
+    record_search(buffer, search, from, start);
+    return found;
+}
+
+typedef struct {
+    BufferMatch *matches;
+    size_t count;
+    size_t capacity;
+    int failed;
+} PartMatches;
+
+typedef struct {
+    const TextBuffer *buffer;
+    const BufferSearch *search;
+    size_t lines_per_part;
+    size_t max;
+    PartMatches *parts;
+    atomic_size_t cutoff;   /* parts after this one cannot contribute */
+} ParallelSearch;
+
+static void search_part(void *context, size_t part)
+{
+    ParallelSearch *job = (ParallelSearch *)context;
+    PartMatches *result = &job->parts[part];
+    BufferMatch batch[SEARCH_BATCH_SIZE];
+
+    BufferSearch search = *job->search;
+    size_t start = job->search->line + part * job->lines_per_part;
+    size_t end = start + job->lines_per_part;
+    if (end > job->buffer->count) {
+        end = job->buffer->count;
+    }
+    if (start >= end) {
+        return;
     }
+    if (part > 0) {
+        search.line = start;
+        search.column = 0;
+        search.after_match = 0;
+    }
+
+    while (result->count < job->max && part <= atomic_load(&job->cutoff)) {
+        size_t want = job->max - result->count < SEARCH_BATCH_SIZE ? job->max - result->count : SEARCH_BATCH_SIZE;
+        size_t found = find_range(job->buffer, &search, end, batch, want);
+
+        if (result->count + found > result->capacity) {
+            size_t capacity = result->capacity ? result->capacity * 2 : SEARCH_BATCH_SIZE;
+            BufferMatch *matches = (BufferMatch *)realloc(result->matches, capacity * sizeof(BufferMatch));
+            if (!matches) {
+                result->failed = 1;
+                return;
+            }
+            result->matches = matches;
+            result->capacity = capacity;
+        }
+        memcpy(result->matches + result->count, batch, found * sizeof(BufferMatch));
+        result->count += found;
+
+        if (found < want) {
+            return; /* range exhausted */
+        }
+    }
+
+    /* This part alone fills the request, so later parts are not needed */
+    size_t cutoff = atomic_load(&job->cutoff);
+    while (result->count >= job->max && part < cutoff &&
+           !atomic_compare_exchange_weak(&job->cutoff, &cutoff, part)) {
+    }
+}
+
+static size_t find_parallel(const TextBuffer *buffer, BufferSearch *search, BufferMatch *out, size_t max,
+                            size_t threads)
+{
+    size_t lines = buffer->count - search->line;
+    size_t parts = threads * SEARCH_PARTS_PER_THREAD;
+    if (parts > lines / SEARCH_MIN_PART_LINES) {
+        parts = lines / SEARCH_MIN_PART_LINES;
+    }
+    if (threads <= 1 || parts <= 1 || search->pattern) {
+        return find_range(buffer, search, buffer->count, out, max);
+    }
+
+    ParallelSearch job;
+    job.buffer = buffer;
+    job.search = search;
+    job.lines_per_part = (lines + parts - 1) / parts;
+    job.max = max;
+    job.parts = (PartMatches *)calloc(parts, sizeof(PartMatches));
+    if (!job.parts) {
+        return find_range(buffer, search, buffer->count, out, max);
+    }
+    atomic_init(&job.cutoff, parts);
+
+    parallel_run(threads, parts, search_part, &job);
+
+    /* Parts cover consecutive line ranges, so concatenating keeps line order */
+    size_t found = 0;
+    int failed = 0;
+    for (size_t part = 0; part < parts; ++part) {
+        PartMatches *result = &job.parts[part];
+        size_t take = result->count < max - found ? result->count : max - found;
+        if (take > 0) {
+            memcpy(out + found, result->matches, take * sizeof(BufferMatch));
+        }
+        found += take;
+        failed |= result->failed;
+        free(result->matches);
+    }
+    free(job.parts);
+
+    if (failed) {
+        return find_range(buffer, search, buffer->count, out, max);
+    }
+
+    if (found == 0) {
+        search->line = buffer->count;
+        search->column = 0;
+        search->after_match = 0;
+    } else {
+        search_advance(search, &out[found - 1]);
+    }
+    return found;
+}
+
+size_t buffer_find_all_parallel(const TextBuffer *buffer, BufferSearch *search, BufferMatch *out, size_t max,
+                                size_t threads)
+{
+    if (!buffer || !search || !out || max == 0 || search_is_empty(search) || search->line >= buffer->count ||
+        buffer->edit.dirty) {
+        return 0;
+    }
+
+    unsigned long long start = stats_start();
+    size_t from = start ? search_offset(buffer, search) : 0;
+    size_t found = find_parallel(buffer, search, out, max, threads);
+    record_search(buffer, search, from, start);
+    return found;
+}
+
+/* New line contents built during a replace-all, packed one after another */
+typedef struct {
+    BufferLineEdit *edits;
+    size_t count;
+    size_t capacity;
+    char *text;
+    size_t text_len;
+    size_t text_capacity;
+} ReplaceScratch;
 
-    for (size_t i = 0; i < buffer->count; ++i) {
-        if (buffer->lines[i] && strstr(buffer->lines[i], needle) != NULL) {
-            return i;
+static int scratch_append(ReplaceScratch *scratch, const char *data, size_t len)
+{
+    void *text = scratch->text;
+    int rc = grow_array(&text, &scratch->text_capacity, scratch->text_len + len, 1);
+    scratch->text = (char *)text;
+    if (rc != 0) {
+        return -1;
+    }
+    if (len > 0) {
+        memcpy(scratch->text + scratch->text_len, data, len);
+    }
+    scratch->text_len += len;
+    scratch->edits[scratch->count - 1].len += len;
+    return 0;
+}
+
+static int scratch_open_line(ReplaceScratch *scratch, size_t line)
+{
+    void *edits = scratch->edits;
+    int rc = grow_array(&edits, &scratch->capacity, scratch->count + 1, sizeof(BufferLineEdit));
+    scratch->edits = (BufferLineEdit *)edits;
+    if (rc != 0) {
+        return -1;
+    }
+    scratch->edits[scratch->count].line = line;
+    scratch->edits[scratch->count].text = NULL;
+    scratch->edits[scratch->count].len = 0;
+    scratch->count++;
+    return 0;
+}
+
+/* Copies the rest of the line being rewritten, from byte `from` on */
+static int scratch_close_line(ReplaceScratch *scratch, const TextBuffer *buffer, size_t from)
+{
+    size_t len = 0;
+    const char *old = buffer_get_line_n(buffer, scratch->edits[scratch->count - 1].line, &len);
+    return scratch_append(scratch, old + from, len - from);
+}
+
+int buffer_replace_all(TextBuffer *buffer, BufferSearch *search, const char *replacement, size_t len,
+                       BufferReplaceFn prepare, void *context, size_t *out_count)
+{
+    /* The search reads the piece table, so pending character edits go in first */
+    if (!buffer || !search || (!replacement && len > 0) || (len > 0 && memchr(replacement, '\n', len)) ||
+        buffer_sync_edit(buffer) != 0) {
+        return -1;
+    }
+
+    ReplaceScratch scratch;
+    memset(&scratch, 0, sizeof(scratch));
+    BufferMatch batch[SEARCH_BATCH_SIZE];
+    size_t replaced = 0;
+    size_t copied = 0;      /* bytes of the current line already rewritten */
+    size_t found;
+    int rc = 0;
+
+    /* One pass; the search resumes after each batch instead of rescanning */
+    while (rc == 0 && (found = buffer_find_all(buffer, search, batch, SEARCH_BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < found && rc == 0; ++i) {
+            const BufferMatch *match = &batch[i];
+            if (scratch.count == 0 || scratch.edits[scratch.count - 1].line != match->line) {
+                if (scratch.count > 0) {
+                    rc = scratch_close_line(&scratch, buffer, copied);
+                }
+                copied = 0;
+                if (rc != 0 || (rc = scratch_open_line(&scratch, match->line)) != 0) {
+                    break;
+                }
+            }
+
+            size_t old_len = 0;
+            const char *old = buffer_get_line_n(buffer, match->line, &old_len);
+            rc = scratch_append(&scratch, old + copied, match->column - copied);
+            if (rc == 0) {
+                rc = scratch_append(&scratch, replacement, len);
+            }
+            copied = match->column + match->length;
+            replaced++;
         }
     }
+    if (rc == 0 && scratch.count > 0) {
+        rc = scratch_close_line(&scratch, buffer, copied);
+    }
+
+    /* The text no longer moves, so the edits can point into it */
+    const char *at = scratch.text ? scratch.text : "";
+    for (size_t e = 0; rc == 0 && e < scratch.count; ++e) {
+        scratch.edits[e].text = at;
+        at += scratch.edits[e].len;
+    }
+
+    if (rc == 0 && prepare && scratch.count > 0) {
+        rc = prepare(context, scratch.edits, scratch.count);
+    }
+    if (rc == 0) {
+        rc = buffer_replace_lines(buffer, scratch.edits, scratch.count);
+    }
+    free(scratch.edits);
+    free(scratch.text);
 
-    return INVALID_INDEX;
+    if (rc != 0) {
+        return -1;
+    }
+    if (out_count) {
+        *out_count = replaced;
+    }
+    return 0;
 }
@@ -3,27 +3,56 @@
  * File: editor.c
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "editor.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "fileio.h"
+#include "history.h"
+#include "parallel.h"
+#include "stats.h"
 #include "util.h"
 
 #define INPUT_BUFFER_SIZE 1024
+#define SEARCH_PAGE_SIZE 20
+#define VIEW_PAGE_LINES 40
+#define VIEW_LINE_BYTES 4096    /* longer lines are cut off in the view */
+#define VIEW_SPANS 64
+
+/* Lines of the document, counting those of a huge file the line cache knows before they are indexed */
+static size_t known_lines(const EditorState *editor)
+{
+    if (editor->index_job.running && editor->line_cache.lines > editor->buffer.count) {
+        return editor->line_cache.lines;
+    }
+    return editor->buffer.count;
+}
 
-static void editor_print_header(const EditorState *editor)
+static void editor_print_header(EditorState *editor)
 {
     printf("\n================ Console Text Editor ================\n");
     printf("File    : %s\n", editor->current_filename[0] ? editor->current_filename : "<unnamed>");
-    printf("Status  : %s\n", editor->is_modified ? "modified" : "saved");
-    printf("Lines   : %zu\n", editor->buffer.count);
+    printf("Status  : %s%s\n", editor->is_modified ? "modified" : "saved",
+           editor->save_job.running ? " (saving in the background)" : "");
+    if (editor->index_job.running && editor->line_cache.lines > 0) {
+        printf("Lines   : %zu (indexing, %u%% of the file)\n", known_lines(editor),
+               file_index_progress(&editor->index_job));
+    } else if (editor->index_job.running) {
+        printf("Lines   : %zu so far (indexing, %u%% of the file)\n", editor->buffer.count,
+               file_index_progress(&editor->index_job));
+    } else {
+        printf("Lines   : %zu (%zu bytes)\n", editor->buffer.count, buffer_size(&editor->buffer));
+    }
     printf("====================================================\n\n");
 }
 
@@ -39,9 +68,28 @@ static void editor_print_menu(void)
     printf(" 7) Save\n");
     printf(" 8) Save As\n");
     printf(" 9) Quit\n");
+    printf("10) Undo\n");
+    printf("11) Redo\n");
+    printf("12) Save in the background\n");
+    printf("13) Show statistics\n");
+    printf("14) Delete lines\n");
+    printf("15) Move lines\n");
+    printf("16) Copy lines\n");
+    printf("17) Paste lines\n");
+    printf("18) Replace all\n");
+    printf("19) Follow file (tail -f)\n");
     printf("----------------------------------------------------\n");
 }
 
+/* Prints a line that may hold NUL bytes, then a newline */
+static void print_text(const char *text, size_t len)
+{
+    if (text) {
+        fwrite(text, 1, len, stdout);
+    }
+    putchar('\n');
+}
+
 static int prompt_for_index(size_t *out_index, const char *label, size_t max_value)
 {
     char input[INPUT_BUFFER_SIZE];
@@ -62,10 +110,247 @@ static int prompt_for_index(size_t *out_index, const char *label, size_t max_val
     return 0;
 }
 
+static int view_append(EditorState *editor, const char *data, size_t len)
+{
+    if (editor->view_capacity - editor->view_len < len) {
+        size_t capacity = editor->view_capacity ? editor->view_capacity : INPUT_BUFFER_SIZE;
+        while (capacity - editor->view_len < len) {
+            capacity *= 2;
+        }
+        char *view = (char *)realloc(editor->view, capacity);
+        if (!view) {
+            return -1;
+        }
+        editor->view = view;
+        editor->view_capacity = capacity;
+    }
+    memcpy(editor->view + editor->view_len, data, len);
+    editor->view_len += len;
+    return 0;
+}
+
+static int view_appendf(EditorState *editor, const char *format, size_t a, size_t b, size_t c)
+{
+    char text[96];
+    int len = snprintf(text, sizeof(text), format, a, b, c);
+    if (len < 0) {
+        return -1;
+    }
+    return view_append(editor, text, (size_t)len < sizeof(text) ? (size_t)len : sizeof(text) - 1);
+}
+
+static int flush_view(const EditorState *editor)
+{
+    fflush(stdout);
+
+    size_t done = 0;
+    while (done < editor->view_len) {
+        ssize_t written = write(STDOUT_FILENO, editor->view + done, editor->view_len - done);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += (size_t)written;
+    }
+    return 0;
+}
+
+/* Renders spans of newline-terminated lines, numbering them from `*number` */
+static int render_spans(EditorState *editor, const BufferSpan *spans, size_t used, size_t *number, size_t *column)
+{
+    int rc = 0;
+    for (size_t i = 0; i < used && rc == 0; ++i) {
+        const char *at = spans[i].data;
+        const char *stop = at + spans[i].len;
+
+        while (at < stop && rc == 0) {
+            if (*column == 0) {
+                rc = view_appendf(editor, "%zu: ", *number + 1, 0, 0);
+            }
+            const char *newline = (const char *)memchr(at, '\n', (size_t)(stop - at));
+            size_t len = (size_t)((newline ? newline : stop) - at);
+            size_t room = *column < VIEW_LINE_BYTES ? VIEW_LINE_BYTES - *column : 0;
+
+            if (rc == 0) {
+                rc = view_append(editor, at, len < room ? len : room);
+            }
+            *column += len;
+            if (!newline) {
+                break;
+            }
+            if (rc == 0 && *column > VIEW_LINE_BYTES) {
+                rc = view_appendf(editor, " [+%zu bytes]", *column - VIEW_LINE_BYTES, 0, 0);
+            }
+            if (rc == 0) {
+                rc = view_append(editor, "\n", 1);
+            }
+            (*number)++;
+            *column = 0;
+            at = newline + 1;
+        }
+    }
+    return rc;
+}
+
+/* Renders the buffer's lines [from, end) after what the view holds */
+static int render_lines(EditorState *editor, size_t from, size_t end)
+{
+    BufferSpan spans[VIEW_SPANS];
+    size_t line = from;
+    size_t number = from;
+    size_t column = 0;
+    size_t used;
+    int rc = 0;
+
+    while (rc == 0 && (used = buffer_get_spans(&editor->buffer, &line, end, spans, VIEW_SPANS)) > 0) {
+        rc = render_spans(editor, spans, used, &number, &column);
+    }
+    return rc;
+}
+
+/*
+ * Renders lines [top, top + VIEW_PAGE_LINES) into one output buffer and
+ * writes it at once. Only the page's lines are read, so the cost does not
+ * depend on the size of the file. Lines of a huge file that are not
+ * indexed yet are read from the file through its line cache.
+ */
+static int render_page(EditorState *editor, size_t top)
+{
+    const TextBuffer *buffer = &editor->buffer;
+    size_t count = known_lines(editor);
+    size_t end = count - top < VIEW_PAGE_LINES ? count : top + VIEW_PAGE_LINES;
+    int rc = 0;
+
+    editor->view_len = 0;
+    if (end > buffer->count) {
+        BufferSpan span;
+        size_t number = top;
+        size_t column = 0;  /* bytes of the current line seen so far */
+        rc = file_line_span(&editor->line_cache, buffer, top, end, &span);
+        if (rc == 0) {
+            rc = render_spans(editor, &span, 1, &number, &column);
+        }
+        if (rc == 0 && column > 0) {
+            /* The file's last line has no terminator of its own */
+            rc = view_append(editor, "\n", 1);
+        }
+    } else {
+        rc = render_lines(editor, top, end);
+    }
+
+    if (rc == 0 && end - top < count) {
+        rc = view_appendf(editor, "-- lines %zu-%zu of %zu --\n", top + 1, end, count);
+    }
+    if (rc != 0 || flush_view(editor) != 0) {
+        printf("Failed to render lines (out of memory?).\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Appends the lines a huge file's indexing thread has found since the last look */
+static void collect_index(EditorState *editor, int wait)
+{
+    if (editor->index_job.running && file_index_collect(&editor->index_job, &editor->buffer, wait) < 0) {
+        printf("Out of memory while indexing: the end of the file is missing and it cannot be saved.\n");
+    }
+}
+
+/* Edits, searches and saves need every line of the file */
+static void finish_index(EditorState *editor)
+{
+    if (editor->index_job.running) {
+        printf("Indexing the rest of the file...\n");
+        collect_index(editor, 1);
+    }
+}
+
+/* Keeps a huge file's resident pages to the budget around the viewed lines */
+static void trim_pages(EditorState *editor)
+{
+    if (editor->huge_file && editor->page_budget > 0) {
+        size_t top = editor->view_top < editor->buffer.count ? editor->view_top : editor->buffer.count;
+        size_t offset = buffer_line_offset(&editor->buffer, top);
+        if (editor->view_top > top) {
+            /* A page not indexed yet was read through the line cache */
+            file_line_locate(&editor->line_cache, &editor->buffer, editor->view_top, &offset);
+        }
+        file_trim_mapping(&editor->buffer, offset, editor->page_budget);
+    }
+}
+
 static void command_view(EditorState *editor)
 {
-    (void)editor; /* unused warning guard if needed */
-    buffer_print(&editor->buffer);
+    size_t count = known_lines(editor);
+    if (count == 0) {
+        printf("[Buffer is empty]\n");
+        return;
+    }
+
+    /* Small buffers are shown whole, larger ones a page at a time */
+    size_t last_top = count > VIEW_PAGE_LINES ? count - VIEW_PAGE_LINES : 0;
+    size_t top = editor->view_top < last_top ? editor->view_top : last_top;
+    if (count <= VIEW_PAGE_LINES) {
+        render_page(editor, 0);
+        return;
+    }
+
+    for (;;) {
+        editor->view_top = top;
+        if (render_page(editor, top) != 0) {
+            return;
+        }
+        trim_pages(editor);
+
+        /* A huge file's document grows while the rest of it is indexed */
+        collect_index(editor, 0);
+        count = known_lines(editor);
+        last_top = count - VIEW_PAGE_LINES;
+        top = top < last_top ? top : last_top;
+
+        char answer[INPUT_BUFFER_SIZE];
+        printf("Enter/n next page, p previous, g N go to line N, o N go to byte N, q back: ");
+        if (read_line(answer, sizeof(answer)) != 0) {
+            return;
+        }
+
+        if (answer[0] == '\0' || answer[0] == 'n' || answer[0] == 'N') {
+            if (top == last_top) {
+                return;
+            }
+            top = last_top - top < VIEW_PAGE_LINES ? last_top : top + VIEW_PAGE_LINES;
+        } else if (answer[0] == 'p' || answer[0] == 'P') {
+            top = top < VIEW_PAGE_LINES ? 0 : top - VIEW_PAGE_LINES;
+        } else if (answer[0] == 'o' || answer[0] == 'O') {
+            char *endptr = NULL;
+            unsigned long long value = strtoull(answer + 1, &endptr, 10);
+            size_t line = endptr == answer + 1 || *endptr != '\0' ? INVALID_INDEX
+                          : buffer_line_at_offset(&editor->buffer, (size_t)value, NULL);
+            if (line == INVALID_INDEX) {
+                printf("Invalid byte offset (the buffer has %zu bytes).\n", buffer_size(&editor->buffer));
+                continue;
+            }
+            top = line < last_top ? line : last_top;
+        } else if (answer[0] == 'g' || answer[0] == 'G' || (answer[0] >= '0' && answer[0] <= '9')) {
+            const char *digits = (answer[0] == 'g' || answer[0] == 'G') ? answer + 1 : answer;
+            char *endptr = NULL;
+            unsigned long value = strtoul(digits, &endptr, 10);
+            if (value > count && editor->index_job.running) {
+                finish_index(editor);
+                count = known_lines(editor);
+                last_top = count - VIEW_PAGE_LINES;
+            }
+            if (endptr == digits || *endptr != '\0' || value == 0 || value > count) {
+                printf("Invalid line number.\n");
+                continue;
+            }
+            top = (size_t)value - 1 < last_top ? (size_t)value - 1 : last_top;
+        } else {
+            return;
+        }
+    }
 }
 
 static void command_insert(EditorState *editor)
@@ -98,7 +383,7 @@ static void command_insert(EditorState *editor)
         return;
     }
 
-    if (buffer_insert_line(&editor->buffer, index, line) != 0) {
+    if (history_insert_line(&editor->history, &editor->buffer, index, line) != 0) {
         printf("Failed to insert line (out of memory?).\n");
         return;
     }
@@ -115,7 +400,7 @@ static void command_append(EditorState *editor)
         return;
     }
 
-    if (buffer_append_line(&editor->buffer, line) != 0) {
+    if (history_insert_line(&editor->history, &editor->buffer, editor->buffer.count, line) != 0) {
         printf("Failed to append line (out of memory?).\n");
         return;
     }
@@ -135,8 +420,10 @@ static void command_edit(EditorState *editor)
         return;
     }
 
-    const char *old_line = buffer_get_line(&editor->buffer, index);
-    printf("Current text: %s\n", old_line ? old_line : "");
+    size_t old_len = 0;
+    const char *old_line = buffer_get_line_n(&editor->buffer, index, &old_len);
+    printf("Current text: ");
+    print_text(old_line, old_len);
 
     char line[INPUT_BUFFER_SIZE];
     printf("Enter new text: ");
@@ -144,7 +431,7 @@ static void command_edit(EditorState *editor)
         return;
     }
 
-    if (buffer_replace_line(&editor->buffer, index, line) != 0) {
+    if (history_replace_line(&editor->history, &editor->buffer, index, line) != 0) {
         printf("Failed to replace line (out of memory?).\n");
         return;
     }
@@ -164,7 +451,7 @@ static void command_delete(EditorState *editor)
         return;
     }
 
-    if (buffer_delete_line(&editor->buffer, index) != 0) {
+    if (history_delete_line(&editor->history, &editor->buffer, index) != 0) {
         printf("Failed to delete line.\n");
         return;
     }
@@ -172,43 +459,394 @@ static void command_delete(EditorState *editor)
     editor->is_modified = 1;
 }
 
-static void command_search(EditorState *editor)
+/* Asks for the first and last line of a block; stores it 0-based */
+static int prompt_for_block(const EditorState *editor, size_t *index, size_t *count)
 {
-    (void)editor;
+    size_t last = 0;
+    if (prompt_for_index(index, "Enter first line", editor->buffer.count) != 0 ||
+        prompt_for_index(&last, "Enter last line", editor->buffer.count) != 0) {
+        return -1;
+    }
+    if (last < *index) {
+        printf("Last line comes before the first.\n");
+        return -1;
+    }
+    *count = last - *index + 1;
+    return 0;
+}
 
-    char query[INPUT_BUFFER_SIZE];
+static void command_delete_lines(EditorState *editor)
+{
+    if (editor->buffer.count == 0) {
+        printf("Buffer is empty. Nothing to delete.\n");
+        return;
+    }
+
+    size_t index = 0;
+    size_t count = 0;
+    if (prompt_for_block(editor, &index, &count) != 0) {
+        return;
+    }
+
+    if (history_delete_lines(&editor->history, &editor->buffer, index, count) != 0) {
+        printf("Failed to delete lines (out of memory?).\n");
+        return;
+    }
+
+    printf("Deleted %zu line(s).\n", count);
+    editor->is_modified = 1;
+}
+
+/* Moves a block before another line, or copies it there when `copy` is set */
+static void command_move_lines(EditorState *editor, int copy)
+{
+    if (editor->buffer.count == 0) {
+        printf("Buffer is empty. Nothing to %s.\n", copy ? "copy" : "move");
+        return;
+    }
+
+    size_t index = 0;
+    size_t count = 0;
+    size_t before = 0;
+    if (prompt_for_block(editor, &index, &count) != 0 ||
+        prompt_for_index(&before, "Put the lines before line", editor->buffer.count + 1) != 0) {
+        return;
+    }
+
+    int rc;
+    if (copy) {
+        rc = history_copy_lines(&editor->history, &editor->buffer, index, count, before);
+    } else if (before > index && before < index + count) {
+        printf("Cannot move lines into themselves.\n");
+        return;
+    } else {
+        size_t dest = before <= index ? before : before - count;
+        rc = history_move_lines(&editor->history, &editor->buffer, index, count, dest);
+    }
+    if (rc != 0) {
+        printf("Failed to %s lines (out of memory?).\n", copy ? "copy" : "move");
+        return;
+    }
+
+    editor->is_modified = 1;
+}
 
-    printf("Enter search text: ");
-    if (read_line(query, sizeof(query)) != 0) {
+static void command_paste_lines(EditorState *editor)
+{
+    size_t index = 0;
+    if (prompt_for_index(&index, "Enter position to insert at", editor->buffer.count + 1) != 0) {
         return;
     }
 
+    char line[INPUT_BUFFER_SIZE];
+    char *text = NULL;
+    size_t len = 0;
+    size_t capacity = 0;
+    size_t lines = 0;
+
+    printf("Enter lines, then a line with a single '.':\n");
+    while (read_line(line, sizeof(line)) == 0 && strcmp(line, ".") != 0) {
+        size_t line_len = strlen(line);
+        if (capacity - len < line_len + 1) {
+            size_t grown = capacity ? capacity : sizeof(line);
+            while (grown - len < line_len + 1) {
+                grown *= 2;
+            }
+            char *bigger = (char *)realloc(text, grown);
+            if (!bigger) {
+                printf("Out of memory.\n");
+                free(text);
+                return;
+            }
+            text = bigger;
+            capacity = grown;
+        }
+        if (lines > 0) {
+            text[len++] = '\n';
+        }
+        memcpy(text + len, line, line_len);
+        len += line_len;
+        lines++;
+    }
+
+    if (lines == 0) {
+        printf("Nothing to insert.\n");
+    } else if (history_insert_lines(&editor->history, &editor->buffer, index, text, len) != 0) {
+        printf("Failed to insert lines (out of memory?).\n");
+    } else {
+        printf("Inserted %zu line(s).\n", lines);
+        editor->is_modified = 1;
+    }
+    free(text);
+}
+
+/*
+ * Reads a search query, with /regex/ for a pattern, into `search`. The
+ * pattern comes from the cache, held until the caller's
+ * pattern_cache_release, so repeating a search does not compile it again.
+ */
+static int prompt_for_search(BufferSearch *search, char *query, size_t size)
+{
+    printf("Enter search text (/regex/ for a pattern): ");
+    if (read_line(query, size) != 0) {
+        return -1;
+    }
+
     if (query[0] == '\0') {
         printf("Empty search string.\n");
+        return -1;
+    }
+
+    size_t query_len = strlen(query);
+    if (query_len >= 2 && query[0] == '/' && query[query_len - 1] == '/') {
+        const char *error = NULL;
+        query[query_len - 1] = '\0';
+        Pattern *pattern = pattern_cache_get(query + 1, &error);
+        if (!pattern) {
+            printf("Invalid pattern: %s.\n", error);
+            return -1;
+        }
+        buffer_search_init_regex(search, pattern);
+    } else {
+        buffer_search_init(search, query);
+    }
+    return 0;
+}
+
+static void command_search(EditorState *editor)
+{
+    char query[INPUT_BUFFER_SIZE];
+    BufferSearch search;
+    BufferMatch matches[SEARCH_PAGE_SIZE];
+    size_t total = 0;
+
+    if (prompt_for_search(&search, query, sizeof(query)) != 0) {
         return;
     }
 
-    size_t index = buffer_find(&editor->buffer, query);
-    if (index == INVALID_INDEX) {
-        printf("No match found for '%s'.\n", query);
+    for (;;) {
+        size_t found = buffer_find_all_parallel(&editor->buffer, &search, matches, SEARCH_PAGE_SIZE,
+                                                editor->search_threads);
+        for (size_t i = 0; i < found; ++i) {
+            size_t len = 0;
+            const char *line = buffer_get_line_n(&editor->buffer, matches[i].line, &len);
+            printf("%zu:%zu: ", matches[i].line + 1, matches[i].column + 1);
+            print_text(line, len);
+        }
+        total += found;
+
+        if (found < SEARCH_PAGE_SIZE) {
+            break;
+        }
+
+        /* Paging resumes the search where it stopped instead of rescanning */
+        char answer[INPUT_BUFFER_SIZE];
+        printf("-- more matches; Enter to continue, q to stop: ");
+        if (read_line(answer, sizeof(answer)) != 0 || answer[0] == 'q' || answer[0] == 'Q') {
+            printf("Search stopped after %zu matches.\n", total);
+            pattern_cache_release(search.pattern);
+            return;
+        }
+    }
+
+    if (total == 0) {
+        printf("No match found for '%s'.\n", search.pattern ? pattern_source(search.pattern) : query);
     } else {
-        const char *line = buffer_get_line(&editor->buffer, index);
-        printf("First match at line %zu: %s\n", index + 1, line ? line : "");
+        printf("%zu match%s found.\n", total, total == 1 ? "" : "es");
     }
+    pattern_cache_release(search.pattern);
+}
+
+static void command_replace_all(EditorState *editor)
+{
+    char query[INPUT_BUFFER_SIZE];
+    char replacement[INPUT_BUFFER_SIZE];
+    BufferSearch search;
+
+    if (prompt_for_search(&search, query, sizeof(query)) != 0) {
+        return;
+    }
+    printf("Replace with: ");
+    if (read_line(replacement, sizeof(replacement)) != 0) {
+        pattern_cache_release(search.pattern);
+        return;
+    }
+
+    size_t replaced = 0;
+    int rc = history_replace_all(&editor->history, &editor->buffer, &search, replacement, strlen(replacement),
+                                 &replaced);
+    if (rc != 0) {
+        printf("Failed to replace (out of memory?).\n");
+    } else if (replaced == 0) {
+        printf("No match found for '%s'.\n", search.pattern ? pattern_source(search.pattern) : query);
+    } else {
+        printf("Replaced %zu match%s.\n", replaced, replaced == 1 ? "" : "es");
+        editor->is_modified = 1;
+    }
+    pattern_cache_release(search.pattern);
+}
+
+static void report_history(const EditorState *editor)
+{
+    HistoryStats stats;
+    history_stats(&editor->history, &stats);
+
+    size_t bytes = stats.op_bytes + stats.payload_bytes;
+    printf("History: %zu undo / %zu redo steps, %zu ops, %zu bytes (%.1f bytes/op, limit %zu).\n",
+           stats.undo_steps, stats.redo_steps, stats.ops, bytes,
+           stats.ops ? (double)bytes / (double)stats.ops : 0.0, stats.limit);
+}
+
+static void command_stats(const EditorState *editor)
+{
+    BufferMemoryStats memory;
+    buffer_memory_stats(&editor->buffer, &memory);
+
+    size_t used = memory.index_used + memory.pieces_used + memory.arena_used;
+    size_t allocated = memory.index_capacity + memory.pieces_capacity + memory.arena_capacity + memory.other_bytes;
+    printf("Buffer : %zu bytes of text, %zu from the file\n", memory.document_bytes, memory.original_bytes);
+    printf("Memory : %zu bytes used of %zu allocated (lines %zu/%zu, pieces %zu/%zu, added text %zu/%zu)\n",
+           used, allocated, memory.index_used, memory.index_capacity, memory.pieces_used, memory.pieces_capacity,
+           memory.arena_used, memory.arena_capacity);
+    report_history(editor);
+    stats_dump(stdout);
+
+    /* Collection is off unless asked for, so loads, saves and searches skip the timing */
+    char answer[INPUT_BUFFER_SIZE];
+    int enabled = stats_enabled();
+    printf("Statistics collection is %s. Turn it %s? (y/n): ", enabled ? "on" : "off", enabled ? "off" : "on");
+    if (read_line(answer, sizeof(answer)) == 0 && (answer[0] == 'y' || answer[0] == 'Y')) {
+        stats_set_enabled(!enabled);
+    }
+}
+
+static void command_undo(EditorState *editor)
+{
+    int rc = history_undo(&editor->history, &editor->buffer);
+    if (rc < 0) {
+        printf("Undo failed (out of memory?).\n");
+        return;
+    }
+    if (rc == 0) {
+        printf("Nothing to undo.\n");
+        return;
+    }
+    editor->is_modified = 1;
+    report_history(editor);
+}
+
+static void command_redo(EditorState *editor)
+{
+    int rc = history_redo(&editor->history, &editor->buffer);
+    if (rc < 0) {
+        printf("Redo failed (out of memory?).\n");
+        return;
+    }
+    if (rc == 0) {
+        printf("Nothing to redo.\n");
+        return;
+    }
+    editor->is_modified = 1;
+    report_history(editor);
+}
+
+/* Reports a finished background save; with `wait`, waits for a running one */
+static void collect_background_save(EditorState *editor, int wait)
+{
+    if (wait && editor->save_job.running) {
+        printf("Waiting for the background save to finish...\n");
+    }
+    if (file_save_finish(&editor->save_job, &editor->buffer, wait) != 1) {
+        return;
+    }
+
+    if (editor->save_job.result == 0) {
+        printf("Background save to '%s' finished.\n", editor->current_filename);
+        /* The file is no longer the original the buffer maps */
+        editor->stamp.valid = 0;
+    } else {
+        printf("Background save to '%s' failed: %s.\n", editor->current_filename,
+               strerror(editor->save_job.error));
+        editor->is_modified = 1;
+    }
+}
+
+static void command_save_background(EditorState *editor)
+{
+    char filename[INPUT_BUFFER_SIZE];
+    const char *target = editor->current_filename;
+
+    if (editor->save_job.running) {
+        printf("A background save is already running.\n");
+        return;
+    }
+    if (target[0] == '\0') {
+        printf("Enter filename to save as: ");
+        if (read_line(filename, sizeof(filename)) != 0 || filename[0] == '\0') {
+            printf("Save cancelled.\n");
+            return;
+        }
+        target = filename;
+    }
+    if (strlen(target) >= EDITOR_FILENAME_MAX) {
+        printf("File name is too long (at most %d bytes).\n", EDITOR_FILENAME_MAX - 1);
+        return;
+    }
+
+    /* The save writes a snapshot; edits made meanwhile are not part of it */
+    if (file_save_start(&editor->save_job, target, &editor->buffer) != 0) {
+        printf("Failed to start saving '%s'.\n", target);
+        return;
+    }
+    if (target != editor->current_filename) {
+        memcpy(editor->current_filename, target, strlen(target) + 1);
+    }
+    editor->is_modified = 0;
+    printf("Saving to '%s' in the background.\n", editor->current_filename);
+}
+
+/* Writes a temp file renamed over the target unless in-place saves were asked for */
+static int save_file(EditorState *editor, const char *filename, FileStamp *stamp, FileSaveResult *result)
+{
+    if (editor->save_in_place) {
+        return file_save_incremental(filename, &editor->buffer, stamp, result);
+    }
+    return file_save_full(filename, &editor->buffer, stamp, result);
 }
 
 static int perform_save(EditorState *editor, const char *filename)
 {
-    if (file_save(filename, &editor->buffer) != 0) {
+    size_t name_len = strlen(filename);
+    if (name_len >= EDITOR_FILENAME_MAX) {
+        printf("File name is too long (at most %d bytes).\n", EDITOR_FILENAME_MAX - 1);
+        return -1;
+    }
+
+    /* An in-place save rebases the buffer the background save reads */
+    collect_background_save(editor, 1);
+
+    /* Only the file the buffer was loaded from can be patched in place */
+    FileStamp stamp = editor->stamp;
+    if (strcmp(filename, editor->current_filename) != 0) {
+        stamp.valid = 0;
+    }
+
+    FileSaveResult result;
+    if (save_file(editor, filename, &stamp, &result) != 0) {
         printf("Failed to save file '%s'.\n", filename);
+        editor->stamp.valid = 0;
         return -1;
     }
 
-    strncpy(editor->current_filename, filename, EDITOR_FILENAME_MAX - 1);
-    editor->current_filename[EDITOR_FILENAME_MAX - 1] = '\0';
+    memmove(editor->current_filename, filename, name_len + 1);
     editor->is_modified = 0;
+    editor->stamp = stamp;
 
-    printf("Saved to '%s'.\n", editor->current_filename);
+    printf("Saved to '%s' (%s, %zu bytes written).\n", editor->current_filename,
+           file_save_mode_name(result.mode), result.bytes_written);
+    if (!result.rebased) {
+        printf("The buffer could not switch to the saved file; the next save writes it whole.\n");
+    }
     return 0;
 }
 
@@ -241,6 +879,83 @@ static void command_save_as(EditorState *editor)
     perform_save(editor, filename);
 }
 
+/* Shows the buffer's last complete lines from `from` on, with at most a page of them */
+static int show_tail(EditorState *editor, size_t from, size_t end)
+{
+    if (end - from > VIEW_PAGE_LINES) {
+        from = end - VIEW_PAGE_LINES;
+    }
+    editor->view_len = 0;
+    if (render_lines(editor, from, end) != 0 || flush_view(editor) != 0) {
+        printf("Failed to render lines (out of memory?).\n");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Follows the file as it grows, like `tail -f`: bytes appended to it are
+ * read and added to the buffer as they arrive, and each completed line is
+ * printed. A truncated or replaced (rotated) file is loaded anew. Enter
+ * stops following. The undo history is dropped, since appended lines do
+ * not go through it and older steps would no longer line up.
+ */
+static void command_follow(EditorState *editor)
+{
+    if (editor->current_filename[0] == '\0') {
+        printf("The buffer has no file to follow.\n");
+        return;
+    }
+    if (editor->is_modified) {
+        printf("Save the buffer before following the file.\n");
+        return;
+    }
+
+    /* A running save would be read back as appended bytes */
+    collect_background_save(editor, 1);
+
+    FileFollow follow;
+    FileFollowEvent event;
+    if (file_follow_start(&follow, editor->current_filename, &editor->buffer, &editor->stamp, &event) != 0) {
+        printf("Cannot follow '%s' (not a regular file?).\n", editor->current_filename);
+        return;
+    }
+    history_clear(&editor->history);
+    printf("Following '%s'; press Enter to stop.\n", editor->current_filename);
+
+    size_t shown = 0;
+    for (;;) {
+        if (event == FILE_FOLLOW_TRUNCATED || event == FILE_FOLLOW_REPLACED) {
+            file_line_index_free(&editor->line_cache);
+            file_line_index_init(&editor->line_cache);
+            editor->huge_file = 0;
+            editor->view_top = 0;
+            printf("-- '%s' was %s; loaded it anew --\n", editor->current_filename,
+                   event == FILE_FOLLOW_TRUNCATED ? "truncated" : "replaced");
+            shown = 0;
+        }
+
+        /* The last line is printed once its newline arrives */
+        size_t complete = editor->buffer.count - (follow.open_tail ? 1 : 0);
+        if (complete > shown && show_tail(editor, shown, complete) != 0) {
+            break;
+        }
+        shown = complete > shown ? complete : shown;
+
+        int input = file_follow_wait(&follow, STDIN_FILENO, FILE_FOLLOW_POLL_MS);
+        if (input > 0) {
+            char answer[INPUT_BUFFER_SIZE];
+            read_line(answer, sizeof(answer));
+            break;
+        }
+        if (input < 0 || file_follow_update(&follow, &editor->buffer, &editor->stamp, &event) != 0) {
+            printf("Failed to read '%s'; stopped following.\n", editor->current_filename);
+            break;
+        }
+    }
+    file_follow_stop(&follow);
+}
+
 static int confirm_discard_changes(void)
 {
     char input[INPUT_BUFFER_SIZE];
@@ -254,6 +969,11 @@ static int confirm_discard_changes(void)
 }
 
 void editor_init(EditorState *editor, const char *filename)
+{
+    editor_init_with(editor, filename, 0);
+}
+
+void editor_init_with(EditorState *editor, const char *filename, int quiet)
 {
     if (!editor) {
         return;
@@ -262,16 +982,43 @@ void editor_init(EditorState *editor, const char *filename)
     buffer_init(&editor->buffer);
     editor->current_filename[0] = '\0';
     editor->is_modified = 0;
+    editor->save_in_place = 0;
+    editor->search_threads = parallel_default_threads();
+    editor->stamp.valid = 0;
+    history_init(&editor->history);
+    file_save_job_init(&editor->save_job);
+    file_index_job_init(&editor->index_job);
+    file_line_index_init(&editor->line_cache);
+    editor->huge_file = 0;
+    editor->page_budget = EDITOR_PAGE_BUDGET;
+    editor->view_top = 0;
+    editor->view = NULL;
+    editor->view_len = 0;
+    editor->view_capacity = 0;
 
-    if (filename && filename[0] != '\0') {
-        if (file_load(filename, &editor->buffer) == 0) {
-            printf("Opened existing file '%s'.\n", filename);
+    if (filename && strlen(filename) >= EDITOR_FILENAME_MAX) {
+        printf("File name is too long (at most %d bytes); starting new unnamed buffer.\n", EDITOR_FILENAME_MAX - 1);
+    } else if (filename && filename[0] != '\0') {
+        FileLoadOptions options;
+        file_load_options_init(&options);
+        options.stamp = &editor->stamp;
+        options.threads = editor->search_threads;
+        options.index = &editor->index_job;
+        options.line_cache = &editor->line_cache;
+        if (file_load_with(filename, &editor->buffer, &options) == 0) {
+            editor->huge_file = editor->index_job.running;
+            if (!quiet) {
+                printf("Opened existing file '%s'%s.\n", filename,
+                       editor->huge_file ? " in huge-file mode (indexing in the background)" : "");
+            }
         } else {
-            printf("Starting new file '%s'.\n", filename);
+            editor->stamp.valid = 0;
+            if (!quiet) {
+                printf("Starting new file '%s'.\n", filename);
+            }
         }
-        strncpy(editor->current_filename, filename, EDITOR_FILENAME_MAX - 1);
-        editor->current_filename[EDITOR_FILENAME_MAX - 1] = '\0';
-    } else {
+        memcpy(editor->current_filename, filename, strlen(filename) + 1);
+    } else if (!quiet) {
         printf("Starting new unnamed buffer.\n");
     }
 }
@@ -285,6 +1032,13 @@ void editor_run(EditorState *editor)
     char input[INPUT_BUFFER_SIZE];
 
     for (;;) {
+        collect_background_save(editor, 0);
+        collect_index(editor, 0);
+        trim_pages(editor);
+        if (file_mapping_truncated()) {
+            printf("Warning: another program cut '%s' short; lines past its new end read as NUL bytes.\n",
+                   editor->current_filename);
+        }
         editor_print_header(editor);
         editor_print_menu();
 
@@ -299,6 +1053,9 @@ void editor_run(EditorState *editor)
         }
 
         int choice = atoi(input);
+        if (choice != 1 && choice != 9 && choice != 13) {
+            finish_index(editor);
+        }
 
         switch (choice) {
         case 1:
@@ -326,6 +1083,7 @@ void editor_run(EditorState *editor)
             command_save_as(editor);
             break;
         case 9:
+            collect_background_save(editor, 1);
             if (editor->is_modified) {
                 if (!confirm_discard_changes()) {
                     printf("Quit cancelled.\n");
@@ -334,6 +1092,36 @@ void editor_run(EditorState *editor)
             }
             printf("Goodbye.\n");
             return;
+        case 10:
+            command_undo(editor);
+            break;
+        case 11:
+            command_redo(editor);
+            break;
+        case 12:
+            command_save_background(editor);
+            break;
+        case 13:
+            command_stats(editor);
+            break;
+        case 14:
+            command_delete_lines(editor);
+            break;
+        case 15:
+            command_move_lines(editor, 0);
+            break;
+        case 16:
+            command_move_lines(editor, 1);
+            break;
+        case 17:
+            command_paste_lines(editor);
+            break;
+        case 18:
+            command_replace_all(editor);
+            break;
+        case 19:
+            command_follow(editor);
+            break;
         default:
             printf("Unknown command: %d\n", choice);
             break;
@@ -341,11 +1129,208 @@ void editor_run(EditorState *editor)
     }
 }
 
+/* Parses a 1-based line number from `*text` and steps past it */
+static int parse_script_line(const char **text, size_t *out)
+{
+    const char *at = *text;
+    size_t value = 0;
+
+    if (*at < '0' || *at > '9') {
+        return -1;
+    }
+    while (*at >= '0' && *at <= '9') {
+        size_t digit = (size_t)(*at - '0');
+        if (value > ((size_t)-1 - digit) / 10) {
+            return -1;
+        }
+        value = value * 10 + digit;
+        at++;
+    }
+    if (value == 0 || (*at != '\0' && *at != ' ')) {
+        return -1;
+    }
+
+    *out = value;
+    *text = *at == ' ' ? at + 1 : at;
+    return 0;
+}
+
+/* Parses "FIRST LAST" into a 0-based block within the buffer */
+static int parse_script_block(const TextBuffer *buffer, const char **text, size_t *index, size_t *count)
+{
+    size_t first = 0;
+    size_t last = 0;
+    if (parse_script_line(text, &first) != 0 || parse_script_line(text, &last) != 0 ||
+        last < first || last > buffer->count) {
+        return -1;
+    }
+    *index = first - 1;
+    *count = last - first + 1;
+    return 0;
+}
+
+/* Runs one script command; returns NULL or the reason it failed */
+static const char *run_script_command(EditorState *editor, const char *command, size_t len)
+{
+    TextBuffer *buffer = &editor->buffer;
+    const char *end = command + len;
+    char op = command[0];
+    const char *arg = command + 1;
+    size_t line = 0;
+    size_t count = 0;
+
+    if (arg < end && *arg == ' ') {
+        arg++;
+    } else if (arg < end) {
+        return "unknown command";
+    }
+
+    switch (op) {
+    case 'a':
+        if (buffer_append_line_n(buffer, arg, (size_t)(end - arg)) != 0) {
+            return "out of memory";
+        }
+        break;
+    case 'i':
+        if (parse_script_line(&arg, &line) != 0 || line > buffer->count + 1) {
+            return "bad line number";
+        }
+        if (buffer_insert_line_n(buffer, line - 1, arg, (size_t)(end - arg)) != 0) {
+            return "out of memory";
+        }
+        break;
+    case 'r':
+        if (parse_script_line(&arg, &line) != 0 || line > buffer->count) {
+            return "bad line number";
+        }
+        if (buffer_replace_line_n(buffer, line - 1, arg, (size_t)(end - arg)) != 0) {
+            return "out of memory";
+        }
+        break;
+    case 'd':
+        if (parse_script_line(&arg, &line) != 0 || line > buffer->count || arg != end) {
+            return "bad line number";
+        }
+        if (buffer_delete_line(buffer, line - 1) != 0) {
+            return "out of memory";
+        }
+        break;
+    case 'D':
+        if (parse_script_block(buffer, &arg, &line, &count) != 0 || arg != end) {
+            return "bad line range";
+        }
+        if (buffer_delete_lines(buffer, line, count) != 0) {
+            return "out of memory";
+        }
+        break;
+    case 'm':
+    case 'c': {
+        size_t before = 0;
+        if (parse_script_block(buffer, &arg, &line, &count) != 0 || parse_script_line(&arg, &before) != 0 ||
+            arg != end || before > buffer->count + 1) {
+            return "bad line range";
+        }
+        before--;
+        if (op == 'c') {
+            if (buffer_copy_lines(buffer, line, count, before) != 0) {
+                return "out of memory";
+            }
+            break;
+        }
+        if (before > line && before < line + count) {
+            return "cannot move lines into themselves";
+        }
+        if (buffer_move_lines(buffer, line, count, before <= line ? before : before - count) != 0) {
+            return "out of memory";
+        }
+        break;
+    }
+    case 'w': {
+        const char *filename = arg < end ? arg : editor->current_filename;
+        if (!filename[0]) {
+            return "no file name to save to";
+        }
+        if (filename == arg && strlen(arg) != (size_t)(end - arg)) {
+            return "bad file name";
+        }
+        if (strlen(filename) >= EDITOR_FILENAME_MAX) {
+            return "file name too long";
+        }
+
+        collect_background_save(editor, 1);
+        FileStamp stamp = editor->stamp;
+        if (strcmp(filename, editor->current_filename) != 0) {
+            stamp.valid = 0;
+        }
+        FileSaveResult result;
+        if (save_file(editor, filename, &stamp, &result) != 0) {
+            editor->stamp.valid = 0;
+            return "save failed";
+        }
+        memmove(editor->current_filename, filename, strlen(filename) + 1);
+        editor->stamp = stamp;
+        editor->is_modified = 0;
+        return NULL;
+    }
+    default:
+        return "unknown command";
+    }
+
+    editor->is_modified = 1;
+    return NULL;
+}
+
+int editor_run_script(EditorState *editor, FILE *script, EditorScriptResult *result)
+{
+    LineReader reader;
+    char *command = NULL;
+    size_t len = 0;
+    int rc;
+
+    if (!editor || !script || !result) {
+        return -1;
+    }
+    memset(result, 0, sizeof(*result));
+    if (editor->index_job.running && file_index_collect(&editor->index_job, &editor->buffer, 1) < 0) {
+        result->error = "out of memory while indexing the file";
+        return -1;
+    }
+    if (line_reader_init(&reader, script) != 0) {
+        result->error = "out of memory";
+        return -1;
+    }
+
+    while ((rc = line_reader_next(&reader, &command, &len)) == 0) {
+        result->line++;
+        if (len == 0 || command[0] == '#') {
+            continue;
+        }
+        result->error = run_script_command(editor, command, len);
+        if (result->error) {
+            break;
+        }
+        result->commands++;
+    }
+
+    line_reader_free(&reader);
+    if (rc < 0) {
+        result->error = "read error";
+    }
+    return result->error ? -1 : 0;
+}
+
 void editor_free(EditorState *editor)
 {
     if (!editor) {
         return;
     }
 
+    collect_background_save(editor, 1);
+    file_index_cancel(&editor->index_job);
+    file_line_index_free(&editor->line_cache);
     buffer_free(&editor->buffer);
+    history_free(&editor->history);
+    free(editor->view);
+    editor->view = NULL;
+    pattern_cache_clear();
 }
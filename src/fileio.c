@@ -3,74 +3,1821 @@
  * File: fileio.c
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE     /* madvise, MAP_ANONYMOUS */
+
 #include "fileio.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
 
-#define LINE_BUFFER_SIZE 1024
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
-int file_load(const char *filename, TextBuffer *buffer)
+#include "parallel.h"
+#include "search.h"
+#include "stats.h"
+#include "util.h"
+
+/* Spans per writev call; well under IOV_MAX on every supported system */
+#define SAVE_BATCH_SPANS 1024
+
+/* Chunk size for rewriting the tail of a file in place */
+#define SAVE_BOUNCE_SIZE (1024 * 1024)
+
+/* Mapped originals watched for being cut short; more are mapped unwatched */
+#define MAP_GUARD_SLOTS 16
+
+static int write_all(int fd, struct iovec *iov, int count);
+static mode_t target_mode(const char *filename);
+
+void file_load_options_init(FileLoadOptions *options)
 {
-    if (!filename || !buffer) {
-        return -1;
+    if (!options) {
+        return;
     }
+    options->map = FILE_MAP_AUTO;
+    options->stamp = NULL;
+    options->threads = 0;
+    options->index = NULL;
+    options->lazy_threshold = FILE_LAZY_THRESHOLD;
+    options->line_cache = NULL;
+    options->line_cache_min = FILE_LINE_CACHE_MIN;
+}
 
-    FILE *fp = fopen(filename, "r");
-    if (!fp) {
-        /* Treat as non-fatal: caller may want to start with an empty buffer */
-        return -1;
+static void stamp_from(FileStamp *stamp, const struct stat *st)
+{
+    stamp->valid = 1;
+    stamp->device = (unsigned long long)st->st_dev;
+    stamp->inode = (unsigned long long)st->st_ino;
+    stamp->size = (long long)st->st_size;
+    stamp->mtime_sec = (long long)st->st_mtim.tv_sec;
+    stamp->mtime_nsec = (long)st->st_mtim.tv_nsec;
+}
+
+static int stamp_matches(const FileStamp *stamp, const struct stat *st)
+{
+    FileStamp now;
+    stamp_from(&now, st);
+    return stamp->valid && S_ISREG(st->st_mode) && stamp->device == now.device && stamp->inode == now.inode &&
+           stamp->size == now.size && stamp->mtime_sec == now.mtime_sec && stamp->mtime_nsec == now.mtime_nsec;
+}
+
+static void release_file_data(void *data, size_t size)
+{
+    (void)size;
+    free(data);
+}
+
+/*
+ * A MAP_PRIVATE mapping still reads the file for pages it has not copied,
+ * so touching one past the end of a file another process has cut short
+ * raises SIGBUS. The handler maps a page of zeros over the faulting page of
+ * a watched original instead: the lost lines read as NUL bytes and
+ * file_mapping_truncated reports it. Faults anywhere else go to whatever
+ * handled SIGBUS before.
+ */
+typedef struct {
+    char *volatile start;
+    volatile size_t len;
+} MapGuard;
+
+static MapGuard map_guards[MAP_GUARD_SLOTS];
+static pthread_mutex_t map_guard_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t map_guard_once = PTHREAD_ONCE_INIT;
+static struct sigaction map_guard_previous;
+static uintptr_t map_guard_page;
+static volatile sig_atomic_t map_truncated;
+
+static void on_sigbus(int sig, siginfo_t *info, void *context)
+{
+    (void)sig;
+    (void)context;
+    char *addr = (char *)info->si_addr;
+    for (size_t i = 0; i < MAP_GUARD_SLOTS; ++i) {
+        char *start = map_guards[i].start;
+        if (start && addr >= start && addr < start + map_guards[i].len) {
+            void *page = (void *)((uintptr_t)addr & ~(map_guard_page - 1));
+            if (mmap(page, (size_t)map_guard_page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) !=
+                MAP_FAILED) {
+                map_truncated = 1;
+                return; /* the access runs again and reads zeros */
+            }
+        }
+    }
+    sigaction(SIGBUS, &map_guard_previous, NULL);
+}
+
+static void install_map_guard(void)
+{
+    map_guard_page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_sigbus;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGBUS, &action, &map_guard_previous);
+}
+
+/* Maps `size` bytes of `fd` read-only and watches them; MAP_FAILED on failure */
+static void *map_file(int fd, size_t size)
+{
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return map;
+    }
+
+    pthread_once(&map_guard_once, install_map_guard);
+    pthread_mutex_lock(&map_guard_lock);
+    for (size_t i = 0; i < MAP_GUARD_SLOTS; ++i) {
+        if (!map_guards[i].start) {
+            /* The length first: the handler trusts a slot once it has a start */
+            map_guards[i].len = size;
+            map_guards[i].start = (char *)map;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&map_guard_lock);
+    return map;
+}
+
+static void release_mapping(void *data, size_t size)
+{
+    pthread_mutex_lock(&map_guard_lock);
+    for (size_t i = 0; i < MAP_GUARD_SLOTS; ++i) {
+        if (map_guards[i].start == (char *)data) {
+            map_guards[i].start = NULL;
+        }
+    }
+    pthread_mutex_unlock(&map_guard_lock);
+    munmap(data, size);
+}
+
+int file_mapping_truncated(void)
+{
+    int truncated = map_truncated;
+    map_truncated = 0;
+    return truncated;
+}
+
+static int read_fully(int fd, char *data, size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = read(fd, data + done, size - done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
     }
+    return 0;
+}
 
+/* Line-by-line load for streams that cannot be sized up front */
+static int load_stream(FILE *fp, TextBuffer *buffer)
+{
     buffer_free(buffer);
     buffer_init(buffer);
 
-    char line[LINE_BUFFER_SIZE];
+    LineReader reader;
+    if (line_reader_init(&reader, fp) != 0) {
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t len = 0;
+    int rc = 0;
 
-    while (fgets(line, sizeof(line), fp) != NULL) {
-        /* Strip trailing newlines */
-        size_t len = strlen(line);
-        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
-            line[--len] = '\0';
+    while ((rc = line_reader_next(&reader, &line, &len)) == 0) {
+        if (buffer_append_line_n(buffer, line, len) != 0) {
+            rc = -1;
+            break;
         }
+    }
+
+    line_reader_free(&reader);
+    return rc < 0 ? -1 : 0;
+}
+
+/* On-disk layout of a line cache, in the machine's own byte order */
+typedef struct {
+    char magic[8];
+    unsigned long long size;
+    long long mtime_sec;
+    long long mtime_nsec;
+    unsigned long long checksum;
+    unsigned long long lines;
+    unsigned long long stride;
+    unsigned long long sample_count;    /* followed by the samples */
+} LineCacheHeader;
+
+static const char line_cache_magic[8] = {'T', 'E', 'L', 'I', 'D', 'X', '0', '1'};
+
+/* Samples are converted to and from the file format this many at a time */
+#define LINE_CACHE_BATCH 512
+
+void file_line_index_init(FileLineIndex *index)
+{
+    if (!index) {
+        return;
+    }
+    index->lines = 0;
+    index->stride = 0;
+    index->samples = NULL;
+    index->sample_count = 0;
+}
+
+void file_line_index_free(FileLineIndex *index)
+{
+    if (!index) {
+        return;
+    }
+    free(index->samples);
+    file_line_index_init(index);
+}
+
+static char *line_cache_path(const char *filename)
+{
+    size_t len = strlen(filename);
+    char *path = (char *)malloc(len + sizeof(FILE_LINE_CACHE_SUFFIX));
+    if (path) {
+        memcpy(path, filename, len);
+        memcpy(path + len, FILE_LINE_CACHE_SUFFIX, sizeof(FILE_LINE_CACHE_SUFFIX));
+    }
+    return path;
+}
+
+/* FNV-1a over the size and the first and last FILE_LINE_CHECK bytes */
+static unsigned long long line_cache_checksum(const char *data, size_t size)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    size_t head = size < FILE_LINE_CHECK ? size : FILE_LINE_CHECK;
+    size_t tail = size - head < FILE_LINE_CHECK ? size - head : FILE_LINE_CHECK;
+
+    for (size_t i = 0; i < sizeof(size); ++i) {
+        hash = (hash ^ (unsigned char)(size >> (8 * i))) * 1099511628211ULL;
+    }
+    for (size_t i = 0; i < head; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+    for (size_t i = size - tail; i < size; ++i) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
 
-        if (buffer_append_line(buffer, line) != 0) {
-            fclose(fp);
+static int read_samples(int fd, size_t *samples, size_t count)
+{
+    unsigned long long batch[LINE_CACHE_BATCH];
+    for (size_t done = 0; done < count;) {
+        size_t n = count - done < LINE_CACHE_BATCH ? count - done : LINE_CACHE_BATCH;
+        if (read_fully(fd, (char *)batch, n * sizeof(batch[0])) != 0) {
             return -1;
         }
+        for (size_t i = 0; i < n; ++i) {
+            samples[done + i] = (size_t)batch[i];
+        }
+        done += n;
+    }
+    return 0;
+}
+
+/* Loads the line cache at `path` into `index` if it was written for this very file */
+static int read_line_cache(const char *path, const FileStamp *stamp, unsigned long long checksum,
+                           FileLineIndex *index)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    LineCacheHeader header;
+    struct stat st;
+    size_t *samples = NULL;
+    size_t size = (size_t)stamp->size;
+    int rc = -1;
+    if (fstat(fd, &st) == 0 && read_fully(fd, (char *)&header, sizeof(header)) == 0 &&
+        memcmp(header.magic, line_cache_magic, sizeof(line_cache_magic)) == 0 &&
+        header.size == (unsigned long long)stamp->size && header.mtime_sec == stamp->mtime_sec &&
+        header.mtime_nsec == stamp->mtime_nsec && header.checksum == checksum && header.stride > 0 &&
+        header.lines > 0 && header.lines <= header.size &&
+        header.sample_count == (header.lines - 1) / header.stride + 1 &&
+        (unsigned long long)st.st_size == sizeof(header) + header.sample_count * sizeof(unsigned long long)) {
+        samples = (size_t *)malloc((size_t)header.sample_count * sizeof(size_t));
+        rc = samples ? read_samples(fd, samples, (size_t)header.sample_count) : -1;
+    }
+    close(fd);
+
+    for (size_t k = 0; rc == 0 && k < (size_t)header.sample_count; ++k) {
+        if (samples[k] >= size || (k == 0 ? samples[k] != 0 : samples[k] <= samples[k - 1])) {
+            rc = -1;
+        }
+    }
+    if (rc != 0) {
+        free(samples);
+        return -1;
     }
 
-    fclose(fp);
+    file_line_index_free(index);
+    index->lines = (size_t)header.lines;
+    index->stride = (size_t)header.stride;
+    index->samples = samples;
+    index->sample_count = (size_t)header.sample_count;
     return 0;
 }
 
-int file_save(const char *filename, const TextBuffer *buffer)
+/* Whether `index` holds the line starts `buffer`'s fully indexed original has */
+static int line_cache_matches(const FileLineIndex *index, const TextBuffer *buffer)
+{
+    const TextSource *src = &buffer->original;
+    if (index->lines != src->line_count) {
+        return 0;
+    }
+    for (size_t k = 0; k < index->sample_count; ++k) {
+        if (index->samples[k] != src->starts[k * index->stride]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Writes the line cache of `buffer`'s fully indexed original to `path`
+ * through a temp file and a rename, and hands its samples to `index` if
+ * non-NULL. The cache is only a hint, so it is not synced.
+ */
+static int write_line_cache(const char *path, const FileStamp *stamp, unsigned long long checksum,
+                            const TextBuffer *buffer, FileLineIndex *index)
+{
+    const TextSource *src = &buffer->original;
+    if (buffer_original_pending(buffer) > 0 || src->line_count == 0) {
+        return -1;
+    }
+
+    size_t stride = FILE_LINE_STRIDE;
+    size_t count = (src->line_count - 1) / stride + 1;
+    size_t *samples = (size_t *)malloc(count * sizeof(size_t));
+    size_t path_len = strlen(path);
+    char *temp_name = (char *)malloc(path_len + sizeof(".XXXXXX"));
+    if (!samples || !temp_name) {
+        free(samples);
+        free(temp_name);
+        return -1;
+    }
+    for (size_t k = 0; k < count; ++k) {
+        samples[k] = src->starts[k * stride];
+    }
+    memcpy(temp_name, path, path_len);
+    memcpy(temp_name + path_len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    LineCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, line_cache_magic, sizeof(line_cache_magic));
+    header.size = (unsigned long long)stamp->size;
+    header.mtime_sec = stamp->mtime_sec;
+    header.mtime_nsec = stamp->mtime_nsec;
+    header.checksum = checksum;
+    header.lines = src->line_count;
+    header.stride = stride;
+    header.sample_count = count;
+
+    int rc = -1;
+    int fd = mkstemp(temp_name);
+    if (fd >= 0) {
+        struct iovec iov = {&header, sizeof(header)};
+        rc = fchmod(fd, target_mode(path)) == 0 ? write_all(fd, &iov, 1) : -1;
+        unsigned long long batch[LINE_CACHE_BATCH];
+        for (size_t done = 0; rc == 0 && done < count;) {
+            size_t n = count - done < LINE_CACHE_BATCH ? count - done : LINE_CACHE_BATCH;
+            for (size_t i = 0; i < n; ++i) {
+                batch[i] = samples[done + i];
+            }
+            iov.iov_base = batch;
+            iov.iov_len = n * sizeof(batch[0]);
+            rc = write_all(fd, &iov, 1);
+            done += n;
+        }
+        if (close(fd) != 0) {
+            rc = -1;
+        }
+        if (rc == 0 && rename(temp_name, path) != 0) {
+            rc = -1;
+        }
+        if (rc != 0) {
+            unlink(temp_name);
+        }
+    }
+    free(temp_name);
+
+    if (index) {
+        file_line_index_free(index);
+        index->lines = src->line_count;
+        index->stride = stride;
+        index->samples = samples;
+        index->sample_count = count;
+    } else {
+        free(samples);
+    }
+    return rc;
+}
+
+int file_line_locate(const FileLineIndex *index, const TextBuffer *buffer, size_t line, size_t *offset)
+{
+    if (!index || !buffer || !offset || line >= index->lines || index->stride == 0 ||
+        line / index->stride >= index->sample_count) {
+        return -1;
+    }
+
+    const TextSource *src = &buffer->original;
+    size_t at = index->samples[line / index->stride];
+    if (at >= src->size || (at > 0 && src->data[at - 1] != '\n')) {
+        return -1;
+    }
+    for (size_t skip = line % index->stride; skip > 0; --skip) {
+        const char *newline = (const char *)memchr(src->data + at, '\n', src->size - at);
+        if (!newline) {
+            return -1;
+        }
+        at = (size_t)(newline - src->data) + 1;
+        if (at >= src->size) {
+            return -1;
+        }
+    }
+    *offset = at;
+    return 0;
+}
+
+int file_line_span(const FileLineIndex *index, const TextBuffer *buffer, size_t line, size_t end_line,
+                   BufferSpan *out)
+{
+    size_t from = 0;
+    if (!index || !out || end_line <= line || end_line > index->lines || file_line_locate(index, buffer, line, &from) != 0) {
+        return -1;
+    }
+
+    const TextSource *src = &buffer->original;
+    size_t to = from;
+    for (size_t i = line; i < end_line && to < src->size; ++i) {
+        const char *newline = (const char *)memchr(src->data + to, '\n', src->size - to);
+        to = newline ? (size_t)(newline - src->data) + 1 : src->size;
+    }
+    out->data = src->data + from;
+    out->len = to - from;
+    return 0;
+}
+
+/* Bytes the indexing thread scans between checks for new room and cancellation */
+#define INDEX_STEP (256 * 1024)
+
+static size_t page_size(void)
+{
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (size_t)size : 4096;
+}
+
+/* Drops the pages wholly inside [from, to) of a mapping */
+static void drop_pages(const char *data, size_t from, size_t to)
+{
+    size_t page = page_size();
+    from = (from + page - 1) / page * page;
+    to = to / page * page;
+    if (from < to) {
+        madvise((void *)(data + from), to - from, MADV_DONTNEED);
+    }
+}
+
+/* Hands the line ends found so far to the collecting side */
+static int publish_ends(FileIndexJob *job, size_t **found, size_t *count, size_t *capacity, size_t scanned)
+{
+    int rc = 0;
+    pthread_mutex_lock(&job->lock);
+    if (job->end_count == 0) {
+        /* Nothing waiting: swap arrays instead of copying */
+        size_t *ends = job->ends;
+        size_t end_capacity = job->end_capacity;
+        job->ends = *found;
+        job->end_count = *count;
+        job->end_capacity = *capacity;
+        *found = ends;
+        *capacity = end_capacity;
+    } else if (*count > 0) {
+        size_t need = job->end_count + *count;
+        if (need > job->end_capacity) {
+            size_t *ends = (size_t *)realloc(job->ends, need * 2 * sizeof(size_t));
+            if (!ends) {
+                rc = -1;
+            } else {
+                job->ends = ends;
+                job->end_capacity = need * 2;
+            }
+        }
+        if (rc == 0) {
+            memcpy(job->ends + job->end_count, *found, *count * sizeof(size_t));
+            job->end_count += *count;
+        }
+    }
+    if (rc == 0) {
+        job->scanned = scanned;
+    }
+    pthread_mutex_unlock(&job->lock);
+    *count = 0;
+    return rc;
+}
+
+static void *index_job_main(void *arg)
+{
+    FileIndexJob *job = (FileIndexJob *)arg;
+    size_t *found = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    size_t dropped = job->from;
+    size_t at = job->from;
+
+    posix_madvise((void *)job->data, job->size, POSIX_MADV_SEQUENTIAL);
+    while (at < job->size && !atomic_load(&job->cancel)) {
+        size_t len = job->size - at < INDEX_STEP ? job->size - at : INDEX_STEP;
+        size_t newlines = search_count_byte(job->data + at, len, '\n');
+        if (count + newlines > capacity) {
+            size_t grown = capacity ? capacity : INDEX_STEP / 16;
+            while (grown < count + newlines) {
+                grown *= 2;
+            }
+            size_t *bigger = (size_t *)realloc(found, grown * sizeof(size_t));
+            if (!bigger) {
+                job->failed = 1;
+                break;
+            }
+            found = bigger;
+            capacity = grown;
+        }
+        search_byte_positions(job->data + at, len, '\n', at + 1, found + count);
+        count += newlines;
+        at += len;
+
+        /* Scanned pages are not needed again unless someone views them */
+        if (at - dropped >= FILE_INDEX_CHUNK || at == job->size) {
+            drop_pages(job->data, dropped, at);
+            dropped = at;
+            if (publish_ends(job, &found, &count, &capacity, at) != 0) {
+                job->failed = 1;
+                break;
+            }
+        }
+    }
+
+    free(found);
+    atomic_store(&job->done, 1);
+    return NULL;
+}
+
+void file_index_job_init(FileIndexJob *job)
+{
+    if (!job) {
+        return;
+    }
+    memset(job, 0, sizeof(*job));
+    atomic_init(&job->done, 0);
+    atomic_init(&job->cancel, 0);
+}
+
+static int index_start(FileIndexJob *job, const TextBuffer *buffer)
+{
+    file_index_job_init(job);
+    job->data = buffer->original.data;
+    job->size = buffer->original.size;
+    job->from = job->size - buffer_original_pending(buffer);
+    job->scanned = job->from;
+    if (pthread_mutex_init(&job->lock, NULL) != 0) {
+        return -1;
+    }
+    job->running = 1;
+    if (pthread_create(&job->thread, NULL, index_job_main, job) != 0) {
+        /* No thread to spare: scan here instead */
+        index_job_main(job);
+        job->joined = 1;
+    }
+    return 0;
+}
+
+static void index_finish(FileIndexJob *job)
+{
+    if (!job->joined) {
+        pthread_join(job->thread, NULL);
+    }
+    pthread_mutex_destroy(&job->lock);
+    free(job->ends);
+    job->ends = NULL;
+    job->end_count = 0;
+    job->end_capacity = 0;
+    free(job->cache_path);
+    job->cache_path = NULL;
+    job->running = 0;
+}
+
+void file_index_cancel(FileIndexJob *job)
+{
+    if (job && job->running) {
+        atomic_store(&job->cancel, 1);
+        index_finish(job);
+    }
+}
+
+unsigned file_index_progress(FileIndexJob *job)
+{
+    if (!job || !job->running || job->size == 0) {
+        return 100;
+    }
+    pthread_mutex_lock(&job->lock);
+    size_t scanned = job->scanned;
+    pthread_mutex_unlock(&job->lock);
+    return (unsigned)(scanned / (job->size / 100 + 1));
+}
+
+void file_trim_mapping(const TextBuffer *buffer, size_t offset, size_t budget)
 {
-    if (!filename || !buffer) {
+    if (!buffer || buffer->original.release != release_mapping) {
+        return;
+    }
+
+    const TextSource *src = &buffer->original;
+    size_t keep_from = offset > budget / 2 ? offset - budget / 2 : 0;
+    size_t keep_to = src->size - keep_from > budget ? keep_from + budget : src->size;
+    drop_pages(src->data, 0, keep_from);
+    drop_pages(src->data, keep_to, src->size);
+}
+
+int file_index_collect(FileIndexJob *job, TextBuffer *buffer, int wait)
+{
+    if (!job || !buffer || !job->running) {
+        return 1;
+    }
+    if (wait && !job->joined) {
+        /* Drain as the scan goes so found ends never pile up alongside the index */
+        struct timespec pause = {0, 2000000};
+        while (!atomic_load(&job->done)) {
+            int rc = file_index_collect(job, buffer, 0);
+            if (!job->running) {
+                return rc; /* the scan ended meanwhile and that call finished the job */
+            }
+            if (rc < 0) {
+                break;
+            }
+            nanosleep(&pause, NULL);
+        }
+        pthread_join(job->thread, NULL);
+        job->joined = 1;
+    }
+
+    /* Read first: once done is set, everything found is already in `ends` */
+    int done = atomic_load(&job->done);
+    pthread_mutex_lock(&job->lock);
+    size_t *ends = job->ends;
+    size_t count = job->end_count;
+    job->ends = NULL;
+    job->end_count = 0;
+    job->end_capacity = 0;
+    pthread_mutex_unlock(&job->lock);
+
+    int rc = buffer_extend_original(buffer, ends, count, done && !job->failed);
+    free(ends);
+    if (!done) {
+        return rc == 0 ? 0 : -1;
+    }
+    int failed = job->failed;
+    if (rc == 0 && !failed && job->cache_path && !line_cache_matches(job->line_cache, buffer)) {
+        write_line_cache(job->cache_path, &job->cache_stamp, job->cache_checksum, buffer, job->line_cache);
+    }
+    index_finish(job);
+    return rc == 0 && !failed ? 1 : -1;
+}
+
+int file_load(const char *filename, TextBuffer *buffer)
+{
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    return file_load_with(filename, buffer, &options);
+}
+
+/*
+ * Attaches a regular file's bytes to `buffer`, going through the file's
+ * line cache if the options ask for one, and writing the cache whenever
+ * it was missing or stale.
+ */
+static int attach_file(const char *filename, TextBuffer *buffer, const FileLoadOptions *options,
+                       const struct stat *st, char *data, BufferReleaseFn release, int lazy)
+{
+    size_t size = (size_t)st->st_size;
+    size_t threads = options->threads ? options->threads : parallel_default_threads();
+    FileLineIndex *cache = options->line_cache;
+    FileStamp stamp;
+    unsigned long long checksum = 0;
+    char *path = NULL;
+    int cached = 0;
+
+    if (cache && size >= options->line_cache_min) {
+        stamp_from(&stamp, st);
+        checksum = line_cache_checksum(data, size);
+        path = line_cache_path(filename);
+        cached = path && read_line_cache(path, &stamp, checksum, cache) == 0;
+    }
+
+    int rc = 0;
+    if (lazy) {
+        rc = buffer_attach_original_lazy(buffer, data, size, release, FILE_INDEX_PREFIX);
+        if (rc == 0 && buffer_original_pending(buffer) > 0) {
+            rc = index_start(options->index, buffer);
+            if (rc == 0 && path) {
+                /* file_index_collect checks or writes it once the thread is done */
+                options->index->cache_path = path;
+                options->index->cache_stamp = stamp;
+                options->index->cache_checksum = checksum;
+                options->index->line_cache = cache;
+                path = NULL;
+            }
+        }
+    } else if (cached) {
+        rc = buffer_attach_original_sampled(buffer, data, size, release, threads, cache->samples,
+                                            cache->sample_count, cache->stride, cache->lines);
+        cached = rc == 0 && line_cache_matches(cache, buffer);
+    } else {
+        rc = buffer_attach_original_parallel(buffer, data, size, release, threads);
+    }
+
+    if (rc == 0 && path && !cached && buffer_original_pending(buffer) == 0) {
+        write_line_cache(path, &stamp, checksum, buffer, cache);
+    }
+    free(path);
+    return rc;
+}
+
+static int load_file(const char *filename, TextBuffer *buffer, const FileLoadOptions *options)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        /* Treat as non-fatal: caller may want to start with an empty buffer */
         return -1;
     }
 
-    FILE *fp = fopen(filename, "w");
-    if (!fp) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
         return -1;
     }
+    if (options->stamp) {
+        stamp_from(options->stamp, &st);
+        options->stamp->valid = S_ISREG(st.st_mode);
+    }
+
+    if (!S_ISREG(st.st_mode)) {
+        /* Pipes and devices cannot be sized or mapped */
+        FILE *fp = fdopen(fd, "r");
+        if (!fp) {
+            close(fd);
+            return -1;
+        }
+        int rc = load_stream(fp, buffer);
+        fclose(fp);
+        return rc;
+    }
+
+    size_t size = (size_t)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return buffer_attach_original(buffer, NULL, 0, NULL);
+    }
 
-    for (size_t i = 0; i < buffer->count; ++i) {
-        const char *line = buffer->lines[i] ? buffer->lines[i] : "";
-        if (fputs(line, fp) == EOF || fputc('\n', fp) == EOF) {
-            fclose(fp);
+    int use_map = options->map == FILE_MAP_ALWAYS ||
+                  (options->map == FILE_MAP_AUTO && size >= FILE_MAP_THRESHOLD);
+    if (use_map) {
+        void *map = map_file(fd, size);
+        if (map != MAP_FAILED) {
+            close(fd);
+            int lazy = options->index && size >= options->lazy_threshold;
+            return attach_file(filename, buffer, options, &st, (char *)map, release_mapping, lazy);
+        }
+        if (options->map == FILE_MAP_ALWAYS) {
+            close(fd);
             return -1;
         }
+        /* Some filesystems cannot be mapped; reading still works */
     }
 
-    if (fclose(fp) == EOF) {
+    char *data = (char *)malloc(size);
+    if (!data || read_fully(fd, data, size) != 0) {
+        free(data);
+        close(fd);
         return -1;
     }
+    close(fd);
+
+    /* The file bytes become the buffer's original source as-is */
+    return attach_file(filename, buffer, options, &st, data, release_file_data, 0);
+}
+
+int file_load_with(const char *filename, TextBuffer *buffer, const FileLoadOptions *options)
+{
+    /* A running index job still reads the buffer's current file */
+    if (!filename || !buffer || !options || (options->index && options->index->running)) {
+        return -1;
+    }
+
+    unsigned long long start = stats_start();
+    file_line_index_free(options->line_cache);
+    int rc = load_file(filename, buffer, options);
+    if (rc == 0 && start != 0) {
+        stats_record(STATS_LOAD, buffer_size(buffer), start);
+    }
+    return rc;
+}
+
+/* Writes every iovec in full, resuming after short writes */
+static int write_all(int fd, struct iovec *iov, int count)
+{
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
 
+        size_t left = (size_t)written;
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + left;
+            iov->iov_len -= left;
+        }
+    }
     return 0;
 }
+
+/* Gathers the buffer's spans into batches of SAVE_BATCH_SPANS per writev */
+static int write_lines(int fd, const TextBuffer *buffer)
+{
+    BufferSpan spans[SAVE_BATCH_SPANS];
+    struct iovec iov[SAVE_BATCH_SPANS];
+    size_t line = 0;
+    size_t count;
+
+    while ((count = buffer_get_spans(buffer, &line, buffer->count, spans, SAVE_BATCH_SPANS)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = (void *)spans[i].data;
+            iov[i].iov_len = spans[i].len;
+        }
+        if (write_all(fd, iov, (int)count) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Makes a completed rename durable by syncing the directory that holds it */
+static int sync_parent_dir(const char *filename)
+{
+    const char *slash = strrchr(filename, '/');
+    char *dir = NULL;
+
+    if (!slash) {
+        dir = strdup(".");
+    } else if (slash == filename) {
+        dir = strdup("/");
+    } else {
+        dir = strndup(filename, (size_t)(slash - filename));
+    }
+    if (!dir) {
+        return -1;
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    free(dir);
+    if (fd < 0) {
+        return -1;
+    }
+    /* Some filesystems cannot sync directories; the rename stands anyway */
+    int rc = fsync(fd) == 0 || errno == EINVAL ? 0 : -1;
+    close(fd);
+    return rc;
+}
+
+static pthread_once_t umask_once = PTHREAD_ONCE_INIT;
+static mode_t process_umask;
+
+/* umask() can only be read by setting it, so it is read once and kept */
+static void read_umask(void)
+{
+    process_umask = umask(0);
+    umask(process_umask);
+}
+
+/*
+ * Permissions the saved file should end up with. Called on the thread
+ * that starts a save, never on a save thread.
+ */
+static mode_t target_mode(const char *filename)
+{
+    struct stat st;
+    if (stat(filename, &st) == 0) {
+        return st.st_mode & 07777;
+    }
+
+    pthread_once(&umask_once, read_umask);
+    return 0666 & ~process_umask;
+}
+
+/* Writes the snapshot's spans in batches of SAVE_BATCH_SPANS per writev */
+static int write_snapshot(int fd, const BufferSnapshot *snapshot)
+{
+    struct iovec iov[SAVE_BATCH_SPANS];
+
+    for (size_t done = 0; done < snapshot->count;) {
+        size_t count = snapshot->count - done < SAVE_BATCH_SPANS ? snapshot->count - done : SAVE_BATCH_SPANS;
+        for (size_t i = 0; i < count; ++i) {
+            iov[i].iov_base = (void *)snapshot->spans[done + i].data;
+            iov[i].iov_len = snapshot->spans[done + i].len;
+        }
+        if (write_all(fd, iov, (int)count) != 0) {
+            return -1;
+        }
+        done += count;
+    }
+    return 0;
+}
+
+/* Writes either the buffer or a snapshot of it to a temp file renamed over `filename` */
+static int save_atomic(const char *filename, const TextBuffer *buffer, const BufferSnapshot *snapshot,
+                       mode_t mode)
+{
+    unsigned long long start = stats_start();
+    size_t name_len = strlen(filename);
+    char *temp_name = (char *)malloc(name_len + sizeof(".XXXXXX"));
+    if (!temp_name) {
+        return -1;
+    }
+    memcpy(temp_name, filename, name_len);
+    memcpy(temp_name + name_len, ".XXXXXX", sizeof(".XXXXXX"));
+
+    int fd = mkstemp(temp_name);
+    if (fd < 0) {
+        free(temp_name);
+        return -1;
+    }
+
+    int rc = fchmod(fd, mode);
+    if (rc == 0) {
+        rc = buffer ? write_lines(fd, buffer) : write_snapshot(fd, snapshot);
+    }
+    /* The data must be on disk before the rename can expose it */
+    if (rc == 0 && fsync(fd) != 0) {
+        rc = -1;
+    }
+    if (close(fd) != 0) {
+        rc = -1;
+    }
+
+    /* Renaming leaves any mapping of the old file intact */
+    if (rc == 0 && rename(temp_name, filename) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        unlink(temp_name);
+    } else {
+        rc = sync_parent_dir(filename);
+    }
+    if (rc == 0 && start != 0) {
+        stats_record(STATS_SAVE, buffer ? buffer_size(buffer) : snapshot->size, start);
+    }
+
+    free(temp_name);
+    return rc;
+}
+
+int file_save(const char *filename, const TextBuffer *buffer)
+{
+    /* The spans would leave out character edits still in the gap buffer */
+    if (!filename || !buffer || buffer_original_pending(buffer) > 0 || buffer->edit.dirty) {
+        return -1;
+    }
+    return save_atomic(filename, buffer, NULL, target_mode(filename));
+}
+
+int file_save_snapshot(const char *filename, const BufferSnapshot *snapshot)
+{
+    if (!filename || !snapshot) {
+        return -1;
+    }
+    return save_atomic(filename, NULL, snapshot, target_mode(filename));
+}
+
+static void *save_job_main(void *arg)
+{
+    FileSaveJob *job = (FileSaveJob *)arg;
+    job->result = save_atomic(job->filename, NULL, &job->snapshot, job->mode);
+    job->error = job->result != 0 ? errno : 0;
+    atomic_store(&job->done, 1);
+    return NULL;
+}
+
+void file_save_job_init(FileSaveJob *job)
+{
+    if (!job) {
+        return;
+    }
+    memset(&job->snapshot, 0, sizeof(job->snapshot));
+    job->filename = NULL;
+    job->mode = 0;
+    job->running = 0;
+    atomic_init(&job->done, 0);
+    job->result = 0;
+    job->error = 0;
+}
+
+int file_save_start(FileSaveJob *job, const char *filename, TextBuffer *buffer)
+{
+    if (!job || !filename || !buffer || job->running || buffer_original_pending(buffer) > 0) {
+        return -1;
+    }
+
+    job->filename = strdup(filename);
+    if (!job->filename) {
+        return -1;
+    }
+    if (buffer_snapshot(buffer, &job->snapshot) != 0) {
+        free(job->filename);
+        job->filename = NULL;
+        return -1;
+    }
+
+    atomic_store(&job->done, 0);
+    job->mode = target_mode(filename);
+    job->result = 0;
+    job->error = 0;
+    if (pthread_create(&job->thread, NULL, save_job_main, job) != 0) {
+        buffer_snapshot_release(buffer, &job->snapshot);
+        free(job->filename);
+        job->filename = NULL;
+        return -1;
+    }
+    job->running = 1;
+    return 0;
+}
+
+int file_save_finish(FileSaveJob *job, TextBuffer *buffer, int wait)
+{
+    if (!job || !job->running || (!wait && !atomic_load(&job->done))) {
+        return 0;
+    }
+
+    pthread_join(job->thread, NULL);
+    buffer_snapshot_release(buffer, &job->snapshot);
+    free(job->filename);
+    job->filename = NULL;
+    job->running = 0;
+    return 1;
+}
+
+const char *file_save_mode_name(FileSaveMode mode)
+{
+    switch (mode) {
+    case FILE_SAVE_UNCHANGED:
+        return "unchanged";
+    case FILE_SAVE_PATCHED:
+        return "patched in place";
+    case FILE_SAVE_SUFFIX:
+        return "rewrote the tail in place";
+    default:
+        return "full rewrite";
+    }
+}
+
+static int pwrite_all(int fd, const char *data, size_t len, size_t offset)
+{
+    while (len > 0) {
+        ssize_t written = pwrite(fd, data, len, (off_t)offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += written;
+        len -= (size_t)written;
+        offset += (size_t)written;
+    }
+    return 0;
+}
+
+static int pread_all(int fd, char *data, size_t len, size_t offset)
+{
+    while (len > 0) {
+        ssize_t n = pread(fd, data, len, (off_t)offset);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+        offset += (size_t)n;
+    }
+    return 0;
+}
+
+/* Copies document lines [line, end) to `dest` */
+static char *copy_lines(const TextBuffer *buffer, size_t line, size_t end, char *dest)
+{
+    BufferSpan spans[SAVE_BATCH_SPANS];
+    size_t count;
+
+    while ((count = buffer_get_spans(buffer, &line, end, spans, SAVE_BATCH_SPANS)) > 0) {
+        for (size_t i = 0; i < count; ++i) {
+            memcpy(dest, spans[i].data, spans[i].len);
+            dest += spans[i].len;
+        }
+    }
+    return dest;
+}
+
+typedef struct {
+    BufferSpan *spans;
+    size_t count;
+    size_t capacity;
+} SpanList;
+
+static int collect_spans(const TextBuffer *buffer, size_t line, SpanList *list)
+{
+    for (;;) {
+        if (list->capacity - list->count < SAVE_BATCH_SPANS) {
+            size_t capacity = list->capacity ? list->capacity * 2 : SAVE_BATCH_SPANS * 4;
+            BufferSpan *spans = (BufferSpan *)realloc(list->spans, capacity * sizeof(BufferSpan));
+            if (!spans) {
+                return -1;
+            }
+            list->spans = spans;
+            list->capacity = capacity;
+        }
+
+        size_t count = buffer_get_spans(buffer, &line, buffer->count, list->spans + list->count, SAVE_BATCH_SPANS);
+        if (count == 0) {
+            return 0;
+        }
+        list->count += count;
+    }
+}
+
+/*
+ * Which way the suffix can be streamed over the file it is partly read
+ * from: forwards if no original byte moves later, backwards if none moves
+ * earlier. Returns 1, -1, or 0 when bytes move both ways.
+ */
+static int suffix_direction(const TextBuffer *buffer, const SpanList *list, size_t offset)
+{
+    const char *orig = buffer->original.data;
+    int later = 0;
+    int earlier = 0;
+
+    if (buffer->original.release != release_mapping) {
+        return 1; /* a private copy is never overwritten */
+    }
+
+    for (size_t i = 0; i < list->count; ++i) {
+        const char *data = list->spans[i].data;
+        if (data >= orig && data < orig + buffer->original.size) {
+            size_t source = (size_t)(data - orig);
+            later |= offset > source;
+            earlier |= offset < source;
+        }
+        offset += list->spans[i].len;
+    }
+    if (later && earlier) {
+        return 0;
+    }
+    return later ? -1 : 1;
+}
+
+/*
+ * Writes the spans at `offset` through a bounce buffer, so each chunk is
+ * read completely before the bytes it lands on are overwritten.
+ */
+static int stream_spans(int fd, const SpanList *list, size_t offset, size_t size, int direction)
+{
+    char *bounce = (char *)malloc(SAVE_BOUNCE_SIZE);
+    if (!bounce) {
+        return -1;
+    }
+
+    int rc = 0;
+    size_t fill = 0;
+    if (direction > 0) {
+        for (size_t i = 0; i < list->count && rc == 0; ++i) {
+            const char *data = list->spans[i].data;
+            size_t left = list->spans[i].len;
+            while (left > 0 && rc == 0) {
+                size_t take = left < SAVE_BOUNCE_SIZE - fill ? left : SAVE_BOUNCE_SIZE - fill;
+                memcpy(bounce + fill, data, take);
+                fill += take;
+                data += take;
+                left -= take;
+                if (fill == SAVE_BOUNCE_SIZE) {
+                    rc = pwrite_all(fd, bounce, fill, offset);
+                    offset += fill;
+                    fill = 0;
+                }
+            }
+        }
+        if (rc == 0 && fill > 0) {
+            rc = pwrite_all(fd, bounce, fill, offset);
+        }
+    } else {
+        size_t end = size;
+        fill = SAVE_BOUNCE_SIZE;
+        for (size_t i = list->count; i-- > 0 && rc == 0;) {
+            size_t left = list->spans[i].len;
+            while (left > 0 && rc == 0) {
+                size_t take = left < fill ? left : fill;
+                memcpy(bounce + fill - take, list->spans[i].data + left - take, take);
+                fill -= take;
+                left -= take;
+                if (fill == 0) {
+                    rc = pwrite_all(fd, bounce, SAVE_BOUNCE_SIZE, end - SAVE_BOUNCE_SIZE);
+                    end -= SAVE_BOUNCE_SIZE;
+                    fill = SAVE_BOUNCE_SIZE;
+                }
+            }
+        }
+        if (rc == 0 && fill < SAVE_BOUNCE_SIZE) {
+            rc = pwrite_all(fd, bounce + fill, SAVE_BOUNCE_SIZE - fill, end - (SAVE_BOUNCE_SIZE - fill));
+        }
+    }
+
+    free(bounce);
+    return rc;
+}
+
+/* Builds the new original from the old one plus the bytes just written */
+static int rebase_after_save(int fd, TextBuffer *buffer, const BufferDiff *diff, const char *patch_bytes)
+{
+    const TextSource *orig = &buffer->original;
+    size_t keep = diff->suffix_line;
+
+    if (diff->size == 0) {
+        return buffer_rebase_original(buffer, NULL, 0, NULL, 0);
+    }
+
+    if (orig->release == release_mapping) {
+        /* The new mapping reads the saved file, so nothing is copied */
+        void *map = map_file(fd, diff->size);
+        if (map != MAP_FAILED) {
+            return buffer_rebase_original(buffer, (char *)map, diff->size, release_mapping, keep);
+        }
+        /* The unchanged prefix still reads the same through the old mapping */
+    }
+
+    char *data = (char *)malloc(diff->size);
+    if (!data) {
+        return -1;
+    }
+    if (diff->suffix_offset > 0) {
+        memcpy(data, orig->data, diff->suffix_offset);
+    }
+    for (size_t i = 0; i < diff->patch_count; ++i) {
+        memcpy(data + diff->patches[i].offset, patch_bytes, diff->patches[i].len);
+        patch_bytes += diff->patches[i].len;
+    }
+    if (pread_all(fd, data + diff->suffix_offset, diff->size - diff->suffix_offset, diff->suffix_offset) != 0) {
+        free(data);
+        return -1;
+    }
+    return buffer_rebase_original(buffer, data, diff->size, release_file_data, keep);
+}
+
+/*
+ * Makes the file just saved by file_save the buffer's original. It holds
+ * the pieces back to back, so their line table is reused and the file is
+ * mapped or read but never scanned for newlines.
+ */
+static int rebase_saved(const char *filename, TextBuffer *buffer, FileStamp *stamp)
+{
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size != buffer_size(buffer)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    size_t size = (size_t)st.st_size;
+    int rc = -1;
+    if (size == 0) {
+        rc = buffer_rebase_saved(buffer, NULL, 0, NULL);
+    } else {
+        void *map = size >= FILE_MAP_THRESHOLD ? map_file(fd, size) : MAP_FAILED;
+        if (map != MAP_FAILED) {
+            rc = buffer_rebase_saved(buffer, (char *)map, size, release_mapping);
+        } else {
+            char *data = (char *)malloc(size);
+            if (data && read_fully(fd, data, size) == 0) {
+                rc = buffer_rebase_saved(buffer, data, size, release_file_data);
+            } else {
+                free(data);
+            }
+        }
+    }
+    close(fd);
+
+    if (rc == 0) {
+        stamp_from(stamp, &st);
+    }
+    return rc;
+}
+
+/* Swaps in a fresh load of the file just saved, which holds the document */
+static int reload_saved(const char *filename, TextBuffer *buffer, size_t lines, FileStamp *stamp)
+{
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.stamp = stamp;
+
+    TextBuffer saved;
+    buffer_init(&saved);
+    if (file_load_with(filename, &saved, &options) != 0 || saved.count != lines) {
+        /* The file is saved; only later saves lose the incremental path */
+        buffer_free(&saved);
+        stamp->valid = 0;
+        return -1;
+    }
+
+    buffer_free(buffer);
+    *buffer = saved;
+    return 0;
+}
+
+int file_save_full(const char *filename, TextBuffer *buffer, FileStamp *stamp, FileSaveResult *result)
+{
+    FileSaveResult unused;
+    if (!result) {
+        result = &unused;
+    }
+    if (!filename || !buffer || !stamp || file_save(filename, buffer) != 0) {
+        return -1;
+    }
+
+    /* A huge file still being indexed has no full line table to reuse */
+    size_t size = buffer_size(buffer);
+    result->mode = FILE_SAVE_FULL;
+    result->bytes_written = size;
+    result->rebased = rebase_saved(filename, buffer, stamp) == 0 ||
+                      reload_saved(filename, buffer, buffer->count, stamp) == 0;
+    if (!result->rebased) {
+        stamp->valid = 0;
+    }
+    return 0;
+}
+
+int file_save_incremental(const char *filename, TextBuffer *buffer, FileStamp *stamp, FileSaveResult *result)
+{
+    FileSaveResult unused;
+    if (!result) {
+        result = &unused;
+    }
+    if (!filename || !buffer || !stamp || buffer_original_pending(buffer) > 0) {
+        return -1;
+    }
+    result->mode = FILE_SAVE_FULL;
+    result->bytes_written = 0;
+    result->rebased = 0;
+
+    /* Full saves are counted by file_save itself */
+    unsigned long long start = stats_start();
+    struct stat st;
+    int fd = open(filename, O_RDWR);
+    if (fd < 0 || fstat(fd, &st) != 0 || !stamp_matches(stamp, &st) ||
+        (size_t)st.st_size != buffer->original.size || buffer->original_crlf) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return file_save_full(filename, buffer, stamp, result);
+    }
+
+    BufferDiff diff;
+    if (buffer_diff_original(buffer, &diff) != 0) {
+        close(fd);
+        return file_save_full(filename, buffer, stamp, result);
+    }
+
+    /* Patches may be read from bytes the suffix overwrites, so copy them first */
+    size_t patch_bytes = 0;
+    for (size_t i = 0; i < diff.patch_count; ++i) {
+        patch_bytes += diff.patches[i].len;
+    }
+    char *patches = (char *)malloc(patch_bytes ? patch_bytes : 1);
+    SpanList suffix = { NULL, 0, 0 };
+    int direction = 1;
+    int rc = patches ? 0 : -1;
+
+    if (rc == 0) {
+        char *at = patches;
+        for (size_t i = 0; i < diff.patch_count; ++i) {
+            at = copy_lines(buffer, diff.patches[i].line, diff.patches[i].line + diff.patches[i].count, at);
+        }
+        rc = collect_spans(buffer, diff.suffix_line, &suffix);
+    }
+    if (rc == 0) {
+        direction = suffix_direction(buffer, &suffix, diff.suffix_offset);
+    }
+    if (rc != 0 || direction == 0) {
+        free(suffix.spans);
+        free(patches);
+        buffer_diff_free(&diff);
+        close(fd);
+        return file_save_full(filename, buffer, stamp, result);
+    }
+
+    size_t suffix_bytes = diff.size - diff.suffix_offset;
+    rc = stream_spans(fd, &suffix, diff.suffix_offset, diff.size, direction);
+
+    /* Patches last: the suffix may still have been reading their old bytes */
+    const char *at = patches;
+    for (size_t i = 0; rc == 0 && i < diff.patch_count; ++i) {
+        rc = pwrite_all(fd, at, diff.patches[i].len, diff.patches[i].offset);
+        at += diff.patches[i].len;
+    }
+    free(suffix.spans);
+
+    if (rc == 0) {
+        if (patch_bytes == 0 && suffix_bytes == 0 && diff.size == (size_t)st.st_size) {
+            result->mode = FILE_SAVE_UNCHANGED;
+        } else {
+            result->mode = diff.suffix_line < buffer->count || diff.size != (size_t)st.st_size
+                               ? FILE_SAVE_SUFFIX
+                               : FILE_SAVE_PATCHED;
+        }
+        result->bytes_written = patch_bytes + suffix_bytes;
+
+        /*
+         * The file now holds the document; it becomes the new original.
+         * That happens before the file is cut short, so no mapping of the
+         * old original ever reaches past its end.
+         */
+        size_t lines = buffer->count;
+        int rebased = result->mode == FILE_SAVE_UNCHANGED || rebase_after_save(fd, buffer, &diff, patches) == 0;
+        if (!rebased && buffer->original.release == release_mapping) {
+            /* Its bytes were rewritten under it, so it is of no use anymore */
+            buffer_rebase_original(buffer, NULL, 0, NULL, 0);
+        }
+        if (diff.size < (size_t)st.st_size && ftruncate(fd, (off_t)diff.size) != 0) {
+            rc = -1;
+        }
+        if (rc == 0 && fsync(fd) != 0) {
+            rc = -1;
+        }
+        if (rc == 0 && fstat(fd, &st) == 0) {
+            stamp_from(stamp, &st);
+        } else {
+            stamp->valid = 0;
+        }
+        if (rc == 0 && !rebased) {
+            rc = reload_saved(filename, buffer, lines, stamp);
+        }
+        result->rebased = rc == 0;
+    }
+    if (rc != 0) {
+        stamp->valid = 0; /* the file may be half written; save whole next time */
+    } else {
+        stats_record(STATS_SAVE, result->bytes_written, start);
+    }
+
+    free(patches);
+    buffer_diff_free(&diff);
+    close(fd);
+    return rc;
+}
+
+void file_follow_init(FileFollow *follow)
+{
+    if (!follow) {
+        return;
+    }
+    follow->filename = NULL;
+    follow->fd = -1;
+    follow->notify_fd = -1;
+    follow->watch = -1;
+    follow->offset = 0;
+    follow->lines = 0;
+    follow->open_tail = 0;
+    follow->chunk = NULL;
+    follow->active = 0;
+}
+
+/* Watches the file now at the followed name, if the system can */
+static void follow_watch(FileFollow *follow)
+{
+#ifdef __linux__
+    if (follow->notify_fd < 0) {
+        follow->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    }
+    if (follow->notify_fd >= 0) {
+        if (follow->watch >= 0) {
+            inotify_rm_watch(follow->notify_fd, follow->watch);
+        }
+        follow->watch = inotify_add_watch(follow->notify_fd, follow->filename,
+                                          IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF);
+    }
+#endif
+}
+
+/* Whether the file's first `size` bytes end in the middle of a line */
+static int follow_tail_open(int fd, size_t size)
+{
+    char last = '\n';
+    return size > 0 && pread(fd, &last, 1, (off_t)(size - 1)) == 1 && last != '\n';
+}
+
+/* Loads the file now at the followed name into `buffer` and follows it from its end */
+static int follow_reload(FileFollow *follow, TextBuffer *buffer, FileStamp *stamp)
+{
+    for (int attempt = 0; attempt < 3; ++attempt) {
+        FileStamp loaded;
+        FileLoadOptions options;
+        file_load_options_init(&options);
+        options.stamp = &loaded;
+        if (file_load_with(follow->filename, buffer, &options) != 0 || !loaded.valid) {
+            return -1;
+        }
+
+        struct stat st;
+        int fd = open(follow->filename, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return -1;
+        }
+        if (fstat(fd, &st) == 0 && (unsigned long long)st.st_dev == loaded.device &&
+            (unsigned long long)st.st_ino == loaded.inode) {
+            if (follow->fd >= 0) {
+                close(follow->fd);
+            }
+            follow->fd = fd;
+            follow->offset = (size_t)loaded.size;
+            follow->lines = buffer->count;
+            follow->open_tail = follow_tail_open(fd, follow->offset);
+            if (stamp) {
+                *stamp = loaded;
+            }
+            follow_watch(follow);
+            return 0;
+        }
+        /* Replaced again between the load and the open: load the newer one */
+        close(fd);
+    }
+    return -1;
+}
+
+/* Drops each CR that ends a line, as loading does; returns the new length */
+static size_t strip_line_cr(char *text, size_t len)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (text[i] == '\r') {
+            size_t run = i;
+            while (run < len && text[run] == '\r') {
+                run++;
+            }
+            if (run < len && text[run] == '\n') {
+                i = run - 1;
+                continue;
+            }
+        }
+        text[out++] = text[i];
+    }
+    return out;
+}
+
+/* Appends newly read text, first completing the buffer's open last line */
+static int follow_append_text(FileFollow *follow, TextBuffer *buffer, const char *text, size_t len)
+{
+    const char *at = text;
+    const char *end = text + len;
+
+    /* Lines edited away since the last update leave nothing to complete */
+    if (follow->open_tail && buffer->count > 0 && buffer->count == follow->lines) {
+        const char *newline = (const char *)memchr(at, '\n', len);
+        size_t part = (size_t)((newline ? newline : end) - at);
+        size_t last = buffer->count - 1;
+        if (buffer_insert_chars(buffer, last, buffer_line_length(buffer, last), at, part) != 0 ||
+            buffer_sync_edit(buffer) != 0) {
+            return -1;
+        }
+        at += part;
+        if (newline) {
+            at++;
+            follow->open_tail = 0;
+        }
+    } else {
+        follow->open_tail = 0;
+    }
+
+    if (at < end) {
+        int open = end[-1] != '\n';
+        if (buffer_insert_lines(buffer, buffer->count, at, (size_t)(end - at) - (open ? 0 : 1)) != 0) {
+            return -1;
+        }
+        follow->open_tail = open;
+    }
+    follow->lines = buffer->count;
+    return 0;
+}
+
+/* Reads and appends the file's bytes from the followed offset up to `size` */
+static int follow_append(FileFollow *follow, TextBuffer *buffer, size_t size)
+{
+    while (follow->offset < size) {
+        size_t want = size - follow->offset < FILE_FOLLOW_READ ? size - follow->offset : FILE_FOLLOW_READ;
+        ssize_t got = pread(follow->fd, follow->chunk, want, (off_t)follow->offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return -1;
+        }
+        if (got == 0) {
+            break; /* shrank meanwhile; the next update sees it */
+        }
+
+        /* CRs at the end may belong to a CRLF still to come: read them again next time */
+        size_t raw = (size_t)got;
+        size_t take = raw;
+        while (take > 0 && follow->chunk[take - 1] == '\r') {
+            take--;
+        }
+        if (take == 0) {
+            if (follow->offset + raw == size) {
+                break;
+            }
+            take = raw;
+        }
+
+        size_t len = strip_line_cr(follow->chunk, take);
+        if (follow_append_text(follow, buffer, follow->chunk, len) != 0) {
+            return -1;
+        }
+        follow->offset += take;
+    }
+    return 0;
+}
+
+int file_follow_start(FileFollow *follow, const char *filename, TextBuffer *buffer, FileStamp *stamp,
+                      FileFollowEvent *event)
+{
+    if (!follow || !filename || !buffer || !event || buffer_original_pending(buffer) > 0) {
+        return -1;
+    }
+
+    file_follow_init(follow);
+    follow->filename = strdup(filename);
+    follow->chunk = (char *)malloc(FILE_FOLLOW_READ);
+    follow->active = 1;
+    if (!follow->filename || !follow->chunk) {
+        file_follow_stop(follow);
+        return -1;
+    }
+
+    *event = FILE_FOLLOW_IDLE;
+    struct stat st;
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        /* Pipes and devices have no end to follow from */
+        if (fd >= 0) {
+            close(fd);
+        }
+        file_follow_stop(follow);
+        return -1;
+    }
+    int same = stamp && stamp->valid && (unsigned long long)st.st_dev == stamp->device &&
+               (unsigned long long)st.st_ino == stamp->inode;
+    if (same && (st.st_size > stamp->size || stamp_matches(stamp, &st))) {
+        /* The buffer holds the file as loaded: only what came since is new */
+        follow->fd = fd;
+        follow->offset = (size_t)stamp->size;
+        follow->lines = buffer->count;
+        follow->open_tail = follow_tail_open(fd, follow->offset);
+        follow_watch(follow);
+        return 0;
+    }
+
+    *event = same ? FILE_FOLLOW_TRUNCATED : FILE_FOLLOW_REPLACED;
+    close(fd);
+    if (follow_reload(follow, buffer, stamp) != 0) {
+        file_follow_stop(follow);
+        return -1;
+    }
+    return 0;
+}
+
+int file_follow_update(FileFollow *follow, TextBuffer *buffer, FileStamp *stamp, FileFollowEvent *event)
+{
+    if (!follow || !buffer || !event || !follow->active) {
+        return -1;
+    }
+
+    *event = FILE_FOLLOW_IDLE;
+    struct stat st;
+    if (fstat(follow->fd, &st) != 0) {
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    if (size < follow->offset) {
+        *event = FILE_FOLLOW_TRUNCATED;
+        return follow_reload(follow, buffer, stamp);
+    }
+    if (size > follow->offset) {
+        size_t offset = follow->offset;
+        int rc = follow_append(follow, buffer, size);
+        if (follow->offset != offset) {
+            *event = FILE_FOLLOW_APPENDED;
+            if (stamp) {
+                /* Held-back bytes keep the stamp from matching until they are read */
+                stamp_from(stamp, &st);
+                stamp->size = (long long)follow->offset;
+            }
+        }
+        return rc;
+    }
+
+    /* Read to its end: switch once another file has taken the name */
+    struct stat named;
+    if (stat(follow->filename, &named) == 0 && (named.st_dev != st.st_dev || named.st_ino != st.st_ino)) {
+        *event = FILE_FOLLOW_REPLACED;
+        return follow_reload(follow, buffer, stamp);
+    }
+    return 0;
+}
+
+int file_follow_wait(FileFollow *follow, int input_fd, int timeout_ms)
+{
+    if (!follow || !follow->active) {
+        return -1;
+    }
+
+    struct pollfd fds[2];
+    nfds_t count = 0;
+    if (input_fd >= 0) {
+        fds[count].fd = input_fd;
+        fds[count].events = POLLIN;
+        count++;
+    }
+    if (follow->notify_fd >= 0) {
+        fds[count].fd = follow->notify_fd;
+        fds[count].events = POLLIN;
+        count++;
+    }
+
+    int rc = poll(fds, count, timeout_ms);
+    if (rc < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    if (follow->notify_fd >= 0) {
+        /* The events only say when to look; the update reads the file itself */
+        char events[4096];
+        while (read(follow->notify_fd, events, sizeof(events)) > 0) {
+        }
+    }
+    return input_fd >= 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) ? 1 : 0;
+}
+
+void file_follow_stop(FileFollow *follow)
+{
+    if (!follow) {
+        return;
+    }
+    if (follow->fd >= 0) {
+        close(follow->fd);
+    }
+    if (follow->notify_fd >= 0) {
+        close(follow->notify_fd);
+    }
+    free(follow->filename);
+    free(follow->chunk);
+    file_follow_init(follow);
+}
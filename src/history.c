@@ -0,0 +1,612 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: history.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#include "history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define HISTORY_INITIAL_OPS 64
+#define HISTORY_INITIAL_PAYLOAD 4096
+
+void history_init(History *history)
+{
+    if (!history) {
+        return;
+    }
+    memset(history, 0, sizeof(*history));
+    history->limit = HISTORY_DEFAULT_LIMIT;
+}
+
+void history_free(History *history)
+{
+    if (!history) {
+        return;
+    }
+    free(history->ops);
+    free(history->payload);
+    history_init(history);
+}
+
+void history_clear(History *history)
+{
+    if (!history) {
+        return;
+    }
+    history->op_start = 0;
+    history->op_count = 0;
+    history->cursor = 0;
+    history->payload_base += history->payload_len;
+    history->payload_len = 0;
+    history->group_started = 0;
+    history->can_merge = 0;
+}
+
+static const char *op_text(const History *history, const HistoryOp *op)
+{
+    return history->payload + (op->payload - history->payload_base);
+}
+
+/* Log offset where the oldest operation still held keeps its text */
+static size_t live_payload_start(const History *history)
+{
+    if (history->op_start < history->op_count) {
+        return history->ops[history->op_start].payload;
+    }
+    return history->payload_base + history->payload_len;
+}
+
+static size_t used_bytes(const History *history)
+{
+    return (history->op_count - history->op_start) * sizeof(HistoryOp) +
+           (history->payload_base + history->payload_len - live_payload_start(history));
+}
+
+/* Moves the live operations and text to the front once half is dead */
+static void compact(History *history)
+{
+    if (history->op_start > 0 && history->op_start >= history->op_count / 2) {
+        memmove(history->ops, history->ops + history->op_start,
+                (history->op_count - history->op_start) * sizeof(HistoryOp));
+        history->op_count -= history->op_start;
+        history->cursor -= history->op_start;
+        history->op_start = 0;
+    }
+
+    size_t dead = live_payload_start(history) - history->payload_base;
+    if (dead > 0 && dead >= history->payload_len / 2) {
+        memmove(history->payload, history->payload + dead, history->payload_len - dead);
+        history->payload_base += dead;
+        history->payload_len -= dead;
+    }
+}
+
+/* Drops the oldest applied steps until the log fits its limit */
+static void enforce_limit(History *history)
+{
+    while (used_bytes(history) > history->limit) {
+        size_t end = history->op_start + 1;
+        while (end < history->op_count && !history->ops[end].starts_group) {
+            end++;
+        }
+        /* Never drop a step that is undone, or the only one left */
+        if (end > history->cursor || end >= history->op_count) {
+            break;
+        }
+        history->op_start = end;
+    }
+    compact(history);
+}
+
+void history_set_limit(History *history, size_t limit)
+{
+    if (!history) {
+        return;
+    }
+    history->limit = limit;
+    enforce_limit(history);
+}
+
+void history_begin_group(History *history)
+{
+    if (!history) {
+        return;
+    }
+    if (history->group_depth++ == 0) {
+        history->group_started = 0;
+        history->can_merge = 0;
+    }
+}
+
+void history_end_group(History *history)
+{
+    if (!history || history->group_depth == 0) {
+        return;
+    }
+    if (--history->group_depth == 0) {
+        history->group_started = 0;
+        history->can_merge = 0;
+    }
+}
+
+/*
+ * Makes room for one more operation with `text_len` bytes of text, staged
+ * after any undone steps so they survive an edit that fails. Returns a
+ * pointer to where the text goes, or NULL when out of memory.
+ */
+static char *reserve(History *history, size_t text_len)
+{
+    if (history->op_count == history->op_capacity) {
+        size_t capacity = history->op_capacity ? history->op_capacity * 2 : HISTORY_INITIAL_OPS;
+        HistoryOp *ops = (HistoryOp *)realloc(history->ops, capacity * sizeof(HistoryOp));
+        if (!ops) {
+            return NULL;
+        }
+        history->ops = ops;
+        history->op_capacity = capacity;
+    }
+
+    if (history->payload_capacity - history->payload_len < text_len) {
+        size_t capacity = history->payload_capacity ? history->payload_capacity : HISTORY_INITIAL_PAYLOAD;
+        while (capacity - history->payload_len < text_len) {
+            capacity *= 2;
+        }
+        char *payload = (char *)realloc(history->payload, capacity);
+        if (!payload) {
+            return NULL;
+        }
+        history->payload = payload;
+        history->payload_capacity = capacity;
+    }
+
+    return history->payload + history->payload_len;
+}
+
+static int joins_last(const History *history, HistoryKind kind, size_t line)
+{
+    if (!history->merge_adjacent || !history->can_merge || history->op_count == history->op_start) {
+        return 0;
+    }
+
+    const HistoryOp *last = &history->ops[history->op_count - 1];
+    if (last->kind != kind) {
+        return 0;
+    }
+    switch (kind) {
+    case HISTORY_INSERT:
+        return line == last->line + 1;
+    case HISTORY_DELETE:
+        return line == last->line || line + 1 == last->line;
+    case HISTORY_REPLACE:
+        return line == last->line;
+    default:
+        return 0; /* a block edit is a step of its own */
+    }
+}
+
+/* Appends an operation whose text was already written by `reserve` */
+static void commit(History *history, HistoryKind kind, size_t line, size_t old_len, size_t new_len)
+{
+    /* The edit went in, so the undone steps it replaces go now */
+    if (history->cursor < history->op_count) {
+        size_t keep = history->ops[history->cursor].payload - history->payload_base;
+        memmove(history->payload + keep, history->payload + history->payload_len, old_len + 1 + new_len + 1);
+        history->payload_len = keep;
+        history->op_count = history->cursor;
+    }
+
+    HistoryOp *op = &history->ops[history->op_count];
+    op->line = line;
+    op->payload = history->payload_base + history->payload_len;
+    op->old_len = old_len;
+    op->new_len = new_len;
+    op->kind = (unsigned char)kind;
+
+    if (history->group_depth > 0) {
+        op->starts_group = !history->group_started;
+        history->group_started = 1;
+    } else {
+        op->starts_group = !joins_last(history, kind, line);
+    }
+
+    history->payload_len += old_len + 1 + new_len + 1;
+    history->op_count++;
+    history->cursor = history->op_count;
+    history->can_merge = history->group_depth == 0;
+    enforce_limit(history);
+}
+
+/* Stores `old` then `new` (either may be NULL), each NUL-terminated */
+static char *stage_text(History *history, const char *old, size_t old_len, const char *new_text, size_t new_len)
+{
+    char *at = reserve(history, old_len + 1 + new_len + 1);
+    if (!at) {
+        return NULL;
+    }
+    if (old_len > 0) {
+        memcpy(at, old, old_len);
+    }
+    at[old_len] = '\0';
+    if (new_len > 0) {
+        memcpy(at + old_len + 1, new_text, new_len);
+    }
+    at[old_len + 1 + new_len] = '\0';
+    return at;
+}
+
+int history_insert_line(History *history, TextBuffer *buffer, size_t index, const char *text)
+{
+    return history_insert_line_n(history, buffer, index, text, text ? strlen(text) : 0);
+}
+
+int history_insert_line_n(History *history, TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+    if (!history || !buffer || (!text && len > 0)) {
+        return -1;
+    }
+
+    if (!stage_text(history, NULL, 0, text, len) || buffer_insert_line_n(buffer, index, text, len) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_INSERT, index, 0, len);
+    return 0;
+}
+
+int history_delete_line(History *history, TextBuffer *buffer, size_t index)
+{
+    if (!history || !buffer) {
+        return -1;
+    }
+
+    size_t len = 0;
+    const char *old = buffer_get_line_n(buffer, index, &len);
+    if (!old) {
+        return -1;
+    }
+
+    if (!stage_text(history, old, len, NULL, 0) || buffer_delete_line(buffer, index) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_DELETE, index, len, 0);
+    return 0;
+}
+
+int history_replace_line(History *history, TextBuffer *buffer, size_t index, const char *text)
+{
+    return history_replace_line_n(history, buffer, index, text, text ? strlen(text) : 0);
+}
+
+int history_replace_line_n(History *history, TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+    if (!history || !buffer || (!text && len > 0)) {
+        return -1;
+    }
+
+    size_t old_len = 0;
+    const char *old = buffer_get_line_n(buffer, index, &old_len);
+    if (!old) {
+        return -1;
+    }
+
+    if (!stage_text(history, old, old_len, text, len) || buffer_replace_line_n(buffer, index, text, len) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_REPLACE, index, old_len, len);
+    return 0;
+}
+
+int history_delete_lines(History *history, TextBuffer *buffer, size_t index, size_t count)
+{
+    if (!history || !buffer || index > buffer->count || count > buffer->count - index) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    /* The block as saved, newlines included; the last one becomes the terminator */
+    size_t bytes = buffer_line_offset(buffer, index + count) - buffer_line_offset(buffer, index);
+    char *at = reserve(history, bytes + 1);
+    if (!at) {
+        return -1;
+    }
+
+    BufferSpan spans[64];
+    size_t line = index;
+    size_t copied = 0;
+    size_t n;
+    while ((n = buffer_get_spans(buffer, &line, index + count, spans, 64)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            memcpy(at + copied, spans[i].data, spans[i].len);
+            copied += spans[i].len;
+        }
+    }
+    at[bytes - 1] = '\0';
+    at[bytes] = '\0';
+
+    if (copied != bytes || buffer_delete_lines(buffer, index, count) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_DELETE_LINES, index, bytes - 1, 0);
+    return 0;
+}
+
+int history_insert_lines(History *history, TextBuffer *buffer, size_t index, const char *text, size_t len)
+{
+    if (!history || !buffer || (!text && len > 0)) {
+        return -1;
+    }
+
+    if (!stage_text(history, NULL, 0, text, len) || buffer_insert_lines(buffer, index, text, len) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_INSERT_LINES, index, 0, len);
+    return 0;
+}
+
+/* Moves and copies store their line count and destination as their text */
+static int stage_block(History *history, size_t count, size_t dest)
+{
+    size_t block[2] = { count, dest };
+    return stage_text(history, (const char *)block, sizeof(block), NULL, 0) ? 0 : -1;
+}
+
+int history_move_lines(History *history, TextBuffer *buffer, size_t index, size_t count, size_t dest)
+{
+    if (!history || !buffer) {
+        return -1;
+    }
+    if (count == 0 || dest == index) {
+        return buffer_move_lines(buffer, index, count, dest);
+    }
+
+    if (stage_block(history, count, dest) != 0 || buffer_move_lines(buffer, index, count, dest) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_MOVE_LINES, index, 2 * sizeof(size_t), 0);
+    return 0;
+}
+
+int history_copy_lines(History *history, TextBuffer *buffer, size_t index, size_t count, size_t dest)
+{
+    if (!history || !buffer) {
+        return -1;
+    }
+    if (count == 0) {
+        return buffer_copy_lines(buffer, index, count, dest);
+    }
+
+    if (stage_block(history, count, dest) != 0 || buffer_copy_lines(buffer, index, count, dest) != 0) {
+        return -1;
+    }
+    commit(history, HISTORY_COPY_LINES, index, 2 * sizeof(size_t), 0);
+    return 0;
+}
+
+typedef struct {
+    History *history;
+    const TextBuffer *buffer;
+    size_t old_len;
+    size_t new_len;
+    int staged;
+} ReplaceAllRecord;
+
+/*
+ * Stages a replace-all before it goes in: a count, then the line number and
+ * old and new lengths of each changed line, then the old texts; the new
+ * texts follow as the added text.
+ */
+static int stage_replace_all(void *context, const BufferLineEdit *edits, size_t count)
+{
+    ReplaceAllRecord *record = (ReplaceAllRecord *)context;
+    size_t header = (1 + 3 * count) * sizeof(size_t);
+    size_t old_total = 0;
+    size_t new_total = 0;
+    for (size_t e = 0; e < count; ++e) {
+        size_t len = 0;
+        buffer_get_line_n(record->buffer, edits[e].line, &len);
+        old_total += len;
+        new_total += edits[e].len;
+    }
+
+    char *at = reserve(record->history, header + old_total + 1 + new_total + 1);
+    if (!at) {
+        return -1;
+    }
+    memcpy(at, &count, sizeof(size_t));
+    char *table = at + sizeof(size_t);
+    char *old_text = at + header;
+    char *new_text = old_text + old_total + 1;
+    for (size_t e = 0; e < count; ++e) {
+        size_t len = 0;
+        const char *old = buffer_get_line_n(record->buffer, edits[e].line, &len);
+        size_t entry[3] = { edits[e].line, len, edits[e].len };
+        memcpy(table + e * sizeof(entry), entry, sizeof(entry));
+        memcpy(old_text, old, len);
+        old_text += len;
+        if (edits[e].len > 0) {
+            memcpy(new_text, edits[e].text, edits[e].len);
+        }
+        new_text += edits[e].len;
+    }
+    *old_text = '\0';
+    *new_text = '\0';
+
+    record->old_len = header + old_total;
+    record->new_len = new_total;
+    record->staged = 1;
+    return 0;
+}
+
+int history_replace_all(History *history, TextBuffer *buffer, BufferSearch *search, const char *replacement,
+                        size_t len, size_t *out_count)
+{
+    if (!history || !buffer) {
+        return -1;
+    }
+
+    ReplaceAllRecord record = { history, buffer, 0, 0, 0 };
+    if (buffer_replace_all(buffer, search, replacement, len, stage_replace_all, &record, out_count) != 0) {
+        return -1;
+    }
+    if (record.staged) {
+        commit(history, HISTORY_REPLACE_ALL, 0, record.old_len, record.new_len);
+    }
+    return 0;
+}
+
+/* Puts back the old or new texts of a replace-all's lines in one batch */
+static int apply_replace_all(TextBuffer *buffer, const char *old, const char *new_text, int forward)
+{
+    size_t count = 0;
+    memcpy(&count, old, sizeof(size_t));
+    const char *table = old + sizeof(size_t);
+    const char *text = forward ? new_text : table + 3 * count * sizeof(size_t);
+
+    BufferLineEdit *edits = (BufferLineEdit *)malloc(count * sizeof(BufferLineEdit));
+    if (!edits) {
+        return -1;
+    }
+    for (size_t e = 0; e < count; ++e) {
+        size_t entry[3];
+        memcpy(entry, table + e * sizeof(entry), sizeof(entry));
+        edits[e].line = entry[0];
+        edits[e].text = text;
+        edits[e].len = forward ? entry[2] : entry[1];
+        text += edits[e].len;
+    }
+
+    int rc = buffer_replace_lines(buffer, edits, count);
+    free(edits);
+    return rc;
+}
+
+/* Lines in a block's text, which joins them with '\n' */
+static size_t block_lines(const char *text, size_t len)
+{
+    size_t lines = 1;
+    const char *end = text + len;
+    while ((text = memchr(text, '\n', (size_t)(end - text))) != NULL) {
+        lines++;
+        text++;
+    }
+    return lines;
+}
+
+static int apply(const History *history, TextBuffer *buffer, const HistoryOp *op, int forward)
+{
+    const char *old = op_text(history, op);
+    const char *new_text = old + op->old_len + 1;
+    size_t block[2] = { 0, 0 };
+
+    switch ((HistoryKind)op->kind) {
+    case HISTORY_INSERT_LINES:
+        return forward ? buffer_insert_lines(buffer, op->line, new_text, op->new_len)
+                       : buffer_delete_lines(buffer, op->line, block_lines(new_text, op->new_len));
+    case HISTORY_DELETE_LINES:
+        return forward ? buffer_delete_lines(buffer, op->line, block_lines(old, op->old_len))
+                       : buffer_insert_lines(buffer, op->line, old, op->old_len);
+    case HISTORY_MOVE_LINES:
+        memcpy(block, old, sizeof(block));
+        return forward ? buffer_move_lines(buffer, op->line, block[0], block[1])
+                       : buffer_move_lines(buffer, block[1], block[0], op->line);
+    case HISTORY_COPY_LINES:
+        memcpy(block, old, sizeof(block));
+        return forward ? buffer_copy_lines(buffer, op->line, block[0], block[1])
+                       : buffer_delete_lines(buffer, block[1], block[0]);
+    case HISTORY_REPLACE_ALL:
+        return apply_replace_all(buffer, old, new_text, forward);
+    case HISTORY_INSERT:
+        return forward ? buffer_insert_line_n(buffer, op->line, new_text, op->new_len)
+                       : buffer_delete_line(buffer, op->line);
+    case HISTORY_DELETE:
+        return forward ? buffer_delete_line(buffer, op->line)
+                       : buffer_insert_line_n(buffer, op->line, old, op->old_len);
+    default:
+        return forward ? buffer_replace_line_n(buffer, op->line, new_text, op->new_len)
+                       : buffer_replace_line_n(buffer, op->line, old, op->old_len);
+    }
+}
+
+int history_undo(History *history, TextBuffer *buffer)
+{
+    if (!history || !buffer) {
+        return -1;
+    }
+    history->can_merge = 0;
+    if (history->cursor == history->op_start) {
+        return 0;
+    }
+
+    /* Later operations of a step depend on earlier ones, so go backwards */
+    size_t end = history->cursor;
+    for (;;) {
+        const HistoryOp *op = &history->ops[history->cursor - 1];
+        if (apply(history, buffer, op, 0) != 0) {
+            /* Redo what this step already undid rather than leave half of it */
+            while (history->cursor < end && apply(history, buffer, &history->ops[history->cursor], 1) == 0) {
+                history->cursor++;
+            }
+            return -1;
+        }
+        history->cursor--;
+        if (op->starts_group || history->cursor == history->op_start) {
+            return 1;
+        }
+    }
+}
+
+int history_redo(History *history, TextBuffer *buffer)
+{
+    if (!history || !buffer) {
+        return -1;
+    }
+    history->can_merge = 0;
+    if (history->cursor == history->op_count) {
+        return 0;
+    }
+
+    size_t start = history->cursor;
+    do {
+        if (apply(history, buffer, &history->ops[history->cursor], 1) != 0) {
+            /* Undo what this step already redid rather than leave half of it */
+            while (history->cursor > start && apply(history, buffer, &history->ops[history->cursor - 1], 0) == 0) {
+                history->cursor--;
+            }
+            return -1;
+        }
+        history->cursor++;
+    } while (history->cursor < history->op_count && !history->ops[history->cursor].starts_group);
+    return 1;
+}
+
+void history_stats(const History *history, HistoryStats *stats)
+{
+    if (!stats) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    if (!history) {
+        return;
+    }
+
+    stats->ops = history->op_count - history->op_start;
+    for (size_t i = history->op_start; i < history->op_count; ++i) {
+        if (history->ops[i].starts_group || i == history->op_start) {
+            if (i < history->cursor) {
+                stats->undo_steps++;
+            } else {
+                stats->redo_steps++;
+            }
+        }
+    }
+    stats->op_bytes = stats->ops * sizeof(HistoryOp);
+    stats->payload_bytes = used_bytes(history) - stats->op_bytes;
+    stats->limit = history->limit;
+}
@@ -3,39 +3,130 @@
  * File: main.c
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "editor.h"
+#include "history.h"
+#include "parallel.h"
+#include "stats.h"
 
 #define FILENAME_MAX_LEN 260
 
 static void print_usage(const char *prog_name)
 {
-    printf("Usage: %s [file]\n", prog_name);
+    printf("Usage: %s [-j threads] [-u undo-megabytes] [-m page-megabytes] [-p] [-s] [-b script] [file]\n", prog_name);
+    printf("  -m MB      file pages a huge file keeps in memory (default %zu)\n", EDITOR_PAGE_BUDGET >> 20);
+    printf("  -p         save by patching the file in place (faster; a crash mid-save corrupts it)\n");
+    printf("  -s         collect load/save/search statistics from the start (menu item 13)\n");
+    printf("  -b script  apply the edit commands in script ('-' for stdin) and exit\n");
+}
+
+/* Batch mode: no menu, no prompts, just the script's edits */
+static int run_script(const char *script_name, const char *filename, int save_in_place)
+{
+    FILE *script = strcmp(script_name, "-") == 0 ? stdin : fopen(script_name, "r");
+    if (!script) {
+        fprintf(stderr, "Error: cannot open script '%s'.\n", script_name);
+        return 1;
+    }
+
+    EditorState editor;
+    EditorScriptResult result;
+    editor_init_with(&editor, filename, 1);
+    editor.save_in_place = save_in_place;
+    int rc = editor_run_script(&editor, script, &result);
+    if (rc != 0) {
+        fprintf(stderr, "%s:%zu: %s\n", script_name, result.line, result.error);
+    }
+
+    if (script != stdin) {
+        fclose(script);
+    }
+    editor_free(&editor);
+    return rc == 0 ? 0 : 1;
 }
 
 int main(int argc, char *argv[])
 {
     char filename[FILENAME_MAX_LEN] = {0};
+    int has_filename = 0;
+    size_t threads = 0;
+    size_t undo_limit = HISTORY_DEFAULT_LIMIT;
+    size_t page_budget = EDITOR_PAGE_BUDGET;
+    const char *script_name = NULL;
+    int save_in_place = 0;
 
-    if (argc > 2) {
-        fprintf(stderr, "Error: too many arguments.\n");
-        print_usage(argv[0]);
-        return 1;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            char *endptr = NULL;
+            unsigned long value = (i + 1 < argc) ? strtoul(argv[++i], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || value == 0 || value > PARALLEL_MAX_THREADS) {
+                fprintf(stderr, "Error: -j expects a thread count between 1 and %d.\n", PARALLEL_MAX_THREADS);
+                print_usage(argv[0]);
+                return 1;
+            }
+            threads = (size_t)value;
+        } else if (strcmp(argv[i], "-u") == 0) {
+            char *endptr = NULL;
+            unsigned long value = (i + 1 < argc) ? strtoul(argv[++i], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || value > 1024 * 1024) {
+                fprintf(stderr, "Error: -u expects an undo memory limit in megabytes.\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            undo_limit = (size_t)value * 1024 * 1024;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            char *endptr = NULL;
+            unsigned long value = (i + 1 < argc) ? strtoul(argv[++i], &endptr, 10) : 0;
+            if (!endptr || *endptr != '\0' || value == 0 || value > 1024 * 1024) {
+                fprintf(stderr, "Error: -m expects a page budget in megabytes.\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            page_budget = (size_t)value * 1024 * 1024;
+        } else if (strcmp(argv[i], "-p") == 0) {
+            save_in_place = 1;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            stats_set_enabled(1);
+        } else if (strcmp(argv[i], "-b") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: -b expects a script file.\n");
+                print_usage(argv[0]);
+                return 1;
+            }
+            script_name = argv[++i];
+        } else if (!has_filename) {
+            if (strlen(argv[i]) >= FILENAME_MAX_LEN) {
+                fprintf(stderr, "Error: file name is too long (at most %d bytes).\n", FILENAME_MAX_LEN - 1);
+                return 1;
+            }
+            memcpy(filename, argv[i], strlen(argv[i]) + 1);
+            has_filename = 1;
+        } else {
+            fprintf(stderr, "Error: too many arguments.\n");
+            print_usage(argv[0]);
+            return 1;
+        }
     }
 
-    if (argc == 2) {
-        strncpy(filename, argv[1], FILENAME_MAX_LEN - 1);
-        filename[FILENAME_MAX_LEN - 1] = '\0';
+    if (script_name) {
+        return run_script(script_name, has_filename ? filename : NULL, save_in_place);
     }
 
     EditorState editor;
-    editor_init(&editor, (argc == 2) ? filename : NULL);
+    editor_init(&editor, has_filename ? filename : NULL);
+    if (threads > 0) {
+        editor.search_threads = threads;
+    }
+    history_set_limit(&editor.history, undo_limit);
+    editor.page_budget = page_budget;
+    editor.save_in_place = save_in_place;
     editor_run(&editor);
     editor_free(&editor);
 
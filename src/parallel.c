@@ -0,0 +1,147 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: parallel.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+typedef struct {
+    ParallelTaskFn task;
+    void *context;
+    size_t parts;
+    atomic_size_t next;
+} ParallelJob;
+
+/*
+ * Workers are started on first use and then sleep between jobs, so a run
+ * costs a wakeup instead of a thread creation per worker. One run uses
+ * the pool at a time; a run that finds it busy (another thread's, or a
+ * task's own nested run) does its parts on the calling thread.
+ */
+static struct {
+    pthread_mutex_t run_lock;   /* held by the run that owns the workers */
+    pthread_mutex_t lock;       /* guards the fields below */
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    size_t started;             /* workers running, under run_lock */
+    size_t generation;          /* bumped for every posted job */
+    ParallelJob *job;           /* NULL once the poster stops taking helpers */
+    size_t wanted;
+    size_t claimed;
+    size_t finished;
+} pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+           PTHREAD_COND_INITIALIZER, 0, 0, NULL, 0, 0, 0 };
+
+static void run_parts(ParallelJob *job)
+{
+    for (;;) {
+        size_t part = atomic_fetch_add(&job->next, 1);
+        if (part >= job->parts) {
+            break;
+        }
+        job->task(job->context, part);
+    }
+}
+
+static void *worker_main(void *arg)
+{
+    size_t seen = (size_t)(uintptr_t)arg;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        seen = pool.generation;
+        if (!pool.job || pool.claimed >= pool.wanted) {
+            continue;
+        }
+
+        ParallelJob *job = pool.job;
+        pool.claimed++;
+        pthread_mutex_unlock(&pool.lock);
+        run_parts(job);
+        pthread_mutex_lock(&pool.lock);
+        if (++pool.finished == pool.claimed) {
+            pthread_cond_signal(&pool.done);
+        }
+    }
+    return NULL;
+}
+
+size_t parallel_default_threads(void)
+{
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online < 1) {
+        return 1;
+    }
+    if (online > PARALLEL_MAX_THREADS) {
+        return PARALLEL_MAX_THREADS;
+    }
+    return (size_t)online;
+}
+
+void parallel_run(size_t threads, size_t parts, ParallelTaskFn task, void *context)
+{
+    if (!task || parts == 0) {
+        return;
+    }
+
+    if (threads > parts) {
+        threads = parts;
+    }
+    if (threads > PARALLEL_MAX_THREADS) {
+        threads = PARALLEL_MAX_THREADS;
+    }
+
+    ParallelJob job;
+    job.task = task;
+    job.context = context;
+    job.parts = parts;
+    atomic_init(&job.next, 0);
+
+    if (threads <= 1 || pthread_mutex_trylock(&pool.run_lock) != 0) {
+        run_parts(&job);
+        return;
+    }
+
+    while (pool.started + 1 < threads) {
+        pthread_t worker;
+        if (pthread_create(&worker, NULL, worker_main, (void *)(uintptr_t)pool.generation) != 0) {
+            break; /* the workers already running pick up the slack */
+        }
+        pthread_detach(worker);
+        pool.started++;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.job = &job;
+    pool.wanted = threads - 1;
+    pool.claimed = 0;
+    pool.finished = 0;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_parts(&job);
+
+    /* Every part is claimed; wait only for helpers still inside one */
+    pthread_mutex_lock(&pool.lock);
+    pool.job = NULL;
+    while (pool.finished < pool.claimed) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    pthread_mutex_unlock(&pool.run_lock);
+}
@@ -0,0 +1,1237 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: pattern.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#include "pattern.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PATTERN_MAX_INSTS 4096
+#define PATTERN_MAX_REPEAT 1000
+#define DFA_MAX_STATES 1024
+#define DFA_BUCKETS 2048
+#define DFA_UNKNOWN (-1)
+
+/* ---- Syntax tree ---- */
+
+typedef enum {
+    NODE_EMPTY,
+    NODE_CHAR,
+    NODE_CLASS,
+    NODE_BOL,
+    NODE_EOL,
+    NODE_CAT,
+    NODE_ALT,
+    NODE_REPEAT
+} NodeType;
+
+typedef struct {
+    NodeType type;
+    int left;           /* CAT, ALT, REPEAT */
+    int right;          /* CAT, ALT */
+    int min;            /* REPEAT */
+    int max;            /* REPEAT, -1 when unbounded */
+    int value;          /* CHAR byte or CLASS index */
+} Node;
+
+typedef struct {
+    unsigned char bits[32];
+} ByteClass;
+
+/* ---- Program ---- */
+
+typedef enum {
+    OP_CHAR,
+    OP_CLASS,
+    OP_SPLIT,
+    OP_JMP,
+    OP_BOL,
+    OP_EOL,
+    OP_MATCH
+} OpCode;
+
+typedef struct {
+    OpCode op;
+    int x;              /* CHAR byte, CLASS index, or jump target */
+    int y;              /* second SPLIT target */
+} Inst;
+
+/* ---- Lazy DFA ---- */
+
+typedef struct {
+    int *set;           /* sorted NFA instructions */
+    int set_len;
+    unsigned hash;
+    int chain;          /* next state in the same hash bucket */
+    int accept;         /* a match ends before the next byte */
+    int accept_at_end;  /* a match ends here if this is the end of the line */
+    int next[256];
+} DfaState;
+
+typedef struct {
+    DfaState *states;
+    int count;
+    int buckets[DFA_BUCKETS];
+    int start[2];       /* start state, indexed by "at beginning of line" */
+    int unanchored;     /* every step may also begin a new match */
+} Dfa;
+
+struct Pattern {
+    char *source;
+    Inst *insts;
+    int inst_count;
+    ByteClass *classes;
+    int class_count;
+    char *literal;
+    size_t literal_len;
+    Dfa search;         /* unanchored: does the line match at all */
+    Dfa anchored;       /* where a match that starts here ends */
+    int *stack;
+    int *seen;
+    int seen_gen;
+    int *scratch;
+    int *thread_pc;     /* two lists of NFA threads for find_start */
+    size_t *thread_start;
+    int cached;         /* owned by a cache entry */
+    int pins;           /* pattern_cache_get calls not yet released */
+};
+
+/* ---- Parser ---- */
+
+typedef struct {
+    const char *p;
+    Node *nodes;
+    int node_count;
+    int node_capacity;
+    ByteClass *classes;
+    int class_count;
+    int class_capacity;
+    const char *error;
+} Parser;
+
+static int new_node(Parser *ps, NodeType type)
+{
+    if (ps->node_count == ps->node_capacity) {
+        int capacity = ps->node_capacity ? ps->node_capacity * 2 : 32;
+        Node *nodes = (Node *)realloc(ps->nodes, (size_t)capacity * sizeof(Node));
+        if (!nodes) {
+            ps->error = "out of memory";
+            return -1;
+        }
+        ps->nodes = nodes;
+        ps->node_capacity = capacity;
+    }
+
+    Node *node = &ps->nodes[ps->node_count];
+    memset(node, 0, sizeof(*node));
+    node->type = type;
+    node->left = -1;
+    node->right = -1;
+    return ps->node_count++;
+}
+
+static int new_class(Parser *ps)
+{
+    if (ps->class_count == ps->class_capacity) {
+        int capacity = ps->class_capacity ? ps->class_capacity * 2 : 8;
+        ByteClass *classes = (ByteClass *)realloc(ps->classes, (size_t)capacity * sizeof(ByteClass));
+        if (!classes) {
+            ps->error = "out of memory";
+            return -1;
+        }
+        ps->classes = classes;
+        ps->class_capacity = capacity;
+    }
+
+    memset(&ps->classes[ps->class_count], 0, sizeof(ByteClass));
+    return ps->class_count++;
+}
+
+static void class_set(ByteClass *cls, int c)
+{
+    cls->bits[c >> 3] |= (unsigned char)(1u << (c & 7));
+}
+
+static int class_has(const ByteClass *cls, int c)
+{
+    return (cls->bits[c >> 3] >> (c & 7)) & 1;
+}
+
+static void class_set_range(ByteClass *cls, int lo, int hi)
+{
+    for (int c = lo; c <= hi; ++c) {
+        class_set(cls, c);
+    }
+}
+
+static void class_negate(ByteClass *cls)
+{
+    for (size_t i = 0; i < sizeof(cls->bits); ++i) {
+        cls->bits[i] = (unsigned char)~cls->bits[i];
+    }
+}
+
+/* Adds the members of a \d \w \s style escape; returns 0 if `c` is not one */
+static int class_add_shorthand(ByteClass *cls, char c)
+{
+    ByteClass members;
+    memset(&members, 0, sizeof(members));
+
+    switch (c) {
+    case 'd':
+    case 'D':
+        class_set_range(&members, '0', '9');
+        break;
+    case 'w':
+    case 'W':
+        class_set_range(&members, 'a', 'z');
+        class_set_range(&members, 'A', 'Z');
+        class_set_range(&members, '0', '9');
+        class_set(&members, '_');
+        break;
+    case 's':
+    case 'S':
+        class_set(&members, ' ');
+        class_set_range(&members, '\t', '\r');
+        break;
+    default:
+        return 0;
+    }
+
+    if (c == 'D' || c == 'W' || c == 'S') {
+        class_negate(&members);
+    }
+    for (size_t i = 0; i < sizeof(cls->bits); ++i) {
+        cls->bits[i] |= members.bits[i];
+    }
+    return 1;
+}
+
+static int escaped_byte(char c)
+{
+    switch (c) {
+    case 't':
+        return '\t';
+    case 'n':
+        return '\n';
+    case 'r':
+        return '\r';
+    case 'f':
+        return '\f';
+    case 'v':
+        return '\v';
+    default:
+        return (unsigned char)c;
+    }
+}
+
+static int parse_alt(Parser *ps);
+
+static int parse_class(Parser *ps)
+{
+    int index = new_class(ps);
+    if (index < 0) {
+        return -1;
+    }
+
+    int negate = 0;
+    if (*ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+
+    int first = 1;
+    while (*ps->p && (*ps->p != ']' || first)) {
+        ByteClass *cls = &ps->classes[index];
+        int lo = (unsigned char)*ps->p++;
+        first = 0;
+
+        if (lo == '\\' && *ps->p) {
+            char e = *ps->p++;
+            if (class_add_shorthand(cls, e)) {
+                continue;
+            }
+            lo = escaped_byte(e);
+        }
+
+        int hi = lo;
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+            ps->p++;
+            hi = (unsigned char)*ps->p++;
+            if (hi == '\\' && *ps->p) {
+                hi = escaped_byte(*ps->p++);
+            }
+            if (hi < lo) {
+                ps->error = "invalid range in character class";
+                return -1;
+            }
+        }
+        class_set_range(cls, lo, hi);
+    }
+
+    if (*ps->p != ']') {
+        ps->error = "missing ]";
+        return -1;
+    }
+    ps->p++;
+
+    if (negate) {
+        class_negate(&ps->classes[index]);
+    }
+
+    int node = new_node(ps, NODE_CLASS);
+    if (node >= 0) {
+        ps->nodes[node].value = index;
+    }
+    return node;
+}
+
+static int parse_atom(Parser *ps)
+{
+    char c = *ps->p++;
+    int node = -1;
+
+    switch (c) {
+    case '(':
+        node = parse_alt(ps);
+        if (node < 0) {
+            return -1;
+        }
+        if (*ps->p != ')') {
+            ps->error = "missing )";
+            return -1;
+        }
+        ps->p++;
+        return node;
+    case '[':
+        return parse_class(ps);
+    case '.': {
+        int index = new_class(ps);
+        if (index < 0) {
+            return -1;
+        }
+        class_set_range(&ps->classes[index], 0, 255);
+        node = new_node(ps, NODE_CLASS);
+        if (node >= 0) {
+            ps->nodes[node].value = index;
+        }
+        return node;
+    }
+    case '^':
+        return new_node(ps, NODE_BOL);
+    case '$':
+        return new_node(ps, NODE_EOL);
+    case '*':
+    case '+':
+    case '?':
+        ps->error = "nothing to repeat";
+        return -1;
+    case '\\':
+        if (*ps->p == '\0') {
+            ps->error = "trailing backslash";
+            return -1;
+        }
+        c = *ps->p++;
+        if (strchr("dDwWsS", c)) {
+            int index = new_class(ps);
+            if (index < 0) {
+                return -1;
+            }
+            class_add_shorthand(&ps->classes[index], c);
+            node = new_node(ps, NODE_CLASS);
+            if (node >= 0) {
+                ps->nodes[node].value = index;
+            }
+            return node;
+        }
+        node = new_node(ps, NODE_CHAR);
+        if (node >= 0) {
+            ps->nodes[node].value = escaped_byte(c);
+        }
+        return node;
+    default:
+        node = new_node(ps, NODE_CHAR);
+        if (node >= 0) {
+            ps->nodes[node].value = (unsigned char)c;
+        }
+        return node;
+    }
+}
+
+static int parse_number(Parser *ps, int *out)
+{
+    if (*ps->p < '0' || *ps->p > '9') {
+        return -1;
+    }
+    int value = 0;
+    while (*ps->p >= '0' && *ps->p <= '9') {
+        value = value * 10 + (*ps->p++ - '0');
+        if (value > PATTERN_MAX_REPEAT) {
+            return -1;
+        }
+    }
+    *out = value;
+    return 0;
+}
+
+/* Parses {m}, {m,} or {m,n}; leaves the input untouched if it is not one */
+static int parse_braces(Parser *ps, int *min, int *max)
+{
+    const char *start = ps->p;
+    ps->p++;
+
+    if (parse_number(ps, min) != 0) {
+        ps->p = start;
+        return 0;
+    }
+    *max = *min;
+    if (*ps->p == ',') {
+        ps->p++;
+        *max = -1;
+        if (*ps->p != '}' && parse_number(ps, max) != 0) {
+            ps->p = start;
+            return 0;
+        }
+    }
+    if (*ps->p != '}' || (*max >= 0 && *max < *min)) {
+        ps->p = start;
+        return 0;
+    }
+    ps->p++;
+    return 1;
+}
+
+static int parse_repeat(Parser *ps)
+{
+    int node = parse_atom(ps);
+
+    while (node >= 0) {
+        int min = 0;
+        int max = -1;
+        char c = *ps->p;
+
+        if (c == '*') {
+            ps->p++;
+        } else if (c == '+') {
+            ps->p++;
+            min = 1;
+        } else if (c == '?') {
+            ps->p++;
+            max = 1;
+        } else if (c != '{' || !parse_braces(ps, &min, &max)) {
+            break;
+        }
+
+        int repeat = new_node(ps, NODE_REPEAT);
+        if (repeat < 0) {
+            return -1;
+        }
+        ps->nodes[repeat].left = node;
+        ps->nodes[repeat].min = min;
+        ps->nodes[repeat].max = max;
+        node = repeat;
+    }
+    return node;
+}
+
+static int parse_concat(Parser *ps)
+{
+    int node = new_node(ps, NODE_EMPTY);
+
+    while (node >= 0 && *ps->p && *ps->p != '|' && *ps->p != ')') {
+        int next = parse_repeat(ps);
+        if (next < 0) {
+            return -1;
+        }
+        if (ps->nodes[node].type == NODE_EMPTY) {
+            node = next;
+            continue;
+        }
+        int cat = new_node(ps, NODE_CAT);
+        if (cat < 0) {
+            return -1;
+        }
+        ps->nodes[cat].left = node;
+        ps->nodes[cat].right = next;
+        node = cat;
+    }
+    return node;
+}
+
+static int parse_alt(Parser *ps)
+{
+    int node = parse_concat(ps);
+
+    while (node >= 0 && *ps->p == '|') {
+        ps->p++;
+        int next = parse_concat(ps);
+        if (next < 0) {
+            return -1;
+        }
+        int alt = new_node(ps, NODE_ALT);
+        if (alt < 0) {
+            return -1;
+        }
+        ps->nodes[alt].left = node;
+        ps->nodes[alt].right = next;
+        node = alt;
+    }
+    return node;
+}
+
+/* ---- Required literal ---- */
+
+typedef struct {
+    char *text;
+    size_t len;
+    size_t capacity;
+} Literal;
+
+static void literal_keep_longer(Literal *best, const char *text, size_t len)
+{
+    if (len <= best->len) {
+        return;
+    }
+    char *copy = (char *)realloc(best->text, len + 1);
+    if (!copy) {
+        return; /* the literal is only a hint */
+    }
+    memcpy(copy, text, len);
+    copy[len] = '\0';
+    best->text = copy;
+    best->len = len;
+}
+
+/*
+ * Collects runs of plain characters along a concatenation. Everything in a
+ * concatenation must match, so each run is a substring of every match.
+ */
+static void collect_literals(const Parser *ps, int node, Literal *run, Literal *best)
+{
+    const Node *n = &ps->nodes[node];
+
+    if (n->type == NODE_CAT) {
+        collect_literals(ps, n->left, run, best);
+        collect_literals(ps, n->right, run, best);
+        return;
+    }
+
+    if (n->type == NODE_CHAR) {
+        if (run->len + 1 > run->capacity) {
+            size_t capacity = run->capacity ? run->capacity * 2 : 16;
+            char *text = (char *)realloc(run->text, capacity);
+            if (!text) {
+                return;
+            }
+            run->text = text;
+            run->capacity = capacity;
+        }
+        run->text[run->len++] = (char)n->value;
+        literal_keep_longer(best, run->text, run->len);
+        return;
+    }
+
+    if (n->type == NODE_BOL || n->type == NODE_EOL || n->type == NODE_EMPTY) {
+        return; /* zero-width: the run continues across it */
+    }
+
+    run->len = 0;
+    if (n->type == NODE_REPEAT && n->min > 0) {
+        /* The first copy is required, but cannot extend the runs around it */
+        Literal inner = { NULL, 0, 0 };
+        collect_literals(ps, n->left, &inner, best);
+        free(inner.text);
+    }
+}
+
+/* ---- Compiler ---- */
+
+typedef struct {
+    Inst *insts;
+    int count;
+    int capacity;
+    const char *error;
+} Program;
+
+static int emit(Program *prog, OpCode op, int x, int y)
+{
+    if (prog->count >= PATTERN_MAX_INSTS) {
+        prog->error = "pattern too large";
+        return -1;
+    }
+    if (prog->count == prog->capacity) {
+        int capacity = prog->capacity ? prog->capacity * 2 : 64;
+        Inst *insts = (Inst *)realloc(prog->insts, (size_t)capacity * sizeof(Inst));
+        if (!insts) {
+            prog->error = "out of memory";
+            return -1;
+        }
+        prog->insts = insts;
+        prog->capacity = capacity;
+    }
+
+    prog->insts[prog->count].op = op;
+    prog->insts[prog->count].x = x;
+    prog->insts[prog->count].y = y;
+    return prog->count++;
+}
+
+static int compile_node(Program *prog, const Parser *ps, int node);
+
+/* Emits `node?`: SPLIT over the node */
+static int compile_optional(Program *prog, const Parser *ps, int node)
+{
+    int split = emit(prog, OP_SPLIT, 0, 0);
+    if (split < 0 || compile_node(prog, ps, node) != 0) {
+        return -1;
+    }
+    prog->insts[split].x = split + 1;
+    prog->insts[split].y = prog->count;
+    return 0;
+}
+
+static int compile_node(Program *prog, const Parser *ps, int node)
+{
+    const Node *n = &ps->nodes[node];
+
+    switch (n->type) {
+    case NODE_EMPTY:
+        return 0;
+    case NODE_CHAR:
+        return emit(prog, OP_CHAR, n->value, 0) < 0 ? -1 : 0;
+    case NODE_CLASS:
+        return emit(prog, OP_CLASS, n->value, 0) < 0 ? -1 : 0;
+    case NODE_BOL:
+        return emit(prog, OP_BOL, 0, 0) < 0 ? -1 : 0;
+    case NODE_EOL:
+        return emit(prog, OP_EOL, 0, 0) < 0 ? -1 : 0;
+    case NODE_CAT:
+        if (compile_node(prog, ps, n->left) != 0) {
+            return -1;
+        }
+        return compile_node(prog, ps, n->right);
+    case NODE_ALT: {
+        int split = emit(prog, OP_SPLIT, 0, 0);
+        if (split < 0 || compile_node(prog, ps, n->left) != 0) {
+            return -1;
+        }
+        int jmp = emit(prog, OP_JMP, 0, 0);
+        if (jmp < 0) {
+            return -1;
+        }
+        prog->insts[split].x = split + 1;
+        prog->insts[split].y = prog->count;
+        if (compile_node(prog, ps, n->right) != 0) {
+            return -1;
+        }
+        prog->insts[jmp].x = prog->count;
+        return 0;
+    }
+    case NODE_REPEAT:
+        for (int i = 0; i < n->min; ++i) {
+            if (compile_node(prog, ps, n->left) != 0) {
+                return -1;
+            }
+        }
+        if (n->max < 0) {
+            int split = emit(prog, OP_SPLIT, 0, 0);
+            if (split < 0 || compile_node(prog, ps, n->left) != 0 || emit(prog, OP_JMP, split, 0) < 0) {
+                return -1;
+            }
+            prog->insts[split].x = split + 1;
+            prog->insts[split].y = prog->count;
+            return 0;
+        }
+        for (int i = n->min; i < n->max; ++i) {
+            if (compile_optional(prog, ps, n->left) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+    return -1;
+}
+
+/* ---- DFA construction ---- */
+
+static void dfa_reset(Dfa *dfa)
+{
+    for (int i = 0; i < dfa->count; ++i) {
+        free(dfa->states[i].set);
+    }
+    dfa->count = 0;
+    for (int i = 0; i < DFA_BUCKETS; ++i) {
+        dfa->buckets[i] = -1;
+    }
+    dfa->start[0] = DFA_UNKNOWN;
+    dfa->start[1] = DFA_UNKNOWN;
+}
+
+static int dfa_init(Dfa *dfa, int unanchored)
+{
+    dfa->states = (DfaState *)malloc(DFA_MAX_STATES * sizeof(DfaState));
+    dfa->count = 0;
+    dfa->unanchored = unanchored;
+    dfa_reset(dfa);
+    return dfa->states ? 0 : -1;
+}
+
+static void dfa_free(Dfa *dfa)
+{
+    if (dfa->states) {
+        dfa_reset(dfa);
+        free(dfa->states);
+        dfa->states = NULL;
+    }
+}
+
+/*
+ * Adds the instructions reachable from `pc` without consuming input.
+ * A `$` that cannot be passed yet is kept in the set so the end of line
+ * can still be checked later; a `^` that cannot be passed is dropped.
+ */
+static void add_closure(Pattern *pattern, int *set, int *len, int pc, int at_bol, int at_eol)
+{
+    int top = 0;
+    pattern->stack[top++] = pc;
+
+    while (top > 0) {
+        pc = pattern->stack[--top];
+        if (pattern->seen[pc] == pattern->seen_gen) {
+            continue;
+        }
+        pattern->seen[pc] = pattern->seen_gen;
+
+        const Inst *inst = &pattern->insts[pc];
+        switch (inst->op) {
+        case OP_JMP:
+            pattern->stack[top++] = inst->x;
+            break;
+        case OP_SPLIT:
+            pattern->stack[top++] = inst->y;
+            pattern->stack[top++] = inst->x;
+            break;
+        case OP_BOL:
+            if (at_bol) {
+                pattern->stack[top++] = pc + 1;
+            }
+            break;
+        case OP_EOL:
+            if (at_eol) {
+                pattern->stack[top++] = pc + 1;
+            } else {
+                set[(*len)++] = pc;
+            }
+            break;
+        default:
+            set[(*len)++] = pc;
+            break;
+        }
+    }
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static unsigned hash_set(const int *set, int len)
+{
+    unsigned hash = 2166136261u;
+    for (int i = 0; i < len; ++i) {
+        hash = (hash ^ (unsigned)set[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Whether following the pending `$`s of a set reaches a match */
+static int accepts_at_end(Pattern *pattern, const int *set, int len)
+{
+    int *reach = pattern->scratch + pattern->inst_count;
+    int reach_len = 0;
+
+    pattern->seen_gen++;
+    for (int i = 0; i < len; ++i) {
+        if (pattern->insts[set[i]].op == OP_MATCH) {
+            return 1;
+        }
+        if (pattern->insts[set[i]].op == OP_EOL) {
+            add_closure(pattern, reach, &reach_len, set[i] + 1, 0, 1);
+        }
+    }
+    for (int i = 0; i < reach_len; ++i) {
+        if (pattern->insts[reach[i]].op == OP_MATCH) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns the state for `set` (sorted in place), creating it if needed */
+static int dfa_intern(Pattern *pattern, Dfa *dfa, int *set, int len)
+{
+    qsort(set, (size_t)len, sizeof(int), compare_ints);
+    unsigned hash = hash_set(set, len);
+    int bucket = (int)(hash % DFA_BUCKETS);
+
+    for (int s = dfa->buckets[bucket]; s >= 0; s = dfa->states[s].chain) {
+        const DfaState *state = &dfa->states[s];
+        if (state->hash == hash && state->set_len == len &&
+            memcmp(state->set, set, (size_t)len * sizeof(int)) == 0) {
+            return s;
+        }
+    }
+
+    if (dfa->count == DFA_MAX_STATES) {
+        /* Out of room: start over rather than grow without bound */
+        dfa_reset(dfa);
+        bucket = (int)(hash % DFA_BUCKETS);
+    }
+
+    DfaState *state = &dfa->states[dfa->count];
+    state->set = (int *)malloc((size_t)(len ? len : 1) * sizeof(int));
+    if (!state->set) {
+        return -1;
+    }
+    memcpy(state->set, set, (size_t)len * sizeof(int));
+    state->set_len = len;
+    state->hash = hash;
+    state->accept = 0;
+    for (int i = 0; i < len; ++i) {
+        if (pattern->insts[set[i]].op == OP_MATCH) {
+            state->accept = 1;
+        }
+    }
+    state->accept_at_end = accepts_at_end(pattern, set, len);
+    for (int b = 0; b < 256; ++b) {
+        state->next[b] = DFA_UNKNOWN;
+    }
+    state->chain = dfa->buckets[bucket];
+    dfa->buckets[bucket] = dfa->count;
+    return dfa->count++;
+}
+
+static int dfa_start(Pattern *pattern, Dfa *dfa, int at_bol)
+{
+    if (dfa->start[at_bol] != DFA_UNKNOWN) {
+        return dfa->start[at_bol];
+    }
+
+    int len = 0;
+    pattern->seen_gen++;
+    add_closure(pattern, pattern->scratch, &len, 0, at_bol, 0);
+    int state = dfa_intern(pattern, dfa, pattern->scratch, len);
+    dfa->start[at_bol] = state;
+    return state;
+}
+
+static int dfa_step(Pattern *pattern, Dfa *dfa, int state, unsigned char byte)
+{
+    int next = dfa->states[state].next[byte];
+    if (next != DFA_UNKNOWN) {
+        return next;
+    }
+
+    int *set = pattern->scratch;
+    int len = 0;
+    const DfaState *from = &dfa->states[state];
+
+    pattern->seen_gen++;
+    for (int i = 0; i < from->set_len; ++i) {
+        const Inst *inst = &pattern->insts[from->set[i]];
+        if ((inst->op == OP_CHAR && inst->x == byte) ||
+            (inst->op == OP_CLASS && class_has(&pattern->classes[inst->x], byte))) {
+            add_closure(pattern, set, &len, from->set[i] + 1, 0, 0);
+        }
+    }
+    if (dfa->unanchored) {
+        add_closure(pattern, set, &len, 0, 0, 0);
+    }
+
+    int count_before = dfa->count;
+    next = dfa_intern(pattern, dfa, set, len);
+    if (next >= 0 && dfa->count >= count_before) {
+        /* Only cache the edge if the table was not flushed meanwhile */
+        dfa->states[state].next[byte] = next;
+    }
+    return next;
+}
+
+/* ---- Public API ---- */
+
+void pattern_free(Pattern *pattern)
+{
+    if (!pattern) {
+        return;
+    }
+    dfa_free(&pattern->search);
+    dfa_free(&pattern->anchored);
+    free(pattern->source);
+    free(pattern->insts);
+    free(pattern->classes);
+    free(pattern->literal);
+    free(pattern->stack);
+    free(pattern->seen);
+    free(pattern->scratch);
+    free(pattern->thread_pc);
+    free(pattern->thread_start);
+    free(pattern);
+}
+
+Pattern *pattern_compile(const char *source, const char **error)
+{
+    const char *unused = NULL;
+    if (!error) {
+        error = &unused;
+    }
+    *error = NULL;
+
+    if (!source) {
+        *error = "no pattern";
+        return NULL;
+    }
+
+    Parser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = source;
+
+    int root = parse_alt(&ps);
+    if (root >= 0 && *ps.p == ')') {
+        ps.error = "unmatched )";
+        root = -1;
+    }
+    if (root < 0) {
+        *error = ps.error ? ps.error : "invalid pattern";
+        free(ps.nodes);
+        free(ps.classes);
+        return NULL;
+    }
+
+    Program prog;
+    memset(&prog, 0, sizeof(prog));
+    if (compile_node(&prog, &ps, root) != 0 || emit(&prog, OP_MATCH, 0, 0) < 0) {
+        *error = prog.error ? prog.error : "invalid pattern";
+        free(prog.insts);
+        free(ps.nodes);
+        free(ps.classes);
+        return NULL;
+    }
+
+    Pattern *pattern = (Pattern *)calloc(1, sizeof(Pattern));
+    Literal run = { NULL, 0, 0 };
+    Literal best = { NULL, 0, 0 };
+    collect_literals(&ps, root, &run, &best);
+    free(run.text);
+    free(ps.nodes);
+
+    size_t source_len = strlen(source);
+    if (pattern) {
+        pattern->insts = prog.insts;
+        pattern->inst_count = prog.count;
+        pattern->classes = ps.classes;
+        pattern->class_count = ps.class_count;
+        pattern->literal = best.text;
+        pattern->literal_len = best.len;
+        pattern->source = (char *)malloc(source_len + 1);
+        pattern->stack = (int *)malloc(((size_t)prog.count * 2 + 2) * sizeof(int));
+        pattern->seen = (int *)calloc((size_t)prog.count, sizeof(int));
+        pattern->scratch = (int *)malloc((size_t)prog.count * 2 * sizeof(int));
+        pattern->thread_pc = (int *)malloc((size_t)prog.count * 2 * sizeof(int));
+        pattern->thread_start = (size_t *)malloc((size_t)prog.count * 2 * sizeof(size_t));
+    } else {
+        free(prog.insts);
+        free(ps.classes);
+        free(best.text);
+    }
+
+    if (!pattern || !pattern->source || !pattern->stack || !pattern->seen || !pattern->scratch ||
+        !pattern->thread_pc || !pattern->thread_start ||
+        dfa_init(&pattern->search, 1) != 0 || dfa_init(&pattern->anchored, 0) != 0) {
+        pattern_free(pattern);
+        *error = "out of memory";
+        return NULL;
+    }
+
+    memcpy(pattern->source, source, source_len + 1);
+    return pattern;
+}
+
+const char *pattern_source(const Pattern *pattern)
+{
+    return pattern ? pattern->source : NULL;
+}
+
+const char *pattern_literal(const Pattern *pattern, size_t *out_len)
+{
+    if (!pattern || !pattern->literal) {
+        if (out_len) {
+            *out_len = 0;
+        }
+        return "";
+    }
+    if (out_len) {
+        *out_len = pattern->literal_len;
+    }
+    return pattern->literal;
+}
+
+/* Longest match starting exactly at `start`, or -1 */
+static long match_extent(Pattern *pattern, const unsigned char *text, size_t len, size_t start)
+{
+    Dfa *dfa = &pattern->anchored;
+    int state = dfa_start(pattern, dfa, start == 0);
+    long end = -1;
+
+    if (state < 0) {
+        return -1;
+    }
+    if (dfa->states[state].accept) {
+        end = (long)start;
+    }
+
+    size_t i = start;
+    for (; i < len; ++i) {
+        state = dfa_step(pattern, dfa, state, text[i]);
+        if (state < 0 || dfa->states[state].set_len == 0) {
+            return end; /* dead: nothing longer can match */
+        }
+        if (dfa->states[state].accept) {
+            end = (long)(i + 1);
+        }
+    }
+
+    if (dfa->states[state].accept_at_end) {
+        end = (long)len;
+    }
+    return end;
+}
+
+/* Adds the threads reachable from `pc` at offset `at` without consuming input */
+static void add_thread(Pattern *pattern, int *pcs, size_t *starts, int *count, int pc, size_t start, size_t at,
+                       size_t len)
+{
+    int top = 0;
+    pattern->stack[top++] = pc;
+
+    while (top > 0) {
+        pc = pattern->stack[--top];
+        if (pattern->seen[pc] == pattern->seen_gen) {
+            continue; /* an earlier start already got here, and any match it leads to is as good */
+        }
+        pattern->seen[pc] = pattern->seen_gen;
+
+        const Inst *inst = &pattern->insts[pc];
+        switch (inst->op) {
+        case OP_JMP:
+            pattern->stack[top++] = inst->x;
+            break;
+        case OP_SPLIT:
+            pattern->stack[top++] = inst->y;
+            pattern->stack[top++] = inst->x;
+            break;
+        case OP_BOL:
+            if (at == 0) {
+                pattern->stack[top++] = pc + 1;
+            }
+            break;
+        case OP_EOL:
+            if (at == len) {
+                pattern->stack[top++] = pc + 1;
+            }
+            break;
+        default:
+            pcs[*count] = pc;
+            starts[*count] = start;
+            (*count)++;
+            break;
+        }
+    }
+}
+
+/*
+ * Start of the leftmost match at or after `from`, or -1. The NFA runs once
+ * over the line with each thread remembering where it started; threads
+ * are kept in order of their start, so where two reach the same
+ * instruction the earlier start wins. Linear in the line, unlike trying
+ * every start in turn.
+ */
+static long find_start(Pattern *pattern, const unsigned char *text, size_t len, size_t from)
+{
+    int *pcs[2] = { pattern->thread_pc, pattern->thread_pc + pattern->inst_count };
+    size_t *starts[2] = { pattern->thread_start, pattern->thread_start + pattern->inst_count };
+    int counts[2] = { 0, 0 };
+    int cur = 0;
+    long best = -1;
+
+    pattern->seen_gen++;
+    for (size_t at = from;; ++at) {
+        /* A new start only matters while no match has been found */
+        if (best < 0) {
+            add_thread(pattern, pcs[cur], starts[cur], &counts[cur], 0, at, at, len);
+        }
+
+        /* Threads after the first match started no earlier than it */
+        int live = 0;
+        for (int t = 0; t < counts[cur]; ++t) {
+            if (pattern->insts[pcs[cur][t]].op == OP_MATCH) {
+                best = (long)starts[cur][t];
+                break;
+            }
+            live = t + 1;
+        }
+        if (at == len || (best >= 0 && live == 0)) {
+            return best;
+        }
+
+        int next = 1 - cur;
+        counts[next] = 0;
+        pattern->seen_gen++;
+        for (int t = 0; t < live; ++t) {
+            const Inst *inst = &pattern->insts[pcs[cur][t]];
+            if ((inst->op == OP_CHAR && inst->x == text[at]) ||
+                (inst->op == OP_CLASS && class_has(&pattern->classes[inst->x], text[at]))) {
+                add_thread(pattern, pcs[next], starts[next], &counts[next], pcs[cur][t] + 1, starts[cur][t],
+                           at + 1, len);
+            }
+        }
+        cur = next;
+    }
+}
+
+int pattern_find(Pattern *pattern, const char *text, size_t len, size_t from,
+                 size_t *out_start, size_t *out_len)
+{
+    if (!pattern || (!text && len > 0) || from > len) {
+        return 0;
+    }
+
+    const unsigned char *bytes = (const unsigned char *)text;
+    Dfa *dfa = &pattern->search;
+
+    /* One pass over the line decides whether any match exists at all */
+    int state = dfa_start(pattern, dfa, from == 0);
+    if (state < 0) {
+        return 0;
+    }
+    int found = dfa->states[state].accept;
+    for (size_t i = from; !found && i < len; ++i) {
+        int next = dfa->states[state].next[bytes[i]];
+        if (next == DFA_UNKNOWN) {
+            next = dfa_step(pattern, dfa, state, bytes[i]);
+            if (next < 0) {
+                return 0;
+            }
+        }
+        state = next;
+        found = dfa->states[state].accept;
+    }
+    if (!found && !dfa->states[state].accept_at_end) {
+        return 0;
+    }
+
+    long start = find_start(pattern, bytes, len, from);
+    long end = start < 0 ? -1 : match_extent(pattern, bytes, len, (size_t)start);
+    if (end < 0) {
+        return 0;
+    }
+    *out_start = (size_t)start;
+    *out_len = (size_t)(end - start);
+    return 1;
+}
+
+/* ---- Cache ---- */
+
+typedef struct {
+    Pattern *pattern;
+    unsigned long last_used;
+} CacheEntry;
+
+static CacheEntry cache[PATTERN_CACHE_SIZE];
+static unsigned long cache_clock;
+static size_t cache_compiles;
+
+/* Frees the entry's pattern now, or at its last release if it is pinned */
+static void cache_drop(CacheEntry *entry)
+{
+    if (entry->pattern) {
+        entry->pattern->cached = 0;
+        if (entry->pattern->pins == 0) {
+            pattern_free(entry->pattern);
+        }
+    }
+    entry->pattern = NULL;
+    entry->last_used = 0;
+}
+
+Pattern *pattern_cache_get(const char *source, const char **error)
+{
+    if (!source) {
+        if (error) {
+            *error = "no pattern";
+        }
+        return NULL;
+    }
+
+    /* The victim is the least recently used entry nobody holds */
+    CacheEntry *victim = NULL;
+    for (size_t i = 0; i < PATTERN_CACHE_SIZE; ++i) {
+        CacheEntry *entry = &cache[i];
+        if (entry->pattern && strcmp(entry->pattern->source, source) == 0) {
+            entry->last_used = ++cache_clock;
+            entry->pattern->pins++;
+            return entry->pattern;
+        }
+        if (entry->pattern && entry->pattern->pins > 0) {
+            continue;
+        }
+        if (!victim || !entry->pattern || (victim->pattern && entry->last_used < victim->last_used)) {
+            victim = entry;
+        }
+    }
+
+    Pattern *pattern = pattern_compile(source, error);
+    if (!pattern) {
+        return NULL;
+    }
+    cache_compiles++;
+    pattern->pins = 1;
+
+    /* With every entry held, the pattern lives until its release */
+    if (victim) {
+        cache_drop(victim);
+        victim->pattern = pattern;
+        victim->last_used = ++cache_clock;
+        pattern->cached = 1;
+    }
+    return pattern;
+}
+
+void pattern_cache_release(Pattern *pattern)
+{
+    if (!pattern || pattern->pins == 0) {
+        return;
+    }
+    if (--pattern->pins == 0 && !pattern->cached) {
+        pattern_free(pattern);
+    }
+}
+
+size_t pattern_cache_compiles(void)
+{
+    return cache_compiles;
+}
+
+void pattern_cache_clear(void)
+{
+    for (size_t i = 0; i < PATTERN_CACHE_SIZE; ++i) {
+        cache_drop(&cache[i]);
+    }
+}
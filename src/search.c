@@ -0,0 +1,336 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: search.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "search.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SEARCH_HAVE_X86 1
+#include <immintrin.h>
+#else
+#define SEARCH_HAVE_X86 0
+#endif
+
+static const char *find_scalar(const char *hay, size_t hay_len, const char *needle, size_t needle_len)
+{
+    const char *end = hay + hay_len;
+
+    while ((size_t)(end - hay) >= needle_len) {
+        hay = memchr(hay, needle[0], (size_t)(end - hay) - needle_len + 1);
+        if (!hay) {
+            return NULL;
+        }
+        if (memcmp(hay, needle, needle_len) == 0) {
+            return hay;
+        }
+        hay++;
+    }
+    return NULL;
+}
+
+#if SEARCH_HAVE_X86
+
+__attribute__((target("sse2")))
+static const char *find_sse2(const char *hay, size_t hay_len, const char *needle, size_t needle_len)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[needle_len - 1]);
+    size_t i = 0;
+
+    for (; i + needle_len - 1 + 16 <= hay_len; i += 16) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *)(const void *)(hay + i));
+        __m128i block_last = _mm_loadu_si128((const __m128i *)(const void *)(hay + i + needle_len - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctz(mask);
+            if (memcmp(hay + i + bit, needle, needle_len) == 0) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return find_scalar(hay + i, hay_len - i, needle, needle_len);
+}
+
+__attribute__((target("avx2")))
+static unsigned candidates_avx2(const char *at, size_t needle_len, __m256i first, __m256i last)
+{
+    __m256i block_first = _mm256_loadu_si256((const __m256i *)(const void *)at);
+    __m256i block_last = _mm256_loadu_si256((const __m256i *)(const void *)(at + needle_len - 1));
+    return (unsigned)_mm256_movemask_epi8(
+        _mm256_and_si256(_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *hay, size_t hay_len, const char *needle, size_t needle_len)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[needle_len - 1]);
+    size_t i = 0;
+
+    /* Two registers per step keep the loads ahead of the compare chain */
+    for (; i + needle_len - 1 + 64 <= hay_len; i += 64) {
+        unsigned low = candidates_avx2(hay + i, needle_len, first, last);
+        unsigned high = candidates_avx2(hay + i + 32, needle_len, first, last);
+        if ((low | high) == 0) {
+            continue;
+        }
+
+        unsigned long long mask = ((unsigned long long)high << 32) | low;
+        while (mask) {
+            unsigned bit = (unsigned)__builtin_ctzll(mask);
+            if (memcmp(hay + i + bit, needle, needle_len) == 0) {
+                return hay + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+
+    return find_sse2(hay + i, hay_len - i, needle, needle_len);
+}
+
+#endif /* SEARCH_HAVE_X86 */
+
+static size_t count_scalar(const char *data, size_t len, char byte)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < len; ++i) {
+        count += data[i] == byte;
+    }
+    return count;
+}
+
+static size_t positions_scalar(const char *data, size_t len, char byte, size_t base, size_t *out)
+{
+    const char *at = data;
+    const char *end = data + len;
+    size_t count = 0;
+
+    while (at < end && (at = memchr(at, byte, (size_t)(end - at))) != NULL) {
+        out[count++] = base + (size_t)(at - data);
+        at++;
+    }
+    return count;
+}
+
+#if SEARCH_HAVE_X86
+
+/*
+ * Matches are summed per byte lane (a match compares to -1, so subtracting
+ * adds one) and folded into the total before a lane can pass 255.
+ */
+__attribute__((target("sse2")))
+static size_t count_sse2(const char *data, size_t len, char byte)
+{
+    const __m128i target = _mm_set1_epi8(byte);
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 16 <= len) {
+        __m128i lanes = zero;
+        for (int step = 0; step < 255 && i + 16 <= len; ++step, i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+            lanes = _mm_sub_epi8(lanes, _mm_cmpeq_epi8(block, target));
+        }
+        __m128i sums = _mm_sad_epu8(lanes, zero);
+        count += (size_t)_mm_cvtsi128_si32(sums) + (size_t)_mm_extract_epi16(sums, 4);
+    }
+
+    return count + count_scalar(data + i, len - i, byte);
+}
+
+__attribute__((target("sse2")))
+static size_t positions_sse2(const char *data, size_t len, char byte, size_t base, size_t *out)
+{
+    const __m128i target = _mm_set1_epi8(byte);
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, target));
+        while (mask) {
+            out[count++] = base + i + (unsigned)__builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    return count + positions_scalar(data + i, len - i, byte, base + i, out + count);
+}
+
+__attribute__((target("avx2")))
+static size_t count_avx2(const char *data, size_t len, char byte)
+{
+    const __m256i target = _mm256_set1_epi8(byte);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t i = 0;
+
+    while (i + 32 <= len) {
+        __m256i lanes = zero;
+        for (int step = 0; step < 255 && i + 32 <= len; ++step, i += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i *)(const void *)(data + i));
+            lanes = _mm256_sub_epi8(lanes, _mm256_cmpeq_epi8(block, target));
+        }
+        __m256i sums = _mm256_sad_epu8(lanes, zero);
+        __m128i halves = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        count += (size_t)_mm_cvtsi128_si32(halves) + (size_t)_mm_extract_epi16(halves, 4);
+    }
+
+    return count + count_sse2(data + i, len - i, byte);
+}
+
+__attribute__((target("avx2")))
+static size_t positions_avx2(const char *data, size_t len, char byte, size_t base, size_t *out)
+{
+    const __m256i target = _mm256_set1_epi8(byte);
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        __m256i low = _mm256_loadu_si256((const __m256i *)(const void *)(data + i));
+        __m256i high = _mm256_loadu_si256((const __m256i *)(const void *)(data + i + 32));
+        unsigned long long mask = ((unsigned long long)(unsigned)_mm256_movemask_epi8(
+                                       _mm256_cmpeq_epi8(high, target)) << 32) |
+                                  (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, target));
+        while (mask) {
+            out[count++] = base + i + (unsigned)__builtin_ctzll(mask);
+            mask &= mask - 1;
+        }
+    }
+
+    return count + positions_sse2(data + i, len - i, byte, base + i, out + count);
+}
+
+#endif /* SEARCH_HAVE_X86 */
+
+static int kernel_supported(SearchKernel kernel)
+{
+    switch (kernel) {
+    case SEARCH_KERNEL_SCALAR:
+        return 1;
+#if SEARCH_HAVE_X86
+    case SEARCH_KERNEL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SEARCH_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return 0;
+    }
+}
+
+typedef struct {
+    SearchKernel kernel;
+    const char *(*find)(const char *hay, size_t hay_len, const char *needle, size_t needle_len);
+    size_t (*count)(const char *data, size_t len, char byte);
+    size_t (*positions)(const char *data, size_t len, char byte, size_t base, size_t *out);
+} KernelOps;
+
+static const KernelOps kernel_ops[] = {
+    { SEARCH_KERNEL_SCALAR, find_scalar, count_scalar, positions_scalar },
+#if SEARCH_HAVE_X86
+    { SEARCH_KERNEL_SSE2, find_sse2, count_sse2, positions_sse2 },
+    { SEARCH_KERNEL_AVX2, find_avx2, count_avx2, positions_avx2 },
+#endif
+};
+
+/* The CPU is probed once; every call after that is one load */
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+static const KernelOps *best_ops;
+static _Atomic(const KernelOps *) active_ops;
+
+static void detect_kernel(void)
+{
+    best_ops = &kernel_ops[0];
+    for (size_t i = 0; i < sizeof(kernel_ops) / sizeof(kernel_ops[0]); ++i) {
+        if (kernel_supported(kernel_ops[i].kernel)) {
+            best_ops = &kernel_ops[i]; /* listed narrowest first */
+        }
+    }
+    atomic_store(&active_ops, best_ops);
+}
+
+static const KernelOps *current_ops(void)
+{
+    const KernelOps *ops = atomic_load_explicit(&active_ops, memory_order_acquire);
+    if (!ops) {
+        pthread_once(&detect_once, detect_kernel);
+        ops = atomic_load(&active_ops);
+    }
+    return ops;
+}
+
+void search_set_kernel(SearchKernel kernel)
+{
+    pthread_once(&detect_once, detect_kernel);
+
+    const KernelOps *ops = best_ops;
+    for (size_t i = 0; i < sizeof(kernel_ops) / sizeof(kernel_ops[0]); ++i) {
+        if (kernel_ops[i].kernel == kernel && kernel_supported(kernel)) {
+            ops = &kernel_ops[i];
+        }
+    }
+    atomic_store(&active_ops, ops);
+}
+
+SearchKernel search_active_kernel(void)
+{
+    return current_ops()->kernel;
+}
+
+const char *search_kernel_name(SearchKernel kernel)
+{
+    switch (kernel) {
+    case SEARCH_KERNEL_SCALAR:
+        return "scalar";
+    case SEARCH_KERNEL_SSE2:
+        return "sse2";
+    case SEARCH_KERNEL_AVX2:
+        return "avx2";
+    default:
+        return "auto";
+    }
+}
+
+const char *search_find(const char *hay, size_t hay_len, const char *needle, size_t needle_len)
+{
+    if (!hay || !needle || needle_len == 0 || needle_len > hay_len) {
+        return NULL;
+    }
+
+    return current_ops()->find(hay, hay_len, needle, needle_len);
+}
+
+size_t search_count_byte(const char *data, size_t len, char byte)
+{
+    if (!data) {
+        return 0;
+    }
+
+    return current_ops()->count(data, len, byte);
+}
+
+size_t search_byte_positions(const char *data, size_t len, char byte, size_t base, size_t *out)
+{
+    if (!data || !out) {
+        return 0;
+    }
+
+    return current_ops()->positions(data, len, byte, base, out);
+}
@@ -0,0 +1,150 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: stats.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "stats.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    atomic_ullong count;
+    atomic_ullong bytes;
+    atomic_ullong nanoseconds;
+    atomic_ullong max_nanoseconds;
+} OpCounters;
+
+static atomic_int enabled;
+static OpCounters ops[STATS_OP_COUNT];
+static atomic_ullong allocations;
+static atomic_ullong allocated_bytes;
+
+static unsigned long long now_nanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static void add(atomic_ullong *counter, unsigned long long value)
+{
+    atomic_fetch_add_explicit(counter, value, memory_order_relaxed);
+}
+
+void stats_set_enabled(int on)
+{
+    atomic_store_explicit(&enabled, on ? 1 : 0, memory_order_relaxed);
+}
+
+int stats_enabled(void)
+{
+    return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+void stats_reset(void)
+{
+    for (size_t i = 0; i < STATS_OP_COUNT; ++i) {
+        atomic_store(&ops[i].count, 0);
+        atomic_store(&ops[i].bytes, 0);
+        atomic_store(&ops[i].nanoseconds, 0);
+        atomic_store(&ops[i].max_nanoseconds, 0);
+    }
+    atomic_store(&allocations, 0);
+    atomic_store(&allocated_bytes, 0);
+}
+
+unsigned long long stats_start(void)
+{
+    if (!stats_enabled()) {
+        return 0;
+    }
+    unsigned long long now = now_nanoseconds();
+    return now ? now : 1;
+}
+
+void stats_record(StatsOp op, size_t bytes, unsigned long long start)
+{
+    if (start == 0 || (unsigned)op >= STATS_OP_COUNT) {
+        return;
+    }
+
+    unsigned long long now = now_nanoseconds();
+    unsigned long long elapsed = now > start ? now - start : 0;
+    OpCounters *counters = &ops[op];
+    add(&counters->count, 1);
+    add(&counters->bytes, bytes);
+    add(&counters->nanoseconds, elapsed);
+
+    unsigned long long max = atomic_load_explicit(&counters->max_nanoseconds, memory_order_relaxed);
+    while (elapsed > max && !atomic_compare_exchange_weak(&counters->max_nanoseconds, &max, elapsed)) {
+    }
+}
+
+void stats_count_allocation(size_t bytes)
+{
+    if (!stats_enabled()) {
+        return;
+    }
+    add(&allocations, 1);
+    add(&allocated_bytes, bytes);
+}
+
+const char *stats_op_name(StatsOp op)
+{
+    switch (op) {
+    case STATS_LOAD:
+        return "load";
+    case STATS_SAVE:
+        return "save";
+    case STATS_SEARCH:
+        return "search";
+    default:
+        return "unknown";
+    }
+}
+
+void stats_read(StatsSnapshot *snapshot)
+{
+    if (!snapshot) {
+        return;
+    }
+    memset(snapshot, 0, sizeof(*snapshot));
+    for (size_t i = 0; i < STATS_OP_COUNT; ++i) {
+        snapshot->ops[i].count = atomic_load(&ops[i].count);
+        snapshot->ops[i].bytes = atomic_load(&ops[i].bytes);
+        snapshot->ops[i].nanoseconds = atomic_load(&ops[i].nanoseconds);
+        snapshot->ops[i].max_nanoseconds = atomic_load(&ops[i].max_nanoseconds);
+    }
+    snapshot->allocations = atomic_load(&allocations);
+    snapshot->allocated_bytes = atomic_load(&allocated_bytes);
+}
+
+void stats_dump(FILE *out)
+{
+    if (!out) {
+        return;
+    }
+
+    StatsSnapshot snapshot;
+    stats_read(&snapshot);
+    for (size_t i = 0; i < STATS_OP_COUNT; ++i) {
+        const StatsOpTotals *op = &snapshot.ops[i];
+        double seconds = (double)op->nanoseconds / 1e9;
+        fprintf(out, "%-7s: %llu ops, %llu bytes in %.3f ms (max %.3f ms", stats_op_name((StatsOp)i), op->count,
+                op->bytes, seconds * 1e3, (double)op->max_nanoseconds / 1e6);
+        if (seconds > 0.0) {
+            fprintf(out, ", %.1f MB/s", (double)op->bytes / seconds / 1e6);
+        }
+        fprintf(out, ")\n");
+    }
+    fprintf(out, "alloc  : %llu allocations, %llu bytes%s\n", snapshot.allocations, snapshot.allocated_bytes,
+            stats_enabled() ? "" : " (collection is off)");
+}
@@ -3,13 +3,14 @@
  * File: util.c
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
 #include "util.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 void trim_newline(char *s)
@@ -37,3 +38,120 @@ int read_line(char *buffer, size_t size)
     trim_newline(buffer);
     return 0;
 }
+
+int line_reader_init(LineReader *reader, FILE *fp)
+{
+    if (!reader || !fp) {
+        return -1;
+    }
+
+    reader->fp = fp;
+    reader->chunk = (char *)malloc(LINE_READER_CHUNK_SIZE);
+    reader->chunk_pos = 0;
+    reader->chunk_len = 0;
+    reader->scratch = NULL;
+    reader->scratch_len = 0;
+    reader->scratch_capacity = 0;
+    return reader->chunk ? 0 : -1;
+}
+
+void line_reader_free(LineReader *reader)
+{
+    if (!reader) {
+        return;
+    }
+
+    free(reader->chunk);
+    free(reader->scratch);
+    reader->chunk = NULL;
+    reader->scratch = NULL;
+    reader->scratch_capacity = 0;
+}
+
+static int scratch_append(LineReader *reader, const char *data, size_t len)
+{
+    if (reader->scratch_len + len + 1 > reader->scratch_capacity) {
+        size_t new_capacity = reader->scratch_capacity ? reader->scratch_capacity : 256;
+        while (new_capacity < reader->scratch_len + len + 1) {
+            new_capacity *= 2;
+        }
+        char *scratch = (char *)realloc(reader->scratch, new_capacity);
+        if (!scratch) {
+            return -1;
+        }
+        reader->scratch = scratch;
+        reader->scratch_capacity = new_capacity;
+    }
+
+    memcpy(reader->scratch + reader->scratch_len, data, len);
+    reader->scratch_len += len;
+    reader->scratch[reader->scratch_len] = '\0';
+    return 0;
+}
+
+static void finish_line(char *line, size_t *len)
+{
+    while (*len > 0 && line[*len - 1] == '\r') {
+        line[--*len] = '\0';
+    }
+}
+
+int line_reader_next(LineReader *reader, char **out_line, size_t *out_len)
+{
+    if (!reader || !reader->chunk || !out_line || !out_len) {
+        return -1;
+    }
+
+    reader->scratch_len = 0;
+
+    for (;;) {
+        if (reader->chunk_pos == reader->chunk_len) {
+            reader->chunk_pos = 0;
+            reader->chunk_len = fread(reader->chunk, 1, LINE_READER_CHUNK_SIZE, reader->fp);
+            if (reader->chunk_len == 0) {
+                break;
+            }
+        }
+
+        char *start = reader->chunk + reader->chunk_pos;
+        size_t avail = reader->chunk_len - reader->chunk_pos;
+        char *nl = (char *)memchr(start, '\n', avail);
+
+        if (!nl) {
+            /* The line continues in the next chunk */
+            if (scratch_append(reader, start, avail) != 0) {
+                return -1;
+            }
+            reader->chunk_pos = reader->chunk_len;
+            continue;
+        }
+
+        size_t len = (size_t)(nl - start);
+        reader->chunk_pos += len + 1;
+
+        if (reader->scratch_len == 0) {
+            *nl = '\0';
+            finish_line(start, &len);
+            *out_line = start;
+            *out_len = len;
+            return 0;
+        }
+
+        if (scratch_append(reader, start, len) != 0) {
+            return -1;
+        }
+        break;
+    }
+
+    if (ferror(reader->fp)) {
+        return -1;
+    }
+    if (reader->scratch_len == 0 && reader->chunk_len == 0) {
+        return 1;
+    }
+
+    finish_line(reader->scratch, &reader->scratch_len);
+    *out_line = reader->scratch;
+    *out_len = reader->scratch_len;
+    return 0;
+}
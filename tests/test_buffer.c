@@ -3,15 +3,828 @@
  * File: test_buffer.c
  * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
  * Created: 2025-11-23
- * Updated: 2025-11-23
+ * Updated: 2026-10-17
  * License: MIT License (see LICENSE file for details)
  */
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "buffer.h"
 
+#define MODEL_LINES 256
+
+static void release_test_data(void *data, size_t size)
+{
+    (void)size;
+    free(data);
+}
+
+static size_t released;
+
+static void count_release(void *data, size_t size)
+{
+    (void)size;
+    free(data);
+    released++;
+}
+
+static void attach_text(TextBuffer *buf, const char *text)
+{
+    size_t len = strlen(text);
+    char *data = (char *)malloc(len + 1);
+    assert(data != NULL);
+    memcpy(data, text, len);
+    assert(buffer_attach_original(buf, data, len, release_test_data) == 0);
+}
+
+static void test_piece_table(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    attach_text(&buf, "alpha\nbeta\r\ngamma");
+    assert(buf.count == 3);
+    assert(strcmp(buffer_get_line(&buf, 1), "beta") == 0);
+    assert(strcmp(buffer_get_line(&buf, 2), "gamma") == 0);
+
+    /* Each original line keeps its own copy, so pointers stay valid side by side */
+    const char *alpha = buffer_get_line(&buf, 0);
+    const char *beta = buffer_get_line(&buf, 1);
+    assert(alpha != beta && buffer_get_line(&buf, 0) == alpha);
+    assert(strcmp(alpha, "alpha") == 0 && strcmp(beta, "beta") == 0);
+
+    /* Whole-piece scans must not match across line ends */
+    assert(buffer_find(&buf, "beta") == 1);
+    assert(buffer_find(&buf, "a\r") == INVALID_INDEX);
+    assert(buffer_find(&buf, "a\ng") == INVALID_INDEX);
+
+    /* Edits split the original piece without touching its bytes */
+    assert(buffer_insert_line(&buf, 0, "top") == 0);
+    assert(buffer_insert_line(&buf, 2, "middle") == 0);
+    assert(buffer_replace_line(&buf, 4, "GAMMA") == 0);
+    assert(buffer_delete_line(&buf, 1) == 0);
+    assert(buf.count == 4);
+    assert(strcmp(buffer_get_line(&buf, 0), "top") == 0);
+    assert(strcmp(buffer_get_line(&buf, 1), "middle") == 0);
+    assert(buffer_get_line(&buf, 2) == beta);
+    assert(strcmp(buffer_get_line(&buf, 3), "GAMMA") == 0);
+    assert(buffer_find(&buf, "GAM") == 3);
+    assert(buffer_find(&buf, "ddle") == 1);
+    assert(buffer_find(&buf, "nope") == INVALID_INDEX);
+
+    /* Lines appended after the last added line extend its piece */
+    size_t pieces = buf.piece_count;
+    assert(buffer_append_line(&buf, "x") == 0);
+    assert(buffer_append_line(&buf, "y") == 0);
+    assert(buf.piece_count == pieces);
+
+    buffer_free(&buf);
+}
+
+static void test_find_all(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    attach_text(&buf, "abab\nnone\nab\n");
+    assert(buffer_insert_line(&buf, 1, "xxab") == 0);
+
+    BufferSearch search;
+    BufferMatch matches[8];
+    buffer_search_init(&search, "ab");
+    assert(buffer_find_all(&buf, &search, matches, 8) == 4);
+    assert(matches[0].line == 0 && matches[0].column == 0);
+    assert(matches[1].line == 0 && matches[1].column == 2);
+    assert(matches[2].line == 1 && matches[2].column == 2);
+    assert(matches[3].line == 3 && matches[3].column == 0);
+    assert(buffer_find_all(&buf, &search, matches, 8) == 0);
+
+    /* Paging one match at a time resumes where the last call stopped */
+    buffer_search_init(&search, "ab");
+    for (size_t expected = 0; expected < 4; ++expected) {
+        BufferMatch match;
+        assert(buffer_find_all(&buf, &search, &match, 1) == 1);
+        assert(match.line == matches[expected].line && match.column == matches[expected].column);
+    }
+    assert(buffer_find_all(&buf, &search, matches, 1) == 0);
+
+    buffer_free(&buf);
+}
+
+static void test_find_regex(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    attach_text(&buf, "id=12 id=7\r\nnone\nid=\nend\n");
+    assert(buffer_insert_line(&buf, 2, "x id=345") == 0);
+
+    Pattern *pattern = pattern_compile("id=[0-9]+$|^end", NULL);
+    assert(pattern != NULL);
+
+    BufferSearch search;
+    BufferMatch matches[8];
+    buffer_search_init_regex(&search, pattern);
+    assert(buffer_find_all(&buf, &search, matches, 8) == 3);
+    assert(matches[0].line == 0 && matches[0].column == 6 && matches[0].length == 4);
+    assert(matches[1].line == 2 && matches[1].column == 2 && matches[1].length == 6);
+    assert(matches[2].line == 4 && matches[2].column == 0 && matches[2].length == 3);
+    assert(buffer_find_all(&buf, &search, matches, 8) == 0);
+    pattern_free(pattern);
+
+    /* Empty matches advance a byte at a time and reach every line, but skip the end of "x" */
+    pattern = pattern_compile("x*", NULL);
+    buffer_search_init_regex(&search, pattern);
+    size_t total = 0;
+    BufferMatch match;
+    while (buffer_find_all(&buf, &search, &match, 1) == 1) {
+        total++;
+    }
+    assert(total == 11 + 5 + 8 + 4 + 4);
+    pattern_free(pattern);
+
+    buffer_free(&buf);
+}
+
+/* Parallel search must return exactly what the sequential scan returns */
+static void test_find_all_parallel(void)
+{
+    const size_t lines = 50000;
+    char *text = (char *)malloc(lines * 8);
+    assert(text != NULL);
+    size_t len = 0;
+    for (size_t i = 0; i < lines; ++i) {
+        len += (size_t)sprintf(text + len, "%c%c%cq%zu\n", 'a' + (int)(i % 3), 'a' + (int)(i % 5), 'a' + (int)(i % 7), i % 10);
+    }
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(buffer_attach_original(&buf, text, len, release_test_data) == 0);
+    for (size_t i = 0; i < 200; ++i) {
+        assert(buffer_replace_line(&buf, i * 97, "abq-edited") == 0);
+    }
+
+    size_t limits[] = { 1, 37, lines * 2 };
+    BufferMatch *expected = (BufferMatch *)malloc(lines * 2 * sizeof(BufferMatch));
+    BufferMatch *actual = (BufferMatch *)malloc(lines * 2 * sizeof(BufferMatch));
+    assert(expected != NULL && actual != NULL);
+
+    for (size_t l = 0; l < sizeof(limits) / sizeof(limits[0]); ++l) {
+        BufferSearch search;
+        buffer_search_init(&search, "bq");
+        size_t count = buffer_find_all(&buf, &search, expected, limits[l]);
+        assert(count > 0);
+
+        for (size_t threads = 2; threads <= 8; threads *= 2) {
+            BufferSearch parallel;
+            buffer_search_init(&parallel, "bq");
+            assert(buffer_find_all_parallel(&buf, &parallel, actual, limits[l], threads) == count);
+            assert(memcmp(expected, actual, count * sizeof(BufferMatch)) == 0);
+            assert(parallel.line == search.line && parallel.column == search.column);
+        }
+    }
+
+    free(expected);
+    free(actual);
+    buffer_free(&buf);
+}
+
+/* Attaches a copy of `text` with the line scan split over `threads` workers */
+static void attach_copy(TextBuffer *buf, const char *text, size_t len, size_t threads)
+{
+    char *data = (char *)malloc(len);
+    assert(data != NULL);
+    memcpy(data, text, len);
+    buffer_init(buf);
+    assert(buffer_attach_original_parallel(buf, data, len, release_test_data, threads) == 0);
+}
+
+/* Chunked scans must build the same line table as a single pass */
+static void test_parallel_attach(void)
+{
+    const size_t size = 6 * 1024 * 1024;
+    char *text = (char *)malloc(size);
+    assert(text != NULL);
+
+    srand(11);
+    for (size_t i = 0; i < size; ++i) {
+        int pick = rand() % 64;
+        text[i] = pick == 0 ? '\n' : (char)('a' + pick % 26);
+    }
+    /* Runs of empty lines across the first chunk boundaries */
+    memset(text + 1024 * 1024 - 3, '\n', 7);
+
+    for (int variant = 0; variant < 3; ++variant) {
+        size_t len = size;
+        if (variant == 1) {
+            len = size - 1; /* unterminated last line */
+            text[len - 1] = 'z';
+        } else {
+            text[size - 1] = '\n';
+        }
+        if (variant == 2) {
+            text[size - 100] = '\r'; /* one CRLF line, in the last chunk */
+            text[size - 99] = '\n';
+        }
+
+        TextBuffer expected;
+        attach_copy(&expected, text, len, 1);
+        size_t newlines = 0;
+        for (size_t i = 0; i < len; ++i) {
+            newlines += text[i] == '\n';
+        }
+        assert(expected.count == newlines + (variant == 1));
+        assert(expected.original_crlf == (variant == 2));
+
+        for (size_t threads = 2; threads <= 8; threads *= 2) {
+            TextBuffer actual;
+            attach_copy(&actual, text, len, threads);
+            assert(actual.count == expected.count);
+            assert(actual.original_crlf == expected.original_crlf);
+            assert(memcmp(actual.original.starts, expected.original.starts,
+                          (expected.count + 1) * sizeof(size_t)) == 0);
+            assert(buffer_size(&actual) == buffer_size(&expected));
+            buffer_free(&actual);
+        }
+        buffer_free(&expected);
+    }
+
+    free(text);
+}
+
+static void test_lazy_attach(void)
+{
+    const char *text = "ab\ncd\r\nef\ngh";
+    size_t len = strlen(text);
+    char *data = (char *)malloc(len);
+    assert(data != NULL);
+    memcpy(data, text, len);
+
+    /* The prefix stops inside "cd", so only "ab" is indexed */
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(buffer_attach_original_lazy(&buf, data, len, release_test_data, 5) == 0);
+    assert(buf.count == 1);
+    assert(buffer_original_pending(&buf) == len - 3);
+
+    /* Ends must be past the indexed part and just after a newline */
+    size_t bad[] = { 2 };
+    assert(buffer_extend_original(&buf, bad, 1, 0) != 0);
+    size_t ends[] = { 7, 10 };
+    assert(buffer_extend_original(&buf, ends, 1, 0) == 0);
+    assert(buf.count == 2);
+    assert(strcmp(buffer_get_line(&buf, 1), "cd") == 0);
+    assert(buffer_size(&buf) == 6);
+
+    assert(buffer_extend_original(&buf, ends + 1, 1, 1) == 0);
+    assert(buf.count == 4);
+    assert(buffer_original_pending(&buf) == 0);
+    assert(strcmp(buffer_get_line(&buf, 3), "gh") == 0);
+    assert(buffer_line_offset(&buf, 3) == 9);
+    assert(buffer_size(&buf) == 12);
+    assert(buffer_extend_original(&buf, NULL, 0, 1) == 0);
+
+    buffer_free(&buf);
+}
+
+/* Every attach, even one rejected up front, releases the data exactly once */
+static void test_attach_release(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+    released = 0;
+
+    assert(buffer_attach_original(NULL, (char *)malloc(4), 4, count_release) != 0);
+    assert(buffer_attach_original_parallel(NULL, (char *)malloc(4), 4, count_release, 2) != 0);
+    assert(buffer_attach_original_lazy(NULL, (char *)malloc(4), 4, count_release, 2) != 0);
+    assert(buffer_attach_original_sampled(&buf, (char *)malloc(4), 4, count_release, 1, NULL, 1, 1, 1) != 0);
+    assert(released == 4);
+    assert(buffer_attach_original_lazy(&buf, NULL, 4, count_release, 2) != 0);
+    assert(released == 4);
+
+    char *data = (char *)malloc(4);
+    assert(data != NULL);
+    memcpy(data, "a\nb\n", 4);
+    assert(buffer_attach_original(&buf, data, 4, count_release) == 0);
+    assert(released == 4);
+    buffer_free(&buf);
+    assert(released == 5);
+}
+
+static void test_arena(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    assert(buffer_append_line(&buf, "first") == 0);
+    assert(buffer_append_line(&buf, "draft") == 0);
+
+    /* Rewriting the newest line reuses its arena bytes */
+    size_t used = buf.arena.blocks[0].size;
+    assert(buffer_replace_line(&buf, 1, "final") == 0);
+    assert(buffer_replace_line(&buf, 1, "fin") == 0);
+    assert(buf.arena.blocks[0].size < used);
+    assert(strcmp(buffer_get_line(&buf, 1), "fin") == 0);
+    assert(buf.piece_count == 1);
+
+    /* Editing one older line moves it to the tail once, then reuses it */
+    assert(buffer_append_line(&buf, "last") == 0);
+    used = buf.arena.blocks[0].size;
+    for (int i = 0; i < 100; ++i) {
+        assert(buffer_replace_line(&buf, 0, i % 2 ? "one" : "two") == 0);
+    }
+    assert(buf.arena.blocks[0].size == used + 4);
+
+    /* Only the tail is reused, so alternating between lines keeps growing */
+    used = buf.arena.blocks[0].size;
+    for (int i = 0; i < 100; ++i) {
+        assert(buffer_replace_line(&buf, (size_t)(i % 2) * 2, i % 2 ? "end" : "one") == 0);
+    }
+    assert(buf.arena.blocks[0].size == used + 99 * 4);
+    assert(strcmp(buffer_get_line(&buf, 0), "one") == 0);
+    assert(strcmp(buffer_get_line(&buf, 2), "end") == 0);
+
+    /* Long lines get a block of their own */
+    static char long_line[ARENA_BLOCK_SIZE];
+    memset(long_line, 'x', sizeof(long_line) - 1);
+    long_line[sizeof(long_line) - 1] = '\0';
+    assert(buffer_insert_line(&buf, 0, long_line) == 0);
+    assert(buffer_append_line(&buf, "after") == 0);
+    assert(buf.arena.block_count == 2);
+    assert(strlen(buffer_get_line(&buf, 0)) == sizeof(long_line) - 1);
+    assert(strcmp(buffer_get_line(&buf, 4), "after") == 0);
+
+    buffer_free(&buf);
+}
+
+/* Checks every offset query against lengths summed from buffer_get_line */
+static void check_offsets(const TextBuffer *buf)
+{
+    size_t offset = 0;
+    for (size_t i = 0; i < buf->count; ++i) {
+        size_t len = strlen(buffer_get_line(buf, i));
+        size_t column = 99;
+        assert(buffer_line_length(buf, i) == len);
+        assert(buffer_line_offset(buf, i) == offset);
+        assert(buffer_line_at_offset(buf, offset, &column) == i && column == 0);
+        assert(buffer_line_at_offset(buf, offset + len, &column) == i && column == len);
+        offset += len + 1;
+    }
+    assert(buffer_size(buf) == offset);
+    assert(buffer_line_offset(buf, buf->count) == offset);
+    assert(buffer_line_offset(buf, buf->count + 1) == INVALID_INDEX);
+    assert(buffer_line_at_offset(buf, offset, NULL) == INVALID_INDEX);
+    assert(buffer_line_length(buf, buf->count) == INVALID_INDEX);
+}
+
+static void test_offsets(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(buffer_size(&buf) == 0);
+    assert(buffer_line_at_offset(&buf, 0, NULL) == INVALID_INDEX);
+
+    /* Dropped CRs and a missing final newline do not count */
+    attach_text(&buf, "one\r\ntwo\n\r\r\nthree\r\nlast");
+    assert(buffer_size(&buf) == 20);
+    check_offsets(&buf);
+
+    size_t column = 0;
+    assert(buffer_line_at_offset(&buf, 6, &column) == 1 && column == 2);
+    assert(buffer_line_at_offset(&buf, 10, &column) == 3 && column == 1);
+
+    srand(99);
+    char text[32];
+    for (int step = 0; step < 500; ++step) {
+        size_t at = (size_t)rand() % (buf.count + 1);
+        sprintf(text, "%.*s", rand() % 20, "abcdefghijklmnopqrstuvwxyz");
+        switch (rand() % 3) {
+        case 0:
+            assert(buffer_insert_line(&buf, at, text) == 0);
+            break;
+        case 1:
+            if (at < buf.count) {
+                assert(buffer_delete_line(&buf, at) == 0);
+            }
+            break;
+        default:
+            if (at < buf.count) {
+                assert(buffer_replace_line(&buf, at, text) == 0);
+                /* A second edit of the same line rewrites the arena tail in place */
+                assert(buffer_replace_line(&buf, at, text + (text[0] ? 1 : 0)) == 0);
+            }
+            break;
+        }
+        if (step % 50 == 0) {
+            check_offsets(&buf);
+        }
+    }
+    check_offsets(&buf);
+
+    buffer_free(&buf);
+}
+
+static void test_embedded_nul(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    assert(buffer_append_line_n(&buf, "x\0y", 3) == 0);
+    assert(buffer_append_line_n(&buf, NULL, 0) == 0);
+    assert(buffer_insert_line_n(&buf, 1, "\0", 1) == 0);
+    assert(buffer_append_line_n(&buf, NULL, 1) != 0);
+    assert(buf.count == 3);
+    assert(buffer_size(&buf) == 7);
+
+    size_t len = 0;
+    const char *line = buffer_get_line_n(&buf, 0, &len);
+    assert(len == 3 && memcmp(line, "x\0y", 3) == 0);
+    line = buffer_get_line_n(&buf, 1, &len);
+    assert(len == 1 && line[0] == '\0');
+    assert(buffer_get_line_n(&buf, 3, &len) == NULL);
+
+    /* The plain API sees the line up to its first NUL */
+    assert(strcmp(buffer_get_line(&buf, 0), "x") == 0);
+
+    assert(buffer_replace_line_n(&buf, 2, "a\0\0b", 4) == 0);
+    assert(buffer_line_length(&buf, 2) == 4);
+
+    /* Matches may hold NULs but never reach into the next line */
+    BufferSearch search;
+    BufferMatch match;
+    buffer_search_init_n(&search, "\0\0", 2);
+    assert(buffer_find_all(&buf, &search, &match, 1) == 1);
+    assert(match.line == 2 && match.column == 1);
+    buffer_search_init_n(&search, "y\0", 2);
+    assert(buffer_find_all(&buf, &search, &match, 1) == 0);
+
+    buffer_free(&buf);
+}
+
+static void test_char_edits(void)
+{
+    char model[8][512];
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    for (int i = 0; i < 8; ++i) {
+        sprintf(model[i], "line %d", i);
+        assert(buffer_append_line(&buf, model[i]) == 0);
+    }
+
+    /* Typing goes to the gap buffer; const readers wait until it is synced */
+    assert(buffer_insert_chars(&buf, 2, 4, "!!", 2) == 0);
+    assert(buffer_insert_chars(&buf, 2, 6, "?", 1) == 0);
+    assert(buffer_delete_chars(&buf, 2, 0, 1) == 0);
+    size_t pending_len = 0;
+    assert(buffer_size(&buf) == 8 * 7 + 2);
+    assert(buffer_get_line_n(&buf, 2, &pending_len) == NULL);
+    assert(buffer_find(&buf, "!?") == INVALID_INDEX);
+    assert(strcmp(buffer_get_line(&buf, 2), "ine!!? 2") == 0);
+    assert(buffer_find(&buf, "!?") == INVALID_INDEX);
+    assert(buffer_sync_edit(&buf) == 0);
+    assert(buffer_find(&buf, "!?") == 2);
+    assert(buffer_size(&buf) == 8 * 7 + 2);
+    strcpy(model[2], "ine!!? 2");
+
+    assert(buffer_insert_chars(&buf, 2, 9, "x", 1) != 0);
+    assert(buffer_delete_chars(&buf, 2, 7, 2) != 0);
+    assert(buffer_insert_chars(&buf, 2, 0, "a\nb", 3) != 0);
+    assert(buffer_insert_chars(&buf, 8, 0, "x", 1) != 0);
+
+    /* Line edits around the line being typed into keep both */
+    assert(buffer_insert_chars(&buf, 5, 0, ">", 1) == 0);
+    assert(buffer_delete_line(&buf, 0) == 0);
+    assert(strcmp(buffer_get_line(&buf, 4), ">line 5") == 0);
+    assert(buffer_insert_chars(&buf, 4, 1, "=", 1) == 0);
+    assert(buffer_replace_line(&buf, 4, "replaced") == 0);
+    assert(buffer_insert_chars(&buf, 4, 8, ".", 1) == 0);
+    assert(strcmp(buffer_get_line(&buf, 4), "replaced.") == 0);
+    memmove(model[0], model[1], 7 * sizeof(model[0]));
+    strcpy(model[4], "replaced.");
+
+    /* Random keystrokes on a few lines, checked against the model */
+    srand(5);
+    for (int step = 0; step < 3000; ++step) {
+        size_t line = (size_t)rand() % 3;
+        size_t len = strlen(model[line]);
+        size_t column = (size_t)rand() % (len + 1);
+        if (rand() % 3 != 0 && len < sizeof(model[0]) - 4) {
+            char text[3] = {(char)('a' + rand() % 26), (char)('A' + rand() % 26), '\0'};
+            size_t n = 1 + (size_t)rand() % 2;
+            assert(buffer_insert_chars(&buf, line, column, text, n) == 0);
+            memmove(model[line] + column + n, model[line] + column, len - column + 1);
+            memcpy(model[line] + column, text, n);
+        } else {
+            size_t n = column < len ? 1 + (size_t)rand() % (len - column < 3 ? len - column : 3) : 0;
+            assert(buffer_delete_chars(&buf, line, column, n) == 0);
+            memmove(model[line] + column, model[line] + column + n, len - column - n + 1);
+        }
+        if (step % 100 == 0) {
+            assert(strcmp(buffer_get_line(&buf, line), model[line]) == 0);
+        }
+    }
+    for (size_t i = 0; i < buf.count; ++i) {
+        assert(strcmp(buffer_get_line(&buf, i), model[i]) == 0);
+    }
+    assert(buffer_sync_edit(&buf) == 0);
+    check_offsets(&buf);
+
+    buffer_free(&buf);
+}
+
+/* Block edits mixed with line edits, checked against a plain array */
+static void test_block_edits(void)
+{
+    static char model[MODEL_LINES * 4][16];
+    static char moved[MODEL_LINES * 4][16];
+    size_t model_count = 0;
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    attach_text(&buf, "l0\nl1\nl2\nl3\nl4\nl5\nl6\nl7\n");
+    for (model_count = 0; model_count < 8; ++model_count) {
+        sprintf(model[model_count], "l%zu", model_count);
+    }
+
+    srand(4321);
+    for (int step = 0; step < 3000; ++step) {
+        int op = rand() % 6;
+        size_t at = (size_t)rand() % (model_count + 1);
+        size_t count = (size_t)rand() % 8;
+
+        if (op == 0 && model_count + count < MODEL_LINES * 4) {
+            char text[8 * 16] = "";
+            size_t len = 0;
+            for (size_t i = 0; i <= count; ++i) {
+                len += (size_t)sprintf(text + len, "%sb%d.%zu", i ? "\n" : "", step, i);
+            }
+            assert(buffer_insert_lines(&buf, at, text, len) == 0);
+            memmove(model[at + count + 1], model[at], (model_count - at) * sizeof(model[0]));
+            for (size_t i = 0; i <= count; ++i) {
+                sprintf(model[at + i], "b%d.%zu", step, i);
+            }
+            model_count += count + 1;
+        } else if (op == 1) {
+            count = at + count <= model_count ? count : model_count - at;
+            assert(buffer_delete_lines(&buf, at, count) == 0);
+            memmove(model[at], model[at + count], (model_count - at - count) * sizeof(model[0]));
+            model_count -= count;
+        } else if (op == 2) {
+            count = at + count <= model_count ? count : model_count - at;
+            size_t dest = (size_t)rand() % (model_count - count + 1);
+            assert(buffer_move_lines(&buf, at, count, dest) == 0);
+            memcpy(moved, model[at], count * sizeof(model[0]));
+            memmove(model[at], model[at + count], (model_count - at - count) * sizeof(model[0]));
+            memmove(model[dest + count], model[dest], (model_count - count - dest) * sizeof(model[0]));
+            memcpy(model[dest], moved, count * sizeof(model[0]));
+        } else if (op == 3 && model_count + count < MODEL_LINES * 4) {
+            count = at + count <= model_count ? count : model_count - at;
+            size_t dest = (size_t)rand() % (model_count + 1);
+            assert(buffer_copy_lines(&buf, at, count, dest) == 0);
+            memcpy(moved, model[at], count * sizeof(model[0]));
+            memmove(model[dest + count], model[dest], (model_count - dest) * sizeof(model[0]));
+            memcpy(model[dest], moved, count * sizeof(model[0]));
+            model_count += count;
+        } else if (op == 4 && model_count > 0) {
+            /* Replacing the newest line tries to reuse its arena bytes */
+            at = at < model_count ? at : model_count - 1;
+            sprintf(model[at], "r%d", step);
+            assert(buffer_replace_line(&buf, at, model[at]) == 0);
+        } else if (op == 5 && model_count < MODEL_LINES * 4) {
+            sprintf(model[model_count], "a%d", step);
+            assert(buffer_append_line(&buf, model[model_count]) == 0);
+            model_count++;
+        }
+
+        assert(buf.count == model_count);
+        if (step % 100 == 0) {
+            check_offsets(&buf);
+        }
+    }
+
+    for (size_t i = 0; i < model_count; ++i) {
+        assert(strcmp(buffer_get_line(&buf, i), model[i]) == 0);
+    }
+    check_offsets(&buf);
+
+    /* A copied tail line must survive a replace of its other copy */
+    assert(buffer_append_line(&buf, "tail") == 0);
+    assert(buffer_copy_lines(&buf, buf.count - 1, 1, 0) == 0);
+    assert(buffer_replace_line(&buf, buf.count - 1, "changed") == 0);
+    assert(strcmp(buffer_get_line(&buf, 0), "tail") == 0);
+    assert(strcmp(buffer_get_line(&buf, buf.count - 1), "changed") == 0);
+
+    /* Out-of-range blocks are rejected without changes */
+    size_t lines = buf.count;
+    assert(buffer_delete_lines(&buf, lines, 1) != 0);
+    assert(buffer_move_lines(&buf, 0, lines, 1) != 0);
+    assert(buffer_copy_lines(&buf, 1, lines, 0) != 0);
+    assert(buffer_insert_lines(&buf, lines + 1, "x", 1) != 0);
+    assert(buf.count == lines);
+
+    buffer_free(&buf);
+}
+
+/* Random edits checked against a plain array of strings */
+static int cancel_replace(void *context, const BufferLineEdit *edits, size_t count)
+{
+    *(size_t *)context = count;
+    (void)edits;
+    return -1;
+}
+
+static void test_replace_all(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+    attach_text(&buf, "one two one\r\nnone\nthree\none\n");
+    assert(buffer_insert_line(&buf, 2, "zero") == 0);
+
+    BufferSearch search;
+    size_t replaced = 0;
+    buffer_search_init(&search, "one");
+    assert(buffer_replace_all(&buf, &search, "1", 1, NULL, NULL, &replaced) == 0);
+    assert(replaced == 4);
+    assert(buf.count == 5);
+    assert(strcmp(buffer_get_line(&buf, 0), "1 two 1") == 0);
+    assert(strcmp(buffer_get_line(&buf, 1), "n1") == 0);
+    assert(strcmp(buffer_get_line(&buf, 2), "zero") == 0);
+    assert(strcmp(buffer_get_line(&buf, 4), "1") == 0);
+    assert(buffer_line_offset(&buf, 5) == buffer_size(&buf));
+
+    /* Regex, and lines that end up empty */
+    Pattern *pattern = pattern_compile("^[a-z]+$|[0-9]", NULL);
+    assert(pattern != NULL);
+    buffer_search_init_regex(&search, pattern);
+    assert(buffer_replace_all(&buf, &search, "", 0, NULL, NULL, &replaced) == 0);
+    assert(replaced == 6);
+    assert(strcmp(buffer_get_line(&buf, 0), " two ") == 0);
+    assert(strcmp(buffer_get_line(&buf, 1), "n") == 0);
+    assert(strcmp(buffer_get_line(&buf, 2), "") == 0);
+    assert(strcmp(buffer_get_line(&buf, 3), "") == 0);
+    assert(strcmp(buffer_get_line(&buf, 4), "") == 0);
+    pattern_free(pattern);
+
+    /* No match is a replace of nothing */
+    buffer_search_init(&search, "missing");
+    assert(buffer_replace_all(&buf, &search, "x", 1, NULL, NULL, &replaced) == 0);
+    assert(replaced == 0);
+
+    /* The hook sees the lines and can call the whole replace off */
+    size_t seen = 0;
+    buffer_search_init(&search, "two");
+    assert(buffer_replace_all(&buf, &search, "2", 1, cancel_replace, &seen, &replaced) != 0);
+    assert(seen == 1);
+    assert(strcmp(buffer_get_line(&buf, 0), " two ") == 0);
+    buffer_search_init(&search, "two");
+    assert(buffer_replace_all(&buf, &search, "a\nb", 3, NULL, NULL, &replaced) != 0);
+
+    /* A pattern that only matches the empty string still replaces once per line */
+    pattern = pattern_compile("^", NULL);
+    buffer_search_init_regex(&search, pattern);
+    assert(buffer_replace_all(&buf, &search, ">", 1, NULL, NULL, &replaced) == 0);
+    assert(replaced == 5);
+    assert(strcmp(buffer_get_line(&buf, 0), "> two ") == 0);
+    assert(strcmp(buffer_get_line(&buf, 4), ">") == 0);
+    pattern_free(pattern);
+
+    /* No empty match right after a match, even across batches */
+    assert(buffer_replace_line(&buf, 1, "axxb") == 0);
+    assert(buffer_replace_line(&buf, 2, "xx") == 0);
+    pattern = pattern_compile("x*", NULL);
+    BufferMatch match;
+    size_t columns[3] = { 0, 1, 4 };
+    buffer_search_init_regex(&search, pattern);
+    search.line = 1;
+    for (size_t i = 0; i < 3; ++i) {
+        assert(buffer_find_all(&buf, &search, &match, 1) == 1);
+        assert(match.line == 1 && match.column == columns[i]);
+    }
+    assert(buffer_find_all(&buf, &search, &match, 1) == 1);
+    assert(match.line == 2 && match.column == 0 && match.length == 2);
+    assert(buffer_find_all(&buf, &search, &match, 1) == 1);
+    assert(match.line == 3 && match.column == 0 && match.length == 0);
+
+    buffer_search_init_regex(&search, pattern);
+    assert(buffer_replace_all(&buf, &search, "-", 1, NULL, NULL, &replaced) == 0);
+    assert(strcmp(buffer_get_line(&buf, 1), "-a-b-") == 0);
+    assert(strcmp(buffer_get_line(&buf, 2), "-") == 0);
+    assert(strcmp(buffer_get_line(&buf, 3), "->-") == 0);
+    assert(replaced == 15);
+    pattern_free(pattern);
+
+    /* Typing that has not reached the piece table yet is replaced too */
+    assert(buffer_insert_chars(&buf, 0, 0, "zz", 2) == 0);
+    assert(buf.edit.dirty);
+    buffer_search_init(&search, "zz");
+    assert(buffer_replace_all(&buf, &search, "y", 1, NULL, NULL, &replaced) == 0);
+    assert(replaced == 1 && !buf.edit.dirty);
+    assert(buffer_get_line(&buf, 0)[0] == 'y');
+
+    buffer_free(&buf);
+}
+
+/* A batch replace must match the same lines replaced one at a time */
+static void test_replace_lines(void)
+{
+    TextBuffer batch;
+    TextBuffer single;
+    buffer_init(&batch);
+    buffer_init(&single);
+
+    char line[32];
+    srand(21);
+    for (size_t i = 0; i < MODEL_LINES; ++i) {
+        snprintf(line, sizeof(line), "line %zu", i);
+        assert(buffer_append_line(&batch, line) == 0);
+        assert(buffer_append_line(&single, line) == 0);
+    }
+
+    BufferLineEdit edits[MODEL_LINES];
+    char texts[MODEL_LINES][32];
+    for (int round = 0; round < 20; ++round) {
+        size_t count = 0;
+        for (size_t i = 0; i < MODEL_LINES; ++i) {
+            if (rand() % 4 != 0) {
+                continue;
+            }
+            snprintf(texts[count], sizeof(texts[count]), "r%d %zu%s", round, i, rand() % 2 ? "" : " long");
+            edits[count].line = i;
+            edits[count].text = texts[count];
+            edits[count].len = strlen(texts[count]);
+            assert(buffer_replace_line(&single, i, texts[count]) == 0);
+            count++;
+        }
+        assert(buffer_replace_lines(&batch, edits, count) == 0);
+
+        for (size_t i = 0; i <= MODEL_LINES; ++i) {
+            assert(buffer_line_offset(&batch, i) == buffer_line_offset(&single, i));
+            if (i < MODEL_LINES) {
+                assert(strcmp(buffer_get_line(&batch, i), buffer_get_line(&single, i)) == 0);
+            }
+        }
+    }
+
+    /* Out of order or out of range edits change nothing */
+    edits[0].line = 3;
+    edits[1].line = 3;
+    assert(buffer_replace_lines(&batch, edits, 2) != 0);
+    edits[0].line = MODEL_LINES;
+    assert(buffer_replace_lines(&batch, edits, 1) != 0);
+
+    buffer_free(&batch);
+    buffer_free(&single);
+}
+
+static void test_against_model(void)
+{
+    char model[MODEL_LINES][16];
+    size_t model_count = 0;
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    attach_text(&buf, "l0\nl1\nl2\nl3\nl4\nl5\nl6\nl7\n");
+    for (model_count = 0; model_count < 8; ++model_count) {
+        sprintf(model[model_count], "l%zu", model_count);
+    }
+
+    srand(1234);
+    for (int step = 0; step < 4000; ++step) {
+        int op = rand() % 3;
+        char text[16];
+        sprintf(text, "s%d", step);
+
+        if (op == 0 && model_count < MODEL_LINES) {
+            size_t at = (size_t)rand() % (model_count + 1);
+            assert(buffer_insert_line(&buf, at, text) == 0);
+            memmove(model[at + 1], model[at], (model_count - at) * sizeof(model[0]));
+            strcpy(model[at], text);
+            model_count++;
+        } else if (op == 1 && model_count > 0) {
+            size_t at = (size_t)rand() % model_count;
+            assert(buffer_delete_line(&buf, at) == 0);
+            memmove(model[at], model[at + 1], (model_count - at - 1) * sizeof(model[0]));
+            model_count--;
+        } else if (model_count > 0) {
+            size_t at = (size_t)rand() % model_count;
+            assert(buffer_replace_line(&buf, at, text) == 0);
+            strcpy(model[at], text);
+        }
+
+        assert(buf.count == model_count);
+    }
+
+    for (size_t i = 0; i < model_count; ++i) {
+        assert(strcmp(buffer_get_line(&buf, i), model[i]) == 0);
+    }
+
+    buffer_free(&buf);
+}
+
 int main(void)
 {
     TextBuffer buf;
@@ -37,8 +850,24 @@ int main(void)
     assert(buffer_delete_line(&buf, idx) == 0);
     assert(buf.count == 2);
 
-    printf("All buffer tests passed.\n");
-
     buffer_free(&buf);
+
+    test_piece_table();
+    test_find_all();
+    test_find_regex();
+    test_find_all_parallel();
+    test_parallel_attach();
+    test_lazy_attach();
+    test_attach_release();
+    test_arena();
+    test_offsets();
+    test_embedded_nul();
+    test_char_edits();
+    test_against_model();
+    test_block_edits();
+    test_replace_all();
+    test_replace_lines();
+
+    printf("All buffer tests passed.\n");
     return 0;
 }
@@ -0,0 +1,196 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: test_editor.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "pattern.h"
+
+#define TEST_FILE "test_editor.tmp"
+
+static int run_text(EditorState *editor, const char *text, EditorScriptResult *result)
+{
+    FILE *script = tmpfile();
+    assert(script != NULL);
+    fputs(text, script);
+    rewind(script);
+    int rc = editor_run_script(editor, script, result);
+    fclose(script);
+    return rc;
+}
+
+/* Runs the interactive menu on `input`, with its output thrown away */
+static void run_menu(EditorState *editor, const char *input)
+{
+    FILE *keys = tmpfile();
+    assert(keys != NULL);
+    fputs(input, keys);
+    rewind(keys);
+
+    fflush(stdout);
+    int saved_in = dup(STDIN_FILENO);
+    int saved_out = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    assert(saved_in >= 0 && saved_out >= 0 && null_fd >= 0);
+    dup2(fileno(keys), STDIN_FILENO);
+    dup2(null_fd, STDOUT_FILENO);
+
+    editor_run(editor);
+
+    fflush(stdout);
+    dup2(saved_in, STDIN_FILENO);
+    dup2(saved_out, STDOUT_FILENO);
+    clearerr(stdin);
+    close(saved_in);
+    close(saved_out);
+    close(null_fd);
+    fclose(keys);
+}
+
+static void assert_file(const char *filename, const char *expected)
+{
+    char text[256];
+    FILE *fp = fopen(filename, "rb");
+    assert(fp != NULL);
+    size_t len = fread(text, 1, sizeof(text) - 1, fp);
+    fclose(fp);
+    text[len] = '\0';
+    assert(strcmp(text, expected) == 0);
+}
+
+static void test_script(void)
+{
+    EditorState editor;
+    EditorScriptResult result;
+    editor_init_with(&editor, NULL, 1);
+
+    assert(run_text(&editor,
+                    "# build a file\n"
+                    "a two\n"
+                    "a four\n"
+                    "i 1 one\n"
+                    "\n"
+                    "i 3 three\n"
+                    "r 4 FOUR and more\n"
+                    "a\n"
+                    "d 5\n"
+                    "w " TEST_FILE "\n",
+                    &result) == 0);
+    assert(result.commands == 8);
+    assert(result.error == NULL);
+    assert(editor.is_modified == 0);
+    assert(strcmp(editor.current_filename, TEST_FILE) == 0);
+    assert_file(TEST_FILE, "one\ntwo\nthree\nFOUR and more\n");
+
+    /* A second save goes to the current file, patched in place */
+    assert(run_text(&editor, "r 2 TWO\nw\n", &result) == 0);
+    assert_file(TEST_FILE, "one\nTWO\nthree\nFOUR and more\n");
+
+    editor_free(&editor);
+
+    /* Scripts can start from an existing file */
+    editor_init_with(&editor, TEST_FILE, 1);
+    assert(editor.buffer.count == 4);
+    assert(run_text(&editor, "d 1\nd 1\nw\n", &result) == 0);
+    assert_file(TEST_FILE, "three\nFOUR and more\n");
+
+    /* Block commands */
+    assert(run_text(&editor, "a 3\na 4\na 5\nm 1 2 6\nc 4 5 1\nD 3 5\nw\n", &result) == 0);
+    assert_file(TEST_FILE, "three\nFOUR and more\nthree\nFOUR and more\n");
+    assert(run_text(&editor, "m 2 2 1\nD 3 4\nw\n", &result) == 0);
+    assert_file(TEST_FILE, "FOUR and more\nthree\n");
+    editor_free(&editor);
+
+    remove(TEST_FILE);
+}
+
+static void test_script_errors(void)
+{
+    static const char *bad[] = {
+        "x 1\n", "ab\n", "i 0 zero\n", "i 3 past the end\n", "r 2 x\n", "d\n",
+        "d 1x\n", "r one\n", "d 99999999999999999999999\n", "w\n",
+        "D 1\n", "D 1 2\n", "m 1 1\n", "m 1 1 3\n", "c 1 1 0\n", "c 1 1 2 x\n",
+    };
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        EditorState editor;
+        EditorScriptResult result;
+        editor_init_with(&editor, NULL, 1);
+
+        char text[128];
+        snprintf(text, sizeof(text), "a first\n\n%s", bad[i]);
+        assert(run_text(&editor, text, &result) == -1);
+        assert(result.commands == 1);
+        assert(result.line == 3);
+        assert(result.error != NULL);
+        assert(editor.buffer.count == 1);
+
+        editor_free(&editor);
+    }
+}
+
+/* Searching for the same pattern again reuses its compiled form */
+static void test_search_cache(void)
+{
+    EditorState editor;
+    EditorScriptResult result;
+    editor_init_with(&editor, NULL, 1);
+    assert(run_text(&editor, "a foo bar baz\n", &result) == 0);
+
+    size_t compiles = pattern_cache_compiles();
+    run_menu(&editor, "6\n/ba[rz]/\n6\n/ba[rz]/\n18\n/ba[rz]/\nX\n");
+    assert(pattern_cache_compiles() == compiles + 1);
+    assert(strcmp(buffer_get_line(&editor.buffer, 0), "foo X X") == 0);
+
+    editor_free(&editor);
+}
+
+/* Names that do not fit current_filename are refused, never cut short */
+static void test_long_filename(void)
+{
+    char name[EDITOR_FILENAME_MAX + 8];
+    memset(name, 'n', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+
+    EditorState editor;
+    editor_init_with(&editor, name, 1);
+    assert(editor.current_filename[0] == '\0');
+
+    char input[3 * sizeof(name)];
+    snprintf(input, sizeof(input), "3\nline\n8\n%s\n12\n%s\n", name, name);
+    run_menu(&editor, input);
+    assert(editor.current_filename[0] == '\0');
+    assert(editor.is_modified == 1);
+    assert(!editor.save_job.running);
+
+    EditorScriptResult result;
+    snprintf(input, sizeof(input), "w %s\n", name);
+    assert(run_text(&editor, input, &result) == -1);
+    assert(editor.current_filename[0] == '\0');
+
+    editor_free(&editor);
+}
+
+int main(void)
+{
+    test_script();
+    test_script_errors();
+    test_search_cache();
+    test_long_filename();
+
+    printf("All editor tests passed.\n");
+    return 0;
+}
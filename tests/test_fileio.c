@@ -0,0 +1,867 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: test_fileio.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "buffer.h"
+#include "fileio.h"
+#include "stats.h"
+#include "util.h"
+
+#define TEST_FILE "test_fileio.tmp"
+
+static void write_file(const char *text)
+{
+    FILE *fp = fopen(TEST_FILE, "wb");
+    assert(fp != NULL);
+    fputs(text, fp);
+    fclose(fp);
+}
+
+static void test_load_mode(FileMapMode mode)
+{
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.map = mode;
+
+    TextBuffer buf;
+    buffer_init(&buf);
+
+    write_file("first\r\nsecond\n\nlast");
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == 4);
+    assert(strcmp(buffer_get_line(&buf, 0), "first") == 0);
+    assert(strcmp(buffer_get_line(&buf, 2), "") == 0);
+    assert(strcmp(buffer_get_line(&buf, 3), "last") == 0);
+    assert(buffer_find(&buf, "cond") == 1);
+
+    /* Saving over the loaded file must not disturb the lines still read from it */
+    assert(buffer_replace_line(&buf, 1, "changed") == 0);
+    assert(file_save(TEST_FILE, &buf) == 0);
+    assert(strcmp(buffer_get_line(&buf, 3), "last") == 0);
+
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == 4);
+    assert(strcmp(buffer_get_line(&buf, 0), "first") == 0);
+    assert(strcmp(buffer_get_line(&buf, 1), "changed") == 0);
+
+    buffer_free(&buf);
+}
+
+/* A mapped file cut short by someone else reads as NUL bytes, not SIGBUS */
+static void test_truncated_mapping(void)
+{
+    FILE *fp = fopen(TEST_FILE, "wb");
+    assert(fp != NULL);
+    for (int i = 0; i < 64; ++i) {
+        fprintf(fp, "%04d %0995d\n", i, 0);
+    }
+    fclose(fp);
+
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.map = FILE_MAP_ALWAYS;
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == 64);
+    assert(file_mapping_truncated() == 0);
+
+    assert(truncate(TEST_FILE, 4096) == 0);
+    size_t len = 0;
+    const char *line = buffer_get_line_n(&buf, 63, &len);
+    assert(line != NULL && len == 1000);
+    for (size_t i = 0; i < len; ++i) {
+        assert(line[i] == '\0');
+    }
+    assert(file_mapping_truncated() == 1);
+    assert(file_mapping_truncated() == 0);
+    assert(strncmp(buffer_get_line(&buf, 0), "0000 ", 5) == 0);
+    assert(buffer_find(&buf, "0063") == INVALID_INDEX);
+
+    buffer_free(&buf);
+}
+
+/* Lines far longer than any fixed buffer must survive load and save intact */
+static void test_long_lines(void)
+{
+    size_t long_len = LINE_READER_CHUNK_SIZE * 2 + 17;
+    char *long_line = (char *)malloc(long_len + 1);
+    assert(long_line != NULL);
+    memset(long_line, 'j', long_len);
+    long_line[long_len] = '\0';
+
+    FILE *fp = fopen(TEST_FILE, "wb");
+    assert(fp != NULL);
+    fprintf(fp, "short\n%s\r\ntail", long_line);
+    fclose(fp);
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load(TEST_FILE, &buf) == 0);
+    assert(buf.count == 3);
+    assert(strcmp(buffer_get_line(&buf, 1), long_line) == 0);
+    assert(file_save(TEST_FILE, &buf) == 0);
+    buffer_free(&buf);
+
+    /* The streaming reader used for pipes sees the same lines */
+    fp = fopen(TEST_FILE, "rb");
+    assert(fp != NULL);
+    LineReader reader;
+    assert(line_reader_init(&reader, fp) == 0);
+
+    char *line = NULL;
+    size_t len = 0;
+    assert(line_reader_next(&reader, &line, &len) == 0);
+    assert(len == 5 && strcmp(line, "short") == 0);
+    assert(line_reader_next(&reader, &line, &len) == 0);
+    assert(len == long_len && strcmp(line, long_line) == 0);
+    assert(line_reader_next(&reader, &line, &len) == 0);
+    assert(len == 4 && strcmp(line, "tail") == 0);
+    assert(line_reader_next(&reader, &line, &len) == 1);
+
+    line_reader_free(&reader);
+    fclose(fp);
+    free(long_line);
+}
+
+static char *read_path(const char *path, size_t *out_len)
+{
+    FILE *fp = fopen(path, "rb");
+    assert(fp != NULL);
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    char *data = (char *)malloc((size_t)size + 1);
+    assert(data != NULL);
+    assert(fread(data, 1, (size_t)size, fp) == (size_t)size);
+    fclose(fp);
+    *out_len = (size_t)size;
+    return data;
+}
+
+static char *read_file(size_t *out_len)
+{
+    return read_path(TEST_FILE, out_len);
+}
+
+/* Batched saves must write exactly the lines buffer_get_line reports */
+static void test_save_batches(void)
+{
+    FILE *fp = fopen(TEST_FILE, "wb");
+    assert(fp != NULL);
+    for (int i = 0; i < 5000; ++i) {
+        fprintf(fp, i % 7 == 0 ? "line %d\r\n" : "line %d\n", i);
+    }
+    fputs("unterminated", fp);
+    fclose(fp);
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load(TEST_FILE, &buf) == 0);
+    for (size_t i = 0; i < 3000; i += 3) {
+        assert(buffer_replace_line(&buf, i, i % 2 ? "odd" : "") == 0);
+    }
+    assert(buffer_insert_line(&buf, 0, "head") == 0);
+    assert(buffer_delete_line(&buf, 4000) == 0);
+
+    size_t expected_len = 0;
+    char *expected = (char *)malloc(buf.count * 16);
+    assert(expected != NULL);
+    for (size_t i = 0; i < buf.count; ++i) {
+        const char *line = buffer_get_line(&buf, i);
+        size_t len = strlen(line);
+        memcpy(expected + expected_len, line, len);
+        expected[expected_len + len] = '\n';
+        expected_len += len + 1;
+    }
+
+    assert(file_save(TEST_FILE, &buf) == 0);
+    size_t saved_len = 0;
+    char *saved = read_file(&saved_len);
+    assert(saved_len == expected_len && memcmp(saved, expected, saved_len) == 0);
+
+    free(saved);
+    free(expected);
+    buffer_free(&buf);
+}
+
+/* The document as file_save would write it */
+static char *document_text(const TextBuffer *buf, size_t *out_len)
+{
+    size_t len = buffer_size(buf);
+    char *text = (char *)malloc(len + 1);
+    assert(text != NULL);
+    len = 0;
+    for (size_t i = 0; i < buf->count; ++i) {
+        size_t line_len = 0;
+        const char *line = buffer_get_line_n(buf, i, &line_len);
+        memcpy(text + len, line, line_len);
+        text[len + line_len] = '\n';
+        len += line_len + 1;
+    }
+    assert(len == buffer_size(buf));
+    *out_len = len;
+    return text;
+}
+
+static FileSaveMode save_and_check(TextBuffer *buf, FileStamp *stamp, size_t *bytes_written)
+{
+    size_t expected_len = 0;
+    char *expected = document_text(buf, &expected_len);
+
+    FileSaveResult result;
+    assert(file_save_incremental(TEST_FILE, buf, stamp, &result) == 0);
+    assert(stamp->valid);
+
+    size_t saved_len = 0;
+    char *saved = read_file(&saved_len);
+    assert(saved_len == expected_len && memcmp(saved, expected, saved_len) == 0);
+    free(saved);
+
+    /* The buffer must still show the same document after rebasing on the file */
+    size_t after_len = 0;
+    char *after = document_text(buf, &after_len);
+    assert(after_len == expected_len && memcmp(after, expected, after_len) == 0);
+    free(after);
+    free(expected);
+
+    if (bytes_written) {
+        *bytes_written = result.bytes_written;
+    }
+    return result.mode;
+}
+
+static void test_incremental_save(FileMapMode mode)
+{
+    FILE *fp = fopen(TEST_FILE, "wb");
+    assert(fp != NULL);
+    for (int i = 0; i < 200; ++i) {
+        fprintf(fp, "line %03d\n", i);
+    }
+    fclose(fp);
+
+    FileStamp stamp;
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.map = mode;
+    options.stamp = &stamp;
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(stamp.valid);
+
+    size_t written = 0;
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_UNCHANGED && written == 0);
+
+    /* Same-length edits are patched where they stand */
+    assert(buffer_replace_line(&buf, 50, "LINE 050") == 0);
+    assert(buffer_replace_line(&buf, 51, "LINE 051") == 0);
+    assert(buffer_replace_line(&buf, 120, "LINE 120") == 0);
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_PATCHED && written == 27);
+
+    /* Growing and shrinking lines rewrite from the first line that moved */
+    assert(buffer_replace_line(&buf, 190, "a longer line 190") == 0);
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_SUFFIX && written == 18 + 9 * 9);
+    assert(buffer_insert_line(&buf, 10, "inserted line") == 0);
+    assert(buffer_delete_line(&buf, 150) == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_SUFFIX);
+    assert(buffer_delete_line(&buf, 3) == 0);
+    assert(buffer_insert_line(&buf, 100, "again") == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_SUFFIX);
+
+    /* Text moving both ways is only safe to stream from a private copy */
+    assert(buffer_insert_line(&buf, 5, "grow") == 0);
+    assert(buffer_delete_line(&buf, 60) == 0);
+    assert(buffer_delete_line(&buf, 60) == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == (mode == FILE_MAP_ALWAYS ? FILE_SAVE_FULL : FILE_SAVE_SUFFIX));
+
+    /* Dropping lines at the end only truncates */
+    size_t before = buf.count;
+    assert(buffer_delete_line(&buf, before - 1) == 0);
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_SUFFIX && written == 0);
+
+    /* A file changed behind the buffer's back is written whole */
+    fp = fopen(TEST_FILE, "ab");
+    assert(fp != NULL);
+    fputs("external\n", fp);
+    fclose(fp);
+    assert(buffer_replace_line(&buf, 0, "LINE 000") == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_FULL);
+    assert(buffer_replace_line(&buf, 1, "LINE 001") == 0);
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_PATCHED && written == 9);
+
+    /* The safe save replaces the file whole; the buffer then maps the new one */
+    struct stat old_st;
+    struct stat new_st;
+    assert(stat(TEST_FILE, &old_st) == 0);
+    assert(buffer_replace_line(&buf, 2, "LINE 002") == 0);
+    FileSaveResult result;
+    assert(file_save_full(TEST_FILE, &buf, &stamp, &result) == 0 && result.mode == FILE_SAVE_FULL);
+    assert(result.rebased && result.bytes_written == buffer_size(&buf));
+    assert(buf.piece_count == 1 && buf.arena.block_count == 0);
+    assert(stat(TEST_FILE, &new_st) == 0 && new_st.st_ino != old_st.st_ino);
+    assert(stamp.valid && stamp.inode == (unsigned long long)new_st.st_ino);
+    assert(strcmp(buffer_get_line(&buf, 2), "LINE 002") == 0);
+    assert(buffer_replace_line(&buf, 3, "LINE 003") == 0);
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_PATCHED && written == 9);
+
+    buffer_free(&buf);
+
+    /* CRLF files and unterminated last lines change when saved */
+    write_file("a\r\nb\r\n");
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_FULL);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_UNCHANGED);
+    write_file("a\nb");
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(save_and_check(&buf, &stamp, &written) == FILE_SAVE_SUFFIX && written == 2);
+    buffer_free(&buf);
+}
+
+static void test_embedded_nul(FileMapMode mode)
+{
+    static const char text[] = "a\0b\nplain\n\0\0\nend\0\n";
+    FILE *fp = fopen(TEST_FILE, "wb");
+    assert(fp != NULL);
+    fwrite(text, 1, sizeof(text) - 1, fp);
+    fclose(fp);
+
+    FileStamp stamp;
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.map = mode;
+    options.stamp = &stamp;
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == 4);
+
+    size_t len = 0;
+    const char *line = buffer_get_line_n(&buf, 0, &len);
+    assert(len == 3 && memcmp(line, "a\0b", 3) == 0);
+    line = buffer_get_line_n(&buf, 3, &len);
+    assert(len == 4 && memcmp(line, "end\0", 4) == 0);
+
+    /* Edited lines keep their NULs through saves and the rebase after them */
+    assert(buffer_replace_line_n(&buf, 1, "pl\0in", 5) == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_PATCHED);
+    assert(buffer_insert_line_n(&buf, 0, "\0head", 5) == 0);
+    assert(save_and_check(&buf, &stamp, NULL) == FILE_SAVE_SUFFIX);
+    assert(file_save(TEST_FILE, &buf) == 0);
+
+    size_t saved_len = 0;
+    char *saved = read_file(&saved_len);
+    assert(saved_len == 24 && memcmp(saved, "\0head\na\0b\npl\0in\n\0\0\nend\0\n", 24) == 0);
+    free(saved);
+
+    BufferSearch search;
+    BufferMatch match;
+    buffer_search_init_n(&search, "\0b", 2);
+    assert(buffer_find_all(&buf, &search, &match, 1) == 1);
+    assert(match.line == 1 && match.column == 1);
+    buffer_search_init_n(&search, "\0\n", 2);
+    assert(buffer_find_all(&buf, &search, &match, 1) == 0);
+
+    buffer_free(&buf);
+}
+
+/* A pipe is read through the line reader and must keep NULs as mapped files do */
+static void test_stream_nul(void)
+{
+    static const char text[] = "a\0b\nplain\r\n\0\0\nend\0";
+    const char *fifo = TEST_FILE ".fifo";
+    remove(fifo);
+    assert(mkfifo(fifo, 0600) == 0);
+
+    pid_t child = fork();
+    assert(child >= 0);
+    if (child == 0) {
+        FILE *fp = fopen(fifo, "wb");
+        size_t written = fp ? fwrite(text, 1, sizeof(text) - 1, fp) : 0;
+        _exit(fp && written == sizeof(text) - 1 && fclose(fp) == 0 ? 0 : 1);
+    }
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    int rc = file_load(fifo, &buf);
+    int status = 0;
+    assert(waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(rc == 0 && buf.count == 4);
+
+    size_t len = 0;
+    const char *line = buffer_get_line_n(&buf, 0, &len);
+    assert(len == 3 && memcmp(line, "a\0b", 3) == 0);
+    line = buffer_get_line_n(&buf, 1, &len);
+    assert(len == 5 && memcmp(line, "plain", 5) == 0);
+    line = buffer_get_line_n(&buf, 2, &len);
+    assert(len == 2 && memcmp(line, "\0\0", 2) == 0);
+    line = buffer_get_line_n(&buf, 3, &len);
+    assert(len == 4 && memcmp(line, "end\0", 4) == 0);
+
+    buffer_free(&buf);
+    remove(fifo);
+}
+
+static void test_snapshot_save(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+    for (int i = 0; i < 3000; ++i) {
+        char line[32];
+        sprintf(line, "line %d", i);
+        assert(buffer_append_line(&buf, line) == 0);
+    }
+    assert(buffer_insert_chars(&buf, 0, 0, ">", 1) == 0);
+    assert(buffer_sync_edit(&buf) == 0);
+
+    size_t expected_len = 0;
+    char *expected = document_text(&buf, &expected_len);
+
+    /* Edits after the snapshot, including rewrites of the arena's last line */
+    FileSaveJob job;
+    file_save_job_init(&job);
+    assert(file_save_finish(&job, &buf, 1) == 0);
+    assert(file_save_start(&job, TEST_FILE, &buf) == 0);
+    assert(job.snapshot.size == expected_len);
+    assert(file_save_start(&job, TEST_FILE, &buf) != 0);
+    for (int i = 0; i < 100; ++i) {
+        assert(buffer_replace_line(&buf, buf.count - 1, i % 2 ? "short" : "a much longer replacement line") == 0);
+        assert(buffer_insert_chars(&buf, 5, 0, "typed", 5) == 0);
+        assert(buffer_delete_line(&buf, 10) == 0);
+    }
+    assert(file_save_finish(&job, &buf, 1) == 1);
+    assert(job.result == 0);
+    assert(!job.running && buf.arena.pinned == 0);
+
+    size_t saved_len = 0;
+    char *saved = read_file(&saved_len);
+    assert(saved_len == expected_len && memcmp(saved, expected, saved_len) == 0);
+    free(saved);
+    free(expected);
+
+    /* Once released, the buffer reuses its tail line again */
+    size_t blocks = buf.arena.block_count;
+    for (int i = 0; i < 20000; ++i) {
+        assert(buffer_replace_line(&buf, buf.count - 1, "x") == 0);
+    }
+    assert(buf.arena.block_count == blocks);
+
+    /* A new file gets the umask's permissions; the umask itself is left alone */
+    mode_t mask = umask(0);
+    umask(mask);
+    remove(TEST_FILE ".new");
+    assert(file_save_start(&job, TEST_FILE ".new", &buf) == 0);
+    assert(file_save_finish(&job, &buf, 1) == 1 && job.result == 0);
+    struct stat st;
+    assert(stat(TEST_FILE ".new", &st) == 0 && (st.st_mode & 0777) == (0666 & ~mask));
+    assert(umask(mask) == mask);
+    remove(TEST_FILE ".new");
+
+    /* Failures are reported through the job */
+    assert(file_save_start(&job, "no-such-dir/test.tmp", &buf) == 0);
+    assert(file_save_finish(&job, &buf, 1) == 1);
+    assert(job.result != 0 && job.error == ENOENT);
+
+    buffer_free(&buf);
+}
+
+/* Counters move only while enabled, by the bytes each operation handled */
+/* A lazily indexed file must end up as the same document as a full load */
+static void test_lazy_load(void)
+{
+    /* Several index chunks, CRLF lines past the prefix and no final newline */
+    size_t size = FILE_INDEX_PREFIX + 2 * FILE_INDEX_CHUNK + 12345;
+    char *text = (char *)malloc(size + 1);
+    assert(text != NULL);
+    for (size_t i = 0; i < size; ++i) {
+        size_t column = i % 61;
+        text[i] = column == 60 ? '\n' : (char)('a' + column % 26);
+        if (column == 59 && i > FILE_INDEX_PREFIX && i % 7 == 0) {
+            text[i] = '\r';
+        }
+    }
+    text[size] = '\0';
+    write_file(text);
+    free(text);
+
+    TextBuffer full;
+    buffer_init(&full);
+    assert(file_load(TEST_FILE, &full) == 0);
+
+    FileIndexJob job;
+    file_index_job_init(&job);
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.map = FILE_MAP_ALWAYS;
+    options.index = &job;
+    options.lazy_threshold = 1;
+
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(job.running);
+    assert(buf.count > 0 && buf.count <= FILE_INDEX_PREFIX / 61);
+    assert(buffer_original_pending(&buf) > 0);
+    assert(strcmp(buffer_get_line(&buf, 0), buffer_get_line(&full, 0)) == 0);
+    assert(file_save(TEST_FILE ".copy", &buf) != 0);
+
+    int rc;
+    while ((rc = file_index_collect(&job, &buf, 0)) == 0) {
+    }
+    assert(rc == 1);
+    assert(!job.running);
+    assert(buffer_original_pending(&buf) == 0);
+    assert(buf.count == full.count);
+    assert(buffer_size(&buf) == buffer_size(&full));
+    for (size_t i = 0; i < full.count; i += 997) {
+        assert(strcmp(buffer_get_line(&buf, i), buffer_get_line(&full, i)) == 0);
+        assert(buffer_line_offset(&buf, i) == buffer_line_offset(&full, i));
+    }
+    assert(strcmp(buffer_get_line(&buf, buf.count - 1), buffer_get_line(&full, full.count - 1)) == 0);
+
+    /* Pages can be given back at any time; they read back the same */
+    file_trim_mapping(&buf, 0, 4096);
+    assert(strcmp(buffer_get_line(&buf, buf.count / 2), buffer_get_line(&full, full.count / 2)) == 0);
+
+    /* Waiting collects everything at once, whenever during the scan it starts */
+    for (int round = 0; round < 8; ++round) {
+        assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+        struct timespec pause = {0, (long)round * 1000000};
+        nanosleep(&pause, NULL);
+        assert(job.running);
+        assert(file_index_collect(&job, &buf, 1) == 1);
+        assert(!job.running && buf.count == full.count);
+        assert(file_index_collect(&job, &buf, 1) == 1);
+    }
+
+    /* Cancelling leaves the prefix */
+    file_index_cancel(&job);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    file_index_cancel(&job);
+    assert(!job.running);
+    assert(buf.count < full.count);
+
+    buffer_free(&buf);
+    buffer_free(&full);
+}
+
+#define TEST_CACHE TEST_FILE FILE_LINE_CACHE_SUFFIX
+
+static void test_line_cache(void)
+{
+    /* Enough lines for many samples and scan chunks, CRLF lines and no final newline */
+    size_t size = 3 * 1024 * 1024 + 777;
+    char *text = (char *)malloc(size + 1);
+    assert(text != NULL);
+    for (size_t i = 0; i < size; ++i) {
+        size_t column = i % 61;
+        text[i] = column == 60 ? '\n' : (char)('a' + column % 26);
+        if (column == 59 && i % 5 == 0) {
+            text[i] = '\r';
+        }
+    }
+    text[size] = '\0';
+    write_file(text);
+    remove(TEST_CACHE);
+
+    TextBuffer full;
+    buffer_init(&full);
+    assert(file_load(TEST_FILE, &full) == 0);
+    assert(fopen(TEST_CACHE, "rb") == NULL);
+
+    FileLineIndex cache;
+    file_line_index_init(&cache);
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.threads = 4;
+    options.line_cache = &cache;
+    options.line_cache_min = 1;
+
+    /* The first load writes the cache, later ones use it */
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(cache.lines == full.count && cache.stride == FILE_LINE_STRIDE);
+    size_t cache_len = 0;
+    char *saved = read_path(TEST_CACHE, &cache_len);
+    for (int map = 0; map < 2; ++map) {
+        options.map = map ? FILE_MAP_ALWAYS : FILE_MAP_NEVER;
+        assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+        assert(cache.lines == full.count);
+        assert(buf.count == full.count && buffer_size(&buf) == buffer_size(&full));
+        for (size_t i = 0; i < full.count; i += 331) {
+            assert(strcmp(buffer_get_line(&buf, i), buffer_get_line(&full, i)) == 0);
+            assert(buffer_line_offset(&buf, i) == buffer_line_offset(&full, i));
+        }
+        assert(strcmp(buffer_get_line(&buf, buf.count - 1), buffer_get_line(&full, full.count - 1)) == 0);
+    }
+
+    /* Any line is found from its sample; nothing past the end is */
+    size_t offset = 0;
+    for (size_t i = 0; i < full.count; i += 97) {
+        assert(file_line_locate(&cache, &buf, i, &offset) == 0);
+        assert(offset == full.original.starts[i]);
+    }
+    assert(file_line_locate(&cache, &buf, full.count, &offset) != 0);
+    BufferSpan span;
+    assert(file_line_span(&cache, &buf, full.count - 2, full.count, &span) == 0);
+    assert(span.data + span.len == buf.original.data + size);
+    assert(span.len == size - full.original.starts[full.count - 2]);
+
+    /* Samples that no longer match still load correctly and are rewritten */
+    assert(cache.sample_count == 51);
+    FILE *fp = fopen(TEST_CACHE, "r+b");
+    assert(fp != NULL);
+    unsigned long long sample = 0;
+    long at = (long)(cache_len - 17 * sizeof(sample)); /* where the last of 3 scan chunks starts */
+    assert(fseek(fp, at, SEEK_SET) == 0 && fread(&sample, sizeof(sample), 1, fp) == 1);
+    sample += 61;
+    assert(fseek(fp, at, SEEK_SET) == 0 && fwrite(&sample, sizeof(sample), 1, fp) == 1);
+    fclose(fp);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == full.count);
+    assert(buffer_line_offset(&buf, full.count - 1) == buffer_line_offset(&full, full.count - 1));
+    size_t len = 0;
+    char *rewritten = read_path(TEST_CACHE, &len);
+    assert(len == cache_len && memcmp(rewritten, saved, len) == 0);
+    free(rewritten);
+
+    /* Huge-file mode: a valid cache knows every line before indexing ends */
+    FileIndexJob job;
+    file_index_job_init(&job);
+    options.map = FILE_MAP_ALWAYS;
+    options.index = &job;
+    options.lazy_threshold = 1;
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(job.running && buf.count < full.count);
+    assert(cache.lines == full.count);
+    assert(file_line_span(&cache, &buf, full.count - 3, full.count - 1, &span) == 0);
+    assert(span.data == buf.original.data + full.original.starts[full.count - 3]);
+    assert(span.len == full.original.starts[full.count - 1] - full.original.starts[full.count - 3]);
+    assert(file_index_collect(&job, &buf, 1) == 1);
+    assert(buf.count == full.count);
+
+    /* Without one, it is written once the indexing thread is done */
+    remove(TEST_CACHE);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(job.running && cache.lines == 0);
+    assert(file_line_span(&cache, &buf, 0, 1, &span) != 0);
+    assert(file_index_collect(&job, &buf, 1) == 1);
+    assert(cache.lines == full.count);
+    rewritten = read_path(TEST_CACHE, &len);
+    assert(len == cache_len && memcmp(rewritten, saved, len) == 0);
+    free(rewritten);
+
+    /* A changed file does not match its old cache */
+    text[size - 1] = '\n';
+    write_file(text);
+    options.index = NULL;
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == full.count && cache.lines == full.count);
+    rewritten = read_path(TEST_CACHE, &len);
+    assert(len == cache_len && memcmp(rewritten, saved, len) != 0);
+    free(rewritten);
+
+    /* Small files get no cache */
+    remove(TEST_CACHE);
+    options.line_cache_min = FILE_LINE_CACHE_MIN;
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(cache.lines == 0);
+    assert(fopen(TEST_CACHE, "rb") == NULL);
+
+    free(saved);
+    free(text);
+    file_line_index_free(&cache);
+    buffer_free(&buf);
+    buffer_free(&full);
+}
+
+static void append_file(const char *name, const char *text, size_t len)
+{
+    FILE *fp = fopen(name, "ab");
+    assert(fp != NULL);
+    assert(fwrite(text, 1, len, fp) == len);
+    fclose(fp);
+}
+
+static FileFollowEvent follow_update(FileFollow *follow, TextBuffer *buf, FileStamp *stamp)
+{
+    FileFollowEvent event;
+    assert(file_follow_update(follow, buf, stamp, &event) == 0);
+    return event;
+}
+
+static void test_follow(void)
+{
+    write_file("a\nb\npar");
+    FileStamp stamp;
+    FileLoadOptions options;
+    file_load_options_init(&options);
+    options.stamp = &stamp;
+    TextBuffer buf;
+    buffer_init(&buf);
+    assert(file_load_with(TEST_FILE, &buf, &options) == 0);
+    assert(buf.count == 3);
+
+    /* Bytes written since the load are all that is read */
+    append_file(TEST_FILE, "tial\nc\r\nd", 9);
+    FileFollow follow;
+    FileFollowEvent event;
+    assert(file_follow_start(&follow, TEST_FILE, &buf, &stamp, &event) == 0);
+    assert(event == FILE_FOLLOW_IDLE && buf.count == 3);
+    assert(file_follow_wait(&follow, -1, 0) == 0);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_APPENDED);
+    assert(buf.count == 5);
+    assert(strcmp(buffer_get_line(&buf, 2), "partial") == 0);
+    assert(strcmp(buffer_get_line(&buf, 3), "c") == 0);
+    assert(strcmp(buffer_get_line(&buf, 4), "d") == 0);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_IDLE);
+
+    /* A partial last line grows in place; a CR waits for what follows it */
+    append_file(TEST_FILE, "one\r", 4);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_APPENDED);
+    assert(buf.count == 5 && strcmp(buffer_get_line(&buf, 4), "done") == 0);
+    append_file(TEST_FILE, "\n\ne\n", 4);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_APPENDED);
+    assert(buf.count == 7);
+    assert(strcmp(buffer_get_line(&buf, 4), "done") == 0);
+    assert(strcmp(buffer_get_line(&buf, 5), "") == 0);
+    assert(strcmp(buffer_get_line(&buf, 6), "e") == 0);
+
+    /* Many reads' worth at once, with CRLFs split across reads */
+    size_t size = 3 * FILE_FOLLOW_READ + 100;
+    char *text = (char *)malloc(size);
+    assert(text != NULL);
+    size_t lines = 0;
+    for (size_t i = 0; i < size; ++i) {
+        size_t column = i % 9;
+        text[i] = column == 8 ? '\n' : column == 7 ? '\r' : 'x';
+        lines += text[i] == '\n';
+    }
+    append_file(TEST_FILE, text, size);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_APPENDED);
+    assert(buf.count == 7 + lines + 1);
+    for (size_t i = 7; i < buf.count - 1; ++i) {
+        assert(strcmp(buffer_get_line(&buf, i), "xxxxxxx") == 0);
+    }
+    free(text);
+
+    /* A truncated file is loaded anew */
+    write_file("x\ny\n");
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_TRUNCATED);
+    assert(buf.count == 2 && strcmp(buffer_get_line(&buf, 1), "y") == 0);
+    assert(stamp.valid && stamp.size == 4);
+
+    /* Rotation: the old file is read to its end before the new one is loaded */
+    append_file(TEST_FILE, "z\n", 2);
+    assert(rename(TEST_FILE, TEST_FILE ".1") == 0);
+    write_file("new\n");
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_APPENDED);
+    assert(buf.count == 3 && strcmp(buffer_get_line(&buf, 2), "z") == 0);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_REPLACED);
+    assert(buf.count == 1 && strcmp(buffer_get_line(&buf, 0), "new") == 0);
+    append_file(TEST_FILE, "more\n", 5);
+    assert(follow_update(&follow, &buf, &stamp) == FILE_FOLLOW_APPENDED);
+    assert(buf.count == 2 && strcmp(buffer_get_line(&buf, 1), "more") == 0);
+    file_follow_stop(&follow);
+    remove(TEST_FILE ".1");
+
+    /* Starting on a file that changed since the load loads it anew */
+    write_file("1\n2\n");
+    assert(file_follow_start(&follow, TEST_FILE, &buf, &stamp, &event) == 0);
+    assert(event == FILE_FOLLOW_TRUNCATED && buf.count == 2);
+    file_follow_stop(&follow);
+    assert(file_follow_start(&follow, "no-such-file.tmp", &buf, &stamp, &event) != 0);
+
+    buffer_free(&buf);
+}
+
+static void test_stats(void)
+{
+    TextBuffer buf;
+    buffer_init(&buf);
+    write_file("alpha\nbeta\ngamma\n");
+    StatsSnapshot stats;
+
+    stats_reset();
+    assert(file_load(TEST_FILE, &buf) == 0);
+    stats_read(&stats);
+    assert(stats.ops[STATS_LOAD].count == 0 && stats.allocations == 0);
+
+    stats_set_enabled(1);
+    assert(file_load(TEST_FILE, &buf) == 0);
+    assert(buffer_find(&buf, "gam") == 2);
+    assert(buffer_find(&buf, "none") == INVALID_INDEX);
+    assert(buffer_append_line(&buf, "delta") == 0);
+    assert(file_save(TEST_FILE, &buf) == 0);
+    stats_set_enabled(0);
+
+    stats_read(&stats);
+    assert(stats.ops[STATS_LOAD].count == 1 && stats.ops[STATS_LOAD].bytes == 17);
+    assert(stats.ops[STATS_SEARCH].count == 2);
+    assert(stats.ops[STATS_SEARCH].bytes == 14 + 17); /* up to the match's end, then everything */
+    assert(stats.ops[STATS_SAVE].count == 1 && stats.ops[STATS_SAVE].bytes == 23);
+    assert(stats.ops[STATS_SAVE].max_nanoseconds <= stats.ops[STATS_SAVE].nanoseconds);
+    assert(stats.allocations > 0 && stats.allocated_bytes >= ARENA_BLOCK_SIZE);
+
+    BufferMemoryStats memory;
+    buffer_memory_stats(&buf, &memory);
+    assert(memory.document_bytes == 23 && memory.original_bytes == 17);
+    assert(memory.index_used <= memory.index_capacity && memory.pieces_used <= memory.pieces_capacity);
+    assert(memory.arena_used == 6 && memory.arena_capacity == ARENA_BLOCK_SIZE);
+
+    stats_reset();
+    stats_read(&stats);
+    assert(stats.ops[STATS_SEARCH].count == 0 && stats.allocations == 0);
+    buffer_free(&buf);
+}
+
+int main(void)
+{
+    test_load_mode(FILE_MAP_NEVER);
+    test_load_mode(FILE_MAP_ALWAYS);
+    test_long_lines();
+    test_save_batches();
+    test_incremental_save(FILE_MAP_NEVER);
+    test_incremental_save(FILE_MAP_ALWAYS);
+    test_embedded_nul(FILE_MAP_NEVER);
+    test_embedded_nul(FILE_MAP_ALWAYS);
+    test_stream_nul();
+    test_snapshot_save();
+    test_stats();
+    test_lazy_load();
+    test_line_cache();
+    test_follow();
+    test_truncated_mapping();
+
+    /* Empty files load as an empty buffer */
+    TextBuffer buf;
+    buffer_init(&buf);
+    write_file("");
+    assert(file_load(TEST_FILE, &buf) == 0);
+    assert(buf.count == 0);
+    buffer_free(&buf);
+
+    remove(TEST_FILE);
+    printf("All fileio tests passed.\n");
+    return 0;
+}
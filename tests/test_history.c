@@ -0,0 +1,433 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: test_history.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "history.h"
+
+#define SNAPSHOTS 200
+
+/* Joins the buffer into one string so states can be compared */
+static char *snapshot(const TextBuffer *buf)
+{
+    size_t total = 1;
+    for (size_t i = 0; i < buf->count; ++i) {
+        total += strlen(buffer_get_line(buf, i)) + 1;
+    }
+
+    char *text = (char *)malloc(total);
+    assert(text != NULL);
+    size_t at = 0;
+    for (size_t i = 0; i < buf->count; ++i) {
+        const char *line = buffer_get_line(buf, i);
+        size_t len = strlen(line);
+        memcpy(text + at, line, len);
+        text[at + len] = '\n';
+        at += len + 1;
+    }
+    text[at] = '\0';
+    return text;
+}
+
+static void assert_text(const TextBuffer *buf, const char *expected)
+{
+    char *text = snapshot(buf);
+    assert(strcmp(text, expected) == 0);
+    free(text);
+}
+
+static void test_steps(void)
+{
+    TextBuffer buf;
+    History history;
+    buffer_init(&buf);
+    history_init(&history);
+
+    assert(history_undo(&history, &buf) == 0);
+
+    /* With merging asked for, typing consecutive lines is one step */
+    history.merge_adjacent = 1;
+    assert(history_insert_line(&history, &buf, 0, "one") == 0);
+    assert(history_insert_line(&history, &buf, 1, "two") == 0);
+    assert(history_insert_line(&history, &buf, 2, "three") == 0);
+    assert_text(&buf, "one\ntwo\nthree\n");
+
+    /* An edit elsewhere starts a new step */
+    assert(history_replace_line(&history, &buf, 0, "ONE") == 0);
+    assert(history_delete_line(&history, &buf, 2) == 0);
+    assert(history_delete_line(&history, &buf, 1) == 0);
+    assert_text(&buf, "ONE\n");
+
+    HistoryStats stats;
+    history_stats(&history, &stats);
+    assert(stats.ops == 6);
+    assert(stats.undo_steps == 3);
+    assert(stats.redo_steps == 0);
+
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "ONE\ntwo\nthree\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "one\ntwo\nthree\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "");
+    assert(history_undo(&history, &buf) == 0);
+
+    assert(history_redo(&history, &buf) == 1);
+    assert_text(&buf, "one\ntwo\nthree\n");
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 1);
+    assert(stats.redo_steps == 2);
+
+    /* An undo ends merging: this insert is its own step */
+    assert(history_undo(&history, &buf) == 1);
+    assert(history_redo(&history, &buf) == 1);
+    assert(history_insert_line(&history, &buf, 3, "four") == 0);
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "one\ntwo\nthree\n");
+
+    /* A failed edit records nothing and keeps what could be redone */
+    assert(history_insert_line(&history, &buf, 9, "nine") != 0);
+    assert(history_insert_lines(&history, &buf, 9, "x\ny\n", 4) != 0);
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 1);
+    assert(stats.redo_steps == 1);
+
+    /* A new edit discards what could be redone */
+    assert(history_insert_line(&history, &buf, 0, "zero") == 0);
+    assert(history_redo(&history, &buf) == 0);
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 2);
+    assert(stats.redo_steps == 0);
+
+    /* Explicit groups hold unrelated edits */
+    history_begin_group(&history);
+    assert(history_replace_line(&history, &buf, 0, "0") == 0);
+    history_begin_group(&history);
+    assert(history_delete_line(&history, &buf, 3) == 0);
+    history_end_group(&history);
+    assert(history_insert_line(&history, &buf, 1, "half") == 0);
+    history_end_group(&history);
+    assert_text(&buf, "0\nhalf\none\ntwo\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "zero\none\ntwo\nthree\n");
+    assert(history_redo(&history, &buf) == 1);
+    assert_text(&buf, "0\nhalf\none\ntwo\n");
+
+    /* Text with NUL bytes comes back whole */
+    size_t len = 0;
+    assert(history_replace_line_n(&history, &buf, 1, "h\0lf", 4) == 0);
+    assert(history_insert_line_n(&history, &buf, 0, "\0", 1) == 0);
+    assert(history_delete_line(&history, &buf, 2) == 0);
+    assert(history_undo(&history, &buf) == 1);
+    assert(memcmp(buffer_get_line_n(&buf, 2, &len), "h\0lf", 4) == 0 && len == 4);
+    assert(history_undo(&history, &buf) == 1);
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "0\nhalf\none\ntwo\n");
+    assert(history_redo(&history, &buf) == 1);
+    assert(history_redo(&history, &buf) == 1);
+    assert(memcmp(buffer_get_line_n(&buf, 0, &len), "\0", 1) == 0 && len == 1);
+    assert(history_undo(&history, &buf) == 1);
+    assert(history_undo(&history, &buf) == 1);
+
+    /* Without merging, the default, every edit is a step */
+    history_clear(&history);
+    history.merge_adjacent = 0;
+    assert(history_insert_line(&history, &buf, 0, "a") == 0);
+    assert(history_insert_line(&history, &buf, 1, "b") == 0);
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "a\n0\nhalf\none\ntwo\n");
+
+    history_free(&history);
+    buffer_free(&buf);
+
+    history_init(&history);
+    assert(history.merge_adjacent == 0);
+    history_free(&history);
+}
+
+/* A step that cannot be undone or redone whole leaves the buffer as it was */
+static void test_partial_failure(void)
+{
+    TextBuffer buf;
+    History history;
+    buffer_init(&buf);
+    history_init(&history);
+
+    assert(buffer_append_line(&buf, "a") == 0);
+    history_begin_group(&history);
+    assert(history_insert_line(&history, &buf, 1, "x") == 0);
+    assert(history_replace_line(&history, &buf, 0, "A") == 0);
+    history_end_group(&history);
+
+    /* Behind the history's back, so undoing the insert fails */
+    assert(buffer_delete_line(&buf, 1) == 0);
+    assert(history_undo(&history, &buf) == -1);
+    assert_text(&buf, "A\n");
+    HistoryStats stats;
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 1 && stats.redo_steps == 0);
+
+    /* The same for redo: the replace goes in, then the delete fails */
+    history_clear(&history);
+    assert(buffer_append_line(&buf, "b") == 0);
+    history_begin_group(&history);
+    assert(history_replace_line(&history, &buf, 0, "0") == 0);
+    assert(history_delete_line(&history, &buf, 1) == 0);
+    history_end_group(&history);
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "A\nb\n");
+    assert(buffer_delete_line(&buf, 1) == 0);
+    assert(history_redo(&history, &buf) == -1);
+    assert_text(&buf, "A\n");
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 0 && stats.redo_steps == 1);
+
+    history_free(&history);
+    buffer_free(&buf);
+}
+
+static void test_limit(void)
+{
+    TextBuffer buf;
+    History history;
+    buffer_init(&buf);
+    history_init(&history);
+    history.merge_adjacent = 0;
+
+    char line[64];
+    for (int i = 0; i < 1000; ++i) {
+        snprintf(line, sizeof(line), "line %04d", i);
+        assert(history_insert_line(&history, &buf, (size_t)i, line) == 0);
+    }
+
+    HistoryStats stats;
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 1000);
+    size_t per_op = (stats.op_bytes + stats.payload_bytes) / stats.ops;
+
+    /* Lowering the cap drops the oldest steps and keeps the newest */
+    history_set_limit(&history, per_op * 100);
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 100);
+    assert(stats.op_bytes + stats.payload_bytes <= stats.limit);
+
+    for (int i = 0; i < 100; ++i) {
+        assert(history_undo(&history, &buf) == 1);
+    }
+    assert(history_undo(&history, &buf) == 0);
+    assert(buf.count == 900);
+    assert(strcmp(buffer_get_line(&buf, 899), "line 0899") == 0);
+
+    /* Undone steps are kept even past the cap; new edits then drop them */
+    history_set_limit(&history, per_op * 10);
+    history_stats(&history, &stats);
+    assert(stats.redo_steps == 100);
+    for (int i = 0; i < 50; ++i) {
+        assert(history_replace_line(&history, &buf, (size_t)i, "changed") == 0);
+    }
+    history_stats(&history, &stats);
+    assert(stats.redo_steps == 0);
+    assert(stats.undo_steps <= 10);
+    assert(stats.op_bytes + stats.payload_bytes <= stats.limit);
+
+    /* A step bigger than the cap is still kept */
+    history_set_limit(&history, 1);
+    history_stats(&history, &stats);
+    assert(stats.undo_steps == 1);
+    assert(history_undo(&history, &buf) == 1);
+    assert(strcmp(buffer_get_line(&buf, 49), "line 0049") == 0);
+
+    history_free(&history);
+    buffer_free(&buf);
+}
+
+static void test_blocks(void)
+{
+    TextBuffer buf;
+    History history;
+    buffer_init(&buf);
+    history_init(&history);
+
+    assert(history_insert_lines(&history, &buf, 0, "a\nb\nc\nd", 7) == 0);
+    assert(buf.count == 4);
+
+    /* Each block edit is its own step, even next to a like one */
+    assert(history_move_lines(&history, &buf, 0, 2, 2) == 0);
+    assert_text(&buf, "c\nd\na\nb\n");
+    assert(history_copy_lines(&history, &buf, 1, 2, 0) == 0);
+    assert_text(&buf, "d\na\nc\nd\na\nb\n");
+    assert(history_delete_lines(&history, &buf, 1, 4) == 0);
+    assert_text(&buf, "d\nb\n");
+    assert(history_delete_lines(&history, &buf, 0, 2) == 0);
+    assert(buf.count == 0);
+
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "d\nb\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "d\na\nc\nd\na\nb\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "c\nd\na\nb\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "a\nb\nc\nd\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert(buf.count == 0);
+
+    for (int i = 0; i < 4; ++i) {
+        assert(history_redo(&history, &buf) == 1);
+    }
+    assert_text(&buf, "d\nb\n");
+
+    /* Rejected ranges record nothing; empty ones are no steps */
+    assert(history_delete_lines(&history, &buf, 1, 2) != 0);
+    assert(history_move_lines(&history, &buf, 0, 1, 2) != 0);
+    assert(history_copy_lines(&history, &buf, 0, 0, 0) == 0);
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "d\na\nc\nd\na\nb\n");
+
+    history_free(&history);
+    buffer_free(&buf);
+}
+
+static void test_replace_all(void)
+{
+    TextBuffer buf;
+    History history;
+    buffer_init(&buf);
+    history_init(&history);
+
+    const char *text = "cat dog\nbird\ncatcat\n";
+    assert(history_insert_lines(&history, &buf, 0, text, strlen(text)) == 0);
+
+    BufferSearch search;
+    size_t replaced = 0;
+    buffer_search_init(&search, "cat");
+    assert(history_replace_all(&history, &buf, &search, "lion", 4, &replaced) == 0);
+    assert(replaced == 3);
+    assert_text(&buf, "lion dog\nbird\nlionlion\n\n");
+
+    /* A search without matches is no step */
+    buffer_search_init(&search, "cat");
+    assert(history_replace_all(&history, &buf, &search, "x", 1, &replaced) == 0);
+    assert(replaced == 0);
+
+    Pattern *pattern = pattern_compile("^[a-z]+$", NULL);
+    assert(pattern != NULL);
+    buffer_search_init_regex(&search, pattern);
+    assert(history_replace_all(&history, &buf, &search, "", 0, &replaced) == 0);
+    assert(replaced == 2);
+    assert_text(&buf, "lion dog\n\n\n\n");
+    pattern_free(pattern);
+
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "lion dog\nbird\nlionlion\n\n");
+    assert(history_undo(&history, &buf) == 1);
+    assert_text(&buf, "cat dog\nbird\ncatcat\n\n");
+    assert(history_redo(&history, &buf) == 1);
+    assert(history_redo(&history, &buf) == 1);
+    assert_text(&buf, "lion dog\n\n\n\n");
+    assert(history_redo(&history, &buf) == 0);
+
+    history_free(&history);
+    buffer_free(&buf);
+}
+
+/* Random edits, then every state must come back on undo and redo */
+static void test_against_snapshots(void)
+{
+    TextBuffer buf;
+    History history;
+    buffer_init(&buf);
+    history_init(&history);
+
+    char *states[SNAPSHOTS + 1];
+    states[0] = snapshot(&buf);
+
+    srand(11);
+    char line[64];
+    for (int step = 1; step <= SNAPSHOTS; ++step) {
+        int edits = 1 + rand() % 4;
+        history_begin_group(&history);
+        for (int e = 0; e < edits; ++e) {
+            int op = rand() % 8;
+            snprintf(line, sizeof(line), "step %d edit %d", step, e);
+            if (op == 0 || buf.count == 0) {
+                assert(history_insert_line(&history, &buf, (size_t)rand() % (buf.count + 1), line) == 0);
+            } else if (op == 1) {
+                assert(history_delete_line(&history, &buf, (size_t)rand() % buf.count) == 0);
+            } else if (op == 2) {
+                assert(history_replace_line(&history, &buf, (size_t)rand() % buf.count, line) == 0);
+            } else if (op == 7) {
+                BufferSearch search;
+                buffer_search_init(&search, e % 2 ? "edit" : "e");
+                assert(history_replace_all(&history, &buf, &search, e % 2 ? "e" : "EDIT", e % 2 ? 1 : 4, NULL) == 0);
+            } else {
+                /* Block edits of up to a few lines */
+                size_t at = (size_t)rand() % buf.count;
+                size_t count = 1 + (size_t)rand() % (buf.count - at < 4 ? buf.count - at : 4);
+                if (op == 3) {
+                    line[strlen(line) / 2] = '\n';
+                    assert(history_insert_lines(&history, &buf, at, line, strlen(line)) == 0);
+                } else if (op == 4) {
+                    assert(history_delete_lines(&history, &buf, at, count) == 0);
+                } else if (op == 5) {
+                    size_t dest = (size_t)rand() % (buf.count - count + 1);
+                    assert(history_move_lines(&history, &buf, at, count, dest) == 0);
+                } else {
+                    size_t dest = (size_t)rand() % (buf.count + 1);
+                    assert(history_copy_lines(&history, &buf, at, count, dest) == 0);
+                }
+            }
+        }
+        history_end_group(&history);
+
+        /* Moves in place and replaces without a match record nothing */
+        HistoryStats stats;
+        history_stats(&history, &stats);
+        if (stats.undo_steps < (size_t)step) {
+            step--;
+            continue;
+        }
+        states[step] = snapshot(&buf);
+    }
+
+    for (int step = SNAPSHOTS; step > 0; --step) {
+        assert(history_undo(&history, &buf) == 1);
+        assert_text(&buf, states[step - 1]);
+    }
+    assert(history_undo(&history, &buf) == 0);
+
+    for (int step = 1; step <= SNAPSHOTS; ++step) {
+        assert(history_redo(&history, &buf) == 1);
+        assert_text(&buf, states[step]);
+    }
+    assert(history_redo(&history, &buf) == 0);
+
+    for (int step = 0; step <= SNAPSHOTS; ++step) {
+        free(states[step]);
+    }
+    history_free(&history);
+    buffer_free(&buf);
+}
+
+int main(void)
+{
+    test_steps();
+    test_partial_failure();
+    test_limit();
+    test_blocks();
+    test_replace_all();
+    test_against_snapshots();
+
+    printf("All history tests passed.\n");
+    return 0;
+}
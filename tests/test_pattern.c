@@ -0,0 +1,240 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: test_pattern.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pattern.h"
+
+typedef struct {
+    const char *pattern;
+    const char *text;
+    int found;
+    size_t start;
+    size_t len;
+} MatchCase;
+
+static const MatchCase cases[] = {
+    { "abc", "xxabcxx", 1, 2, 3 },
+    { "abc", "ababab", 0, 0, 0 },
+    { "a.c", "zzabcz", 1, 2, 3 },
+    { "a*", "bbb", 1, 0, 0 },
+    { "a+", "baaab", 1, 1, 3 },
+    { "colou?r", "my colour", 1, 3, 6 },
+    { "colou?r", "my color", 1, 3, 5 },
+    { "^foo", "foo bar", 1, 0, 3 },
+    { "^foo", "a foo", 0, 0, 0 },
+    { "bar$", "foo bar", 1, 4, 3 },
+    { "bar$", "bar foo", 0, 0, 0 },
+    { "^$", "", 1, 0, 0 },
+    { "^$", "x", 0, 0, 0 },
+    { "a|ab|abc", "xabcd", 1, 1, 3 },
+    { "(ab)+", "xabababy", 1, 1, 6 },
+    { "[0-9]+", "id=4711;", 1, 3, 4 },
+    { "[^a-z]+", "abc123def", 1, 3, 3 },
+    { "[]x]", "a]b", 1, 1, 1 },
+    { "\\d{3}-\\d{4}", "call 555-1234 now", 1, 5, 8 },
+    { "\\w+@\\w+\\.com", "mail: bob@example.com.", 1, 6, 15 },
+    { "\\s+", "a \t b", 1, 1, 3 },
+    { "x{2,3}", "xxxxx", 1, 0, 3 },
+    { "x{2,}", "axxxxb", 1, 1, 4 },
+    { "a{,2}", "a{,2}", 1, 0, 5 },
+    { "\\.", "a.b", 1, 1, 1 },
+    { "(a|b)*c$", "abxababc", 1, 3, 5 },
+    { "status=(ok|err)[0-9]", "t=1 status=err7 x", 1, 4, 11 },
+    { "b|abc", "xabc", 1, 1, 3 },
+    { "bc|abcd", "abcd", 1, 0, 4 },
+};
+
+static void test_cases(void)
+{
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); ++i) {
+        const MatchCase *c = &cases[i];
+        const char *error = NULL;
+        Pattern *pattern = pattern_compile(c->pattern, &error);
+        assert(pattern != NULL && error == NULL);
+
+        size_t start = 0;
+        size_t len = 0;
+        int found = pattern_find(pattern, c->text, strlen(c->text), 0, &start, &len);
+        if (found != c->found || (found && (start != c->start || len != c->len))) {
+            fprintf(stderr, "'%s' on '%s': got %d %zu+%zu\n", c->pattern, c->text, found, start, len);
+            assert(0);
+        }
+        pattern_free(pattern);
+    }
+}
+
+static void test_from_offset(void)
+{
+    Pattern *pattern = pattern_compile("ab", NULL);
+    size_t start = 0;
+    size_t len = 0;
+
+    assert(pattern_find(pattern, "ab ab", 5, 1, &start, &len) == 1);
+    assert(start == 3 && len == 2);
+    assert(pattern_find(pattern, "ab ab", 5, 4, &start, &len) == 0);
+    pattern_free(pattern);
+
+    /* ^ only holds at offset 0, even when the search starts later */
+    pattern = pattern_compile("^a", NULL);
+    assert(pattern_find(pattern, "aaa", 3, 1, &start, &len) == 0);
+    pattern_free(pattern);
+
+    /* Lengths are explicit, so embedded NULs are ordinary bytes */
+    pattern = pattern_compile("b.c", NULL);
+    assert(pattern_find(pattern, "ab\0cd", 5, 0, &start, &len) == 1);
+    assert(start == 1 && len == 3);
+    pattern_free(pattern);
+}
+
+static void test_errors(void)
+{
+    const char *bad[] = { "*a", "a|+", "(ab", "ab)", "[abc", "a\\", "[z-a]" };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+        const char *error = NULL;
+        assert(pattern_compile(bad[i], &error) == NULL);
+        assert(error != NULL);
+    }
+}
+
+static void test_literal(void)
+{
+    size_t len = 0;
+    Pattern *pattern = pattern_compile("^id=[0-9]+ user=admin\\.x", NULL);
+    assert(strcmp(pattern_literal(pattern, &len), " user=admin.x") == 0);
+    assert(len == 13);
+    pattern_free(pattern);
+
+    pattern = pattern_compile("foo|bar", NULL);
+    assert(strcmp(pattern_literal(pattern, &len), "") == 0 && len == 0);
+    pattern_free(pattern);
+
+    pattern = pattern_compile("x(abc)+y", NULL);
+    assert(strcmp(pattern_literal(pattern, &len), "abc") == 0);
+    pattern_free(pattern);
+}
+
+/* Enough DFA states to overflow the state table, which must then restart */
+static void test_state_flush(void)
+{
+    Pattern *pattern = pattern_compile("(a|b)*a(a|b){10}", NULL);
+    char text[200];
+
+    srand(7);
+    for (int round = 0; round < 2000; ++round) {
+        size_t len = (size_t)rand() % sizeof(text);
+        for (size_t i = 0; i < len; ++i) {
+            text[i] = rand() % 8 == 0 ? 'a' : 'b';
+        }
+
+        /* Matches run from 0 to 11 bytes past the last usable 'a' */
+        int expected = 0;
+        size_t end = 0;
+        for (size_t i = 0; i + 11 <= len; ++i) {
+            if (text[i] == 'a') {
+                expected = 1;
+                end = i + 11;
+            }
+        }
+
+        size_t start = 0;
+        size_t match_len = 0;
+        int found = pattern_find(pattern, text, len, 0, &start, &match_len);
+        assert(found == expected);
+        assert(!found || (start == 0 && match_len == end));
+    }
+    pattern_free(pattern);
+}
+
+/* Failed starts that each scan far ahead must not make a long line quadratic */
+static void test_long_line(void)
+{
+    size_t len = 1000000;
+    char *text = (char *)malloc(len);
+    assert(text != NULL);
+    memset(text, 'a', len);
+    text[len - 2] = 'x';
+    text[len - 1] = 'b';
+
+    Pattern *pattern = pattern_compile("a*b", NULL);
+    size_t start = 0;
+    size_t match_len = 0;
+    assert(pattern_find(pattern, text, len, 0, &start, &match_len) == 1);
+    assert(start == len - 1 && match_len == 1);
+
+    text[len - 2] = 'a';
+    assert(pattern_find(pattern, text, len, 0, &start, &match_len) == 1);
+    assert(start == 0 && match_len == len);
+    assert(pattern_find(pattern, text, len, 10, &start, &match_len) == 1);
+    assert(start == 10 && match_len == len - 10);
+    pattern_free(pattern);
+
+    pattern = pattern_compile("(a|x)*ab$", NULL);
+    text[len - 1] = 'a';
+    assert(pattern_find(pattern, text, len, 0, &start, &match_len) == 0);
+    pattern_free(pattern);
+    free(text);
+}
+
+static void test_cache(void)
+{
+    const char *error = NULL;
+    size_t compiles = pattern_cache_compiles();
+    Pattern *first = pattern_cache_get("a+b", &error);
+    assert(first != NULL);
+    pattern_cache_release(first);
+    assert(pattern_cache_get("a+b", &error) == first);
+    assert(pattern_cache_compiles() == compiles + 1);
+
+    /* A held pattern outlives any number of other lookups */
+    char source[16];
+    for (int i = 0; i < 2 * PATTERN_CACHE_SIZE; ++i) {
+        snprintf(source, sizeof(source), "x%d", i);
+        pattern_cache_release(pattern_cache_get(source, &error));
+    }
+    size_t start = 0;
+    size_t len = 0;
+    assert(pattern_cache_get("a+b", &error) == first);
+    assert(pattern_find(first, "xaab", 4, 0, &start, &len) == 1 && start == 1 && len == 3);
+    pattern_cache_release(first);
+    pattern_cache_release(first);
+
+    /* With every entry held, lookups still work, outside the cache */
+    Pattern *held[PATTERN_CACHE_SIZE + 1];
+    for (int i = 0; i <= PATTERN_CACHE_SIZE; ++i) {
+        snprintf(source, sizeof(source), "y%d", i);
+        held[i] = pattern_cache_get(source, &error);
+        assert(held[i] != NULL && strcmp(pattern_source(held[i]), source) == 0);
+    }
+    pattern_cache_clear();
+    assert(pattern_find(held[0], "ay0", 3, 0, &start, &len) == 1 && start == 1);
+    for (int i = 0; i <= PATTERN_CACHE_SIZE; ++i) {
+        pattern_cache_release(held[i]);
+    }
+
+    assert(pattern_cache_get("(", &error) == NULL && error != NULL);
+    pattern_cache_clear();
+}
+
+int main(void)
+{
+    test_cases();
+    test_from_offset();
+    test_errors();
+    test_literal();
+    test_state_flush();
+    test_long_line();
+    test_cache();
+
+    printf("All pattern tests passed.\n");
+    return 0;
+}
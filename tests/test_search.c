@@ -0,0 +1,105 @@
+/*
+ * Project: Console-Based Text Editor
+ * File: test_search.c
+ * Author: Mobin Yousefi (GitHub: https://github.com/mobinyousefi-cs)
+ * Created: 2026-10-17
+ * Updated: 2026-10-17
+ * License: MIT License (see LICENSE file for details)
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+#define HAY_SIZE 300
+
+static const char *find_naive(const char *hay, size_t hay_len, const char *needle, size_t needle_len)
+{
+    for (size_t i = 0; i + needle_len <= hay_len; ++i) {
+        if (memcmp(hay + i, needle, needle_len) == 0) {
+            return hay + i;
+        }
+    }
+    return NULL;
+}
+
+/* Every kernel must agree with a naive scan, including near block edges */
+static void test_kernel(SearchKernel kernel)
+{
+    char hay[HAY_SIZE];
+    char needle[8];
+
+    search_set_kernel(kernel);
+    srand(42);
+
+    for (int round = 0; round < 20000; ++round) {
+        size_t hay_len = (size_t)rand() % HAY_SIZE;
+        size_t needle_len = 1 + (size_t)rand() % sizeof(needle);
+        for (size_t i = 0; i < hay_len; ++i) {
+            hay[i] = (char)('a' + rand() % 3);
+        }
+        for (size_t i = 0; i < needle_len; ++i) {
+            needle[i] = (char)('a' + rand() % 3);
+        }
+
+        assert(search_find(hay, hay_len, needle, needle_len) == find_naive(hay, hay_len, needle, needle_len));
+    }
+
+    search_set_kernel(SEARCH_KERNEL_AUTO);
+}
+
+/* Byte counts and positions must agree with a plain loop at every length */
+static void test_byte_scan(SearchKernel kernel)
+{
+    static char data[20000];
+    static size_t positions[20000];
+
+    search_set_kernel(kernel);
+    srand(7);
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (char)(rand() % 4 == 0 ? '\n' : 'a' + rand() % 3);
+    }
+
+    for (int round = 0; round < 2000; ++round) {
+        size_t start = (size_t)rand() % 64;
+        size_t len = round < 100 ? (size_t)round : (size_t)rand() % (sizeof(data) - start);
+        size_t expected = 0;
+        for (size_t i = 0; i < len; ++i) {
+            expected += data[start + i] == '\n';
+        }
+
+        assert(search_count_byte(data + start, len, '\n') == expected);
+        assert(search_byte_positions(data + start, len, '\n', 5, positions) == expected);
+        size_t next = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (data[start + i] == '\n') {
+                assert(positions[next++] == 5 + i);
+            }
+        }
+    }
+
+    /* More matches than one lane can count before it is folded */
+    memset(data, '\n', sizeof(data));
+    assert(search_count_byte(data, sizeof(data), '\n') == sizeof(data));
+
+    search_set_kernel(SEARCH_KERNEL_AUTO);
+}
+
+int main(void)
+{
+    test_kernel(SEARCH_KERNEL_SCALAR);
+    test_kernel(SEARCH_KERNEL_SSE2);
+    test_kernel(SEARCH_KERNEL_AVX2);
+    test_byte_scan(SEARCH_KERNEL_SCALAR);
+    test_byte_scan(SEARCH_KERNEL_SSE2);
+    test_byte_scan(SEARCH_KERNEL_AVX2);
+
+    assert(search_find("abc", 3, "", 0) == NULL);
+    assert(search_find("abc", 3, "abcd", 4) == NULL);
+
+    printf("All search tests passed (%s kernel).\n", search_kernel_name(search_active_kernel()));
+    return 0;
+}